@@ -0,0 +1,137 @@
+
+// ****************************************************************************
+// File: Arena.cpp
+// Desc: Block arena allocator with string interning
+//
+// ****************************************************************************
+#include "StdAfx.h"
+#include "Arena.h"
+
+// FNV-1a string hash
+static inline UINT HashString(LPCSTR pszString, UINT uLength)
+{
+	UINT uHash = 0x811C9DC5;
+	for(UINT i = 0; i < uLength; i++)
+		uHash = ((uHash ^ (BYTE) pszString[i]) * 0x01000193);
+	return(uHash);
+}
+
+
+Arena::Arena() : m_pBlocks(NULL), m_pFree(NULL), m_pEnd(NULL), m_uUsed(0), m_uReserved(0), m_ppszStrings(NULL), m_uStringMask(0), m_uStringCount(0)
+{
+}
+
+Arena::~Arena()
+{
+	Reset();
+}
+
+
+// Get "uSize" bytes aligned to "uAlign" (a power of 2); NULL when out of memory
+PVOID Arena::Alloc(UINT uSize, UINT uAlign)
+{
+	PBYTE pResult = (PBYTE) (((UINT_PTR) m_pFree + (uAlign - 1)) & ~((UINT_PTR) uAlign - 1));
+	if(!m_pFree || ((pResult + uSize) > m_pEnd))
+	{
+		// New block, bigger than the default for large requests
+		UINT uBlockSize = (uSize + uAlign);
+		if(uBlockSize < BLOCK_SIZE)
+			uBlockSize = BLOCK_SIZE;
+		tBLOCK *pBlock = (tBLOCK *) qalloc(sizeof(tBLOCK) + uBlockSize);
+		if(!pBlock)
+			return(NULL);
+		pBlock->pNext = m_pBlocks;
+		pBlock->uSize = uBlockSize;
+		m_pBlocks = pBlock;
+		m_pFree = (PBYTE) (pBlock + 1);
+		m_pEnd  = (m_pFree + uBlockSize);
+		m_uReserved += uBlockSize;
+		pResult = (PBYTE) (((UINT_PTR) m_pFree + (uAlign - 1)) & ~((UINT_PTR) uAlign - 1));
+	}
+
+	m_pFree = (pResult + uSize);
+	m_uUsed += uSize;
+	return(pResult);
+}
+
+// Copy a string into the arena, "uLength" excluding the terminator
+LPCSTR Arena::StrDup(LPCSTR pszString, UINT uLength)
+{
+	LPSTR pszCopy = (LPSTR) Alloc((uLength + 1), 1);
+	if(pszCopy)
+	{
+		memcpy(pszCopy, pszString, uLength);
+		pszCopy[uLength] = 0;
+	}
+	return(pszCopy);
+}
+
+// Get the one stored copy of a string, adding it if it's new
+LPCSTR Arena::Intern(LPCSTR pszString, UINT uLength)
+{
+	// Keep the table at most half full
+	if((((m_uStringCount + 1) * 2) > m_uStringMask) && !GrowStrings())
+		return(NULL);
+
+	UINT i = (HashString(pszString, uLength) & m_uStringMask);
+	while(LPCSTR pszTest = m_ppszStrings[i])
+	{
+		if((strncmp(pszTest, pszString, uLength) == 0) && (pszTest[uLength] == 0))
+			return(pszTest);
+		i = ((i + 1) & m_uStringMask);
+	};
+
+	LPCSTR pszCopy = StrDup(pszString, uLength);
+	if(pszCopy)
+	{
+		m_ppszStrings[i] = pszCopy;
+		m_uStringCount++;
+	}
+	return(pszCopy);
+}
+
+BOOL Arena::GrowStrings()
+{
+	UINT uSize = (m_uStringMask ? ((m_uStringMask + 1) * 2) : 4096);
+	LPCSTR *ppszStrings = (LPCSTR *) qalloc(sizeof(LPCSTR) * uSize);
+	if(!ppszStrings)
+		return(FALSE);
+	ZeroMemory(ppszStrings, (sizeof(LPCSTR) * uSize));
+
+	// Rehash
+	for(UINT i = 0; m_ppszStrings && (i <= m_uStringMask); i++)
+	{
+		if(LPCSTR pszOld = m_ppszStrings[i])
+		{
+			UINT j = (HashString(pszOld, strlen(pszOld)) & (uSize - 1));
+			while(ppszStrings[j])
+				j = ((j + 1) & (uSize - 1));
+			ppszStrings[j] = pszOld;
+		}
+	}
+
+	if(m_ppszStrings) qfree(m_ppszStrings);
+	m_ppszStrings = ppszStrings;
+	m_uStringMask = (uSize - 1);
+	return(TRUE);
+}
+
+
+// Free everything
+void Arena::Reset()
+{
+	while(tBLOCK *pBlock = m_pBlocks)
+	{
+		m_pBlocks = pBlock->pNext;
+		qfree(pBlock);
+	};
+	m_pFree = m_pEnd = NULL;
+	m_uUsed = m_uReserved = 0;
+
+	if(m_ppszStrings)
+	{
+		qfree(m_ppszStrings);
+		m_ppszStrings = NULL;
+	}
+	m_uStringMask = m_uStringCount = 0;
+}
@@ -0,0 +1,64 @@
+
+// ****************************************************************************
+// File: Arena.h
+// Desc: Block arena allocator with string interning
+//
+// ****************************************************************************
+#pragma once
+
+// Allocates from a few large blocks that are only freed all at once.
+// For data that's built up and then thrown away together, like the text DB
+// nodes and their labels: no per-allocation header or padding, and
+// teardown is freeing a handful of blocks.
+// Strings can be interned so each unique one is stored only once.
+class Arena
+{
+public:
+	enum
+	{
+		BLOCK_SIZE = (256 * 1024)
+	};
+
+	Arena();
+	~Arena();
+
+	// Get "uSize" bytes aligned to "uAlign" (a power of 2); NULL when out of memory
+	PVOID Alloc(UINT uSize, UINT uAlign = sizeof(PVOID));
+
+	// Copy a string into the arena, "uLength" excluding the terminator
+	LPCSTR StrDup(LPCSTR pszString, UINT uLength);
+
+	// Get the one stored copy of a string, adding it if it's new
+	LPCSTR Intern(LPCSTR pszString, UINT uLength);
+
+	// Free everything
+	void Reset();
+
+	// Bytes handed out, and the total held in blocks
+	UINT GetUsed() const { return(m_uUsed); }
+	UINT GetReserved() const { return(m_uReserved); }
+
+private:
+	struct tBLOCK
+	{
+		tBLOCK *pNext;
+		UINT   uSize; // Usable bytes after the header
+	};
+
+	tBLOCK *m_pBlocks;	// Newest first
+	PBYTE  m_pFree;		// Next free byte in the newest block
+	PBYTE  m_pEnd;		// End of the newest block
+	UINT   m_uUsed;
+	UINT   m_uReserved;
+
+	// Intern table, open addressed on the string hash
+	LPCSTR *m_ppszStrings;
+	UINT   m_uStringMask;
+	UINT   m_uStringCount;
+
+	BOOL GrowStrings();
+
+	// No copies
+	Arena(const Arena &);
+	void operator=(const Arena &);
+};
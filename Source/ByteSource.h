@@ -0,0 +1,42 @@
+
+// ****************************************************************************
+// File: ByteSource.h
+// Desc: Scan engine byte source and hit sink interfaces
+//
+// ****************************************************************************
+#pragma once
+
+// Where the scanned bytes come from: the IDB in the plug-in, a flat file
+// (see FileSource) in the tools. Addresses are the source's own, a source can
+// have ranges without values (uninitialized/unloaded), they're skipped.
+class ByteSource
+{
+public:
+	virtual ~ByteSource(){}
+
+	// First address in [ea, endEA) that has a value; BADADDR if none does
+	virtual ea_t NextLoaded(ea_t ea, ea_t endEA) = 0;
+
+	// End of the run of bytes with values from "ea", at most "endEA"
+	virtual ea_t RunEnd(ea_t ea, ea_t endEA) = 0;
+
+	// Read "uSize" bytes from "ea", all in one run
+	virtual BOOL Read(ea_t ea, PBYTE pBuffer, UINT uSize) = 0;
+
+	// Polled while scanning; returns TRUE to abort
+	virtual BOOL CheckBreak(){ return(FALSE); }
+};
+
+// Where the hits go: annotated in the IDB by the plug-in, printed or stored
+// by the tools. Hits come in address order.
+class HitSink
+{
+public:
+	virtual ~HitSink(){}
+
+	// DB entry "uEntry" found at "ea" in form "uForm" (eHITFORM)
+	virtual void OnHit(ea_t ea, UINT uEntry, UINT uForm) = 0;
+
+	// Polled while handing out hits; returns TRUE to abort
+	virtual BOOL CheckBreak(){ return(FALSE); }
+};
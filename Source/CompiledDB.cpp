@@ -0,0 +1,295 @@
+
+// ****************************************************************************
+// File: CompiledDB.cpp
+// Desc: Compiled binary GUID database
+//
+// ****************************************************************************
+#include "StdAfx.h"
+#include "CompiledDB.h"
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#endif
+
+// Round up to a power of 2 boundary
+#define ALIGN_UP(_x_, _a_) (((_x_) + ((_a_) - 1)) & ~((_a_) - 1))
+
+static int __cdecl CompareEntry(const void *pA, const void *pB)
+{
+	return(memcmp(&((const CompiledDB::tENTRY *) pA)->Guid, &((const CompiledDB::tENTRY *) pB)->Guid, sizeof(GUID)));
+}
+
+static int __cdecl CompareLabel(const void *pA, const void *pB)
+{
+	return(strcmp(*((const LPCSTR *) pA), *((const LPCSTR *) pB)));
+}
+
+
+CompiledDB::CompiledDB() :
+	#ifdef _WIN32
+	m_hFile(NULL), m_hMapping(NULL),
+	#endif
+	m_pView(NULL), m_uViewSize(0), m_pHeader(NULL), m_pKeys(NULL), m_pbTypes(NULL), m_puLabels(NULL), m_pszStrings(NULL)
+{
+}
+
+CompiledDB::~CompiledDB()
+{
+	Close();
+}
+
+
+// Map a compiled DB file read only
+BOOL CompiledDB::Open(LPCSTR pszPath)
+{
+	Close();
+
+	#ifdef _WIN32
+	m_hFile = CreateFile(pszPath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if(m_hFile == INVALID_HANDLE_VALUE)
+	{
+		m_hFile = NULL;
+		return(FALSE);
+	}
+
+	DWORD dwSize = GetFileSize(m_hFile, NULL);
+	if((dwSize != INVALID_FILE_SIZE) && (dwSize >= sizeof(tHEADER)))
+	{
+		if((m_hMapping = CreateFileMapping(m_hFile, NULL, PAGE_READONLY, 0, 0, NULL)) != NULL)
+		{
+			if((m_pView = (const BYTE *) MapViewOfFile(m_hMapping, FILE_MAP_READ, 0, 0, 0)) != NULL)
+			{
+				m_uViewSize = dwSize;
+				if(Validate(m_pView, dwSize))
+					return(TRUE);
+			}
+		}
+	}
+	#else
+	int iFile = open(pszPath, O_RDONLY);
+	if(iFile < 0)
+		return(FALSE);
+
+	struct stat tStat;
+	if((fstat(iFile, &tStat) == 0) && (tStat.st_size >= (off_t) sizeof(tHEADER)) && (tStat.st_size <= 0x7FFFFFFF))
+	{
+		// The mapping stays valid after the file is closed
+		PVOID pView = mmap(NULL, (size_t) tStat.st_size, PROT_READ, MAP_PRIVATE, iFile, 0);
+		if(pView != MAP_FAILED)
+		{
+			m_pView = (const BYTE *) pView;
+			m_uViewSize = (UINT) tStat.st_size;
+		}
+	}
+	close(iFile);
+	if(m_pView && Validate(m_pView, m_uViewSize))
+		return(TRUE);
+	#endif
+
+	Close();
+	return(FALSE);
+}
+
+// Use a compiled DB image in memory
+BOOL CompiledDB::Attach(const BYTE *pImage, UINT uSize)
+{
+	Close();
+	return((uSize >= sizeof(tHEADER)) && Validate(pImage, uSize));
+}
+
+// Validate the header and tables, the file could be stale or damaged.
+// Sets up the table pointers if it's good.
+BOOL CompiledDB::Validate(const BYTE *pView, UINT uSize)
+{
+	const tHEADER *pHeader = (const tHEADER *) pView;
+	BOOL bValid = ((pHeader->dwMagic == COMPILEDDB_MAGIC) && (pHeader->dwVersion == COMPILEDDB_VERSION) && (pHeader->uFileSize == uSize) &&
+				   (pHeader->uTypeCount >= 1) && (pHeader->uTypeCount <= MAX_TYPES) && (pHeader->uCount < (uSize / sizeof(GUID))) &&
+				   (pHeader->uStringsOffset < uSize) && (pHeader->uStringsSize < uSize) &&
+				   !(pHeader->uKeysOffset & 15) && !(pHeader->uLabelsOffset & 3) &&
+				   (pHeader->uKeysOffset >= sizeof(tHEADER)) && ((pHeader->uKeysOffset + (pHeader->uCount * sizeof(GUID))) <= pHeader->uTypesOffset) &&
+				   ((pHeader->uTypesOffset + pHeader->uCount) <= pHeader->uLabelsOffset) &&
+				   ((pHeader->uLabelsOffset + (pHeader->uCount * sizeof(UINT))) <= pHeader->uStringsOffset) &&
+				   pHeader->uStringsSize && ((pHeader->uStringsOffset + pHeader->uStringsSize) <= uSize) &&
+				   (pView[pHeader->uStringsOffset + pHeader->uStringsSize - 1] == 0));
+
+	for(UINT i = 0; bValid && (i < pHeader->uTypeCount); i++)
+		bValid = (memchr(pHeader->aszType[i], 0, TYPE_NAME_SIZE) != NULL);
+
+	if(bValid)
+	{
+		const BYTE *pbTypes  = (pView + pHeader->uTypesOffset);
+		const UINT *puLabels = (const UINT *) (pView + pHeader->uLabelsOffset);
+		for(UINT i = 0; bValid && (i < pHeader->uCount); i++)
+			bValid = ((pbTypes[i] < pHeader->uTypeCount) && (puLabels[i] < pHeader->uStringsSize));
+	}
+
+	if(bValid)
+	{
+		m_pHeader    = pHeader;
+		m_pKeys      = (const GUID *) (pView + pHeader->uKeysOffset);
+		m_pbTypes    = (pView + pHeader->uTypesOffset);
+		m_puLabels   = (const UINT *) (pView + pHeader->uLabelsOffset);
+		m_pszStrings = (LPCSTR) (pView + pHeader->uStringsOffset);
+	}
+	return(bValid);
+}
+
+void CompiledDB::Close()
+{
+	#ifdef _WIN32
+	if(m_pView)    UnmapViewOfFile(m_pView);
+	if(m_hMapping) { CloseHandle(m_hMapping); m_hMapping = NULL; }
+	if(m_hFile)    { CloseHandle(m_hFile); m_hFile = NULL; }
+	#else
+	if(m_pView)    munmap((PVOID) m_pView, m_uViewSize);
+	#endif
+	m_pView = NULL;
+	m_uViewSize = 0;
+	m_pHeader = NULL;
+	m_pKeys = NULL;
+	m_pbTypes = NULL;
+	m_puLabels = NULL;
+	m_pszStrings = NULL;
+}
+
+
+// Build a compiled DB image, "pEntries" get sorted
+PBYTE CompiledDB::Build(tENTRY *pEntries, UINT uCount, const tHEADER &rInfo, UINT &ruSize)
+{
+	ruSize = 0;
+	if((rInfo.uTypeCount < 1) || (rInfo.uTypeCount > MAX_TYPES))
+		return(NULL);
+
+	qsort(pEntries, uCount, sizeof(tENTRY), CompareEntry);
+
+	// Shared string table, each unique label once
+	LPCSTR *ppszLabels = (LPCSTR *) qalloc(sizeof(LPCSTR) * (uCount ? uCount : 1));
+	UINT *puOffsets    = (UINT *)   qalloc(sizeof(UINT)   * (uCount ? uCount : 1));
+	PBYTE pFile = NULL;
+	if(ppszLabels && puOffsets)
+	{
+		for(UINT i = 0; i < uCount; i++)
+			ppszLabels[i] = pEntries[i].pszLabel;
+		qsort(ppszLabels, uCount, sizeof(LPCSTR), CompareLabel);
+
+		UINT uUnique = 0, uStringsSize = 0;
+		for(UINT i = 0; i < uCount; i++)
+		{
+			if(!uUnique || (strcmp(ppszLabels[uUnique - 1], ppszLabels[i]) != 0))
+			{
+				ppszLabels[uUnique] = ppszLabels[i];
+				puOffsets[uUnique++] = uStringsSize;
+				uStringsSize += (strlen(ppszLabels[i]) + 1);
+			}
+		}
+		if(!uStringsSize)
+			uStringsSize = 1;
+
+		// Layout
+		tHEADER tHeader;
+		ZeroMemory(&tHeader, sizeof(tHEADER));
+		tHeader.dwMagic   = COMPILEDDB_MAGIC;
+		tHeader.dwVersion = COMPILEDDB_VERSION;
+		tHeader.uCount    = uCount;
+		tHeader.uKeysOffset    = ALIGN_UP(sizeof(tHEADER), 16);
+		tHeader.uTypesOffset   = (tHeader.uKeysOffset + (uCount * sizeof(GUID)));
+		tHeader.uLabelsOffset  = ALIGN_UP((tHeader.uTypesOffset + uCount), 4);
+		tHeader.uStringsOffset = (tHeader.uLabelsOffset + (uCount * sizeof(UINT)));
+		tHeader.uStringsSize   = uStringsSize;
+		tHeader.uFileSize      = (tHeader.uStringsOffset + uStringsSize);
+		tHeader.uTypeCount     = rInfo.uTypeCount;
+		for(UINT i = 0; i < rInfo.uTypeCount; i++)
+		{
+			qstrncpy(tHeader.aszType[i], rInfo.aszType[i], TYPE_NAME_SIZE);
+			tHeader.aSource[i] = rInfo.aSource[i];
+		}
+		tHeader.uTextLoadMicros = rInfo.uTextLoadMicros;
+		tHeader.uTextMemory     = rInfo.uTextMemory;
+		tHeader.dwStockStamp    = rInfo.dwStockStamp;
+
+		if((pFile = (PBYTE) qalloc(tHeader.uFileSize)) != NULL)
+		{
+			ZeroMemory(pFile, tHeader.uFileSize);
+			memcpy(pFile, &tHeader, sizeof(tHEADER));
+
+			GUID *pKeys    = (GUID *) (pFile + tHeader.uKeysOffset);
+			PBYTE pbTypes  = (pFile + tHeader.uTypesOffset);
+			UINT *puLabels = (UINT *) (pFile + tHeader.uLabelsOffset);
+			for(UINT i = 0; i < uCount; i++)
+			{
+				pKeys[i]   = pEntries[i].Guid;
+				pbTypes[i] = (BYTE) pEntries[i].uType;
+				LPCSTR *ppszLabel = (LPCSTR *) bsearch(&pEntries[i].pszLabel, ppszLabels, uUnique, sizeof(LPCSTR), CompareLabel);
+				puLabels[i] = puOffsets[ppszLabel - ppszLabels];
+			}
+			for(UINT i = 0; i < uUnique; i++)
+				strcpy((LPSTR) (pFile + tHeader.uStringsOffset + puOffsets[i]), ppszLabels[i]);
+			ruSize = tHeader.uFileSize;
+		}
+	}
+	if(ppszLabels) qfree(ppszLabels);
+	if(puOffsets)  qfree(puOffsets);
+
+	return(pFile);
+}
+
+// Build and write a compiled DB file
+BOOL CompiledDB::Compile(LPCSTR pszPath, tENTRY *pEntries, UINT uCount, const tHEADER &rInfo)
+{
+	BOOL bResult = FALSE;
+	UINT uSize;
+	if(PBYTE pFile = Build(pEntries, uCount, rInfo, uSize))
+	{
+		if(FILE *fp = qfopen(pszPath, "wb"))
+		{
+			bResult = ((UINT) qfwrite(fp, pFile, uSize) == uSize);
+			qfclose(fp);
+			if(!bResult)
+				DeleteFile(pszPath);
+		}
+		qfree(pFile);
+	}
+
+	return(bResult);
+}
+
+
+// Get a text DB file's stamp
+BOOL CompiledDB::GetSource(LPCSTR pszPath, tSOURCE &rSource)
+{
+	#ifdef _WIN32
+	WIN32_FILE_ATTRIBUTE_DATA tData;
+	if(!GetFileAttributesEx(pszPath, GetFileExInfoStandard, &tData))
+		return(FALSE);
+
+	rSource.uSize = (((ULONGLONG) tData.nFileSizeHigh << 32) | tData.nFileSizeLow);
+	rSource.uWriteTime = (((ULONGLONG) tData.ftLastWriteTime.dwHighDateTime << 32) | tData.ftLastWriteTime.dwLowDateTime);
+	#else
+	struct stat tStat;
+	if(stat(pszPath, &tStat) != 0)
+		return(FALSE);
+
+	rSource.uSize = (ULONGLONG) tStat.st_size;
+	rSource.uWriteTime = (((ULONGLONG) tStat.st_mtim.tv_sec * 1000000000) + tStat.st_mtim.tv_nsec);
+	#endif
+	return(TRUE);
+}
+
+// Hash of the DB contents. The header's stats and source stamps change on
+// every compile, what the entries are doesn't.
+ULONGLONG CompiledDB::GetVersion() const
+{
+	UINT uCount = GetCount();
+	if(!uCount)
+		return(0);
+	ULONGLONG uVersion = HashBytes64((const BYTE *) m_pKeys, (uCount * sizeof(GUID)));
+	uVersion = HashBytes64(m_pbTypes, uCount, uVersion);
+	for(UINT i = 0; i < uCount; i++)
+	{
+		LPCSTR pszLabel = GetLabel(i);
+		uVersion = HashBytes64((const BYTE *) pszLabel, (strlen(pszLabel) + 1), uVersion);
+	}
+	for(UINT i = 0; i < GetTypeCount(); i++)
+		uVersion = HashBytes64((const BYTE *) GetTypeName(i), (strlen(GetTypeName(i)) + 1), uVersion);
+	return(uVersion);
+}
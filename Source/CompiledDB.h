@@ -0,0 +1,122 @@
+
+// ****************************************************************************
+// File: CompiledDB.h
+// Desc: Compiled binary GUID database
+//
+// ****************************************************************************
+#pragma once
+
+#define COMPILEDDB_MAGIC   0x42444647 // "GFDB"
+#define COMPILEDDB_VERSION 3
+
+// Compiled GUID database.
+// The text DB files are compiled once into a single binary file: the GUID
+// keys sorted bytewise, a type tag and a label offset per key, and a shared
+// label string table. Each label is stored once and the string table is in
+// label order, so label offsets sort the same as the labels.
+// At run time the file is mapped read only and used in place, nothing is
+// parsed or allocated per entry. An image built into the plug-in (the stock
+// DB, see MakeStockDB) is used in place the same way.
+class CompiledDB
+{
+public:
+	enum
+	{
+		MAX_TYPES = 32,
+		TYPE_NAME_SIZE = 16
+	};
+
+	// Text DB file stamp, to tell when the compiled DB is out of date
+	struct tSOURCE
+	{
+		ULONGLONG uSize;
+		ULONGLONG uWriteTime;
+	};
+
+	// File header, the tables follow it
+	struct tHEADER
+	{
+		DWORD dwMagic;
+		DWORD dwVersion;
+		UINT  uFileSize;
+		UINT  uCount;			// Entries
+		UINT  uKeysOffset;		// GUID[uCount], sorted
+		UINT  uTypesOffset;		// BYTE[uCount], type index
+		UINT  uLabelsOffset;	// UINT[uCount], string table offset
+		UINT  uStringsOffset;	// Label strings
+		UINT  uStringsSize;
+		UINT  uTypeCount;
+		char  aszType[MAX_TYPES][TYPE_NAME_SIZE];
+		tSOURCE aSource[MAX_TYPES];
+
+		// Text DB load cost when compiled, to compare against
+		UINT  uTextLoadMicros;
+		UINT  uTextMemory;
+
+		DWORD dwStockStamp;		// Stock DB merged in, 0 if none
+	};
+
+	// Entry to compile
+	struct tENTRY
+	{
+		GUID   Guid;
+		UINT   uType;
+		LPCSTR pszLabel;
+	};
+
+	CompiledDB();
+	~CompiledDB();
+
+	// Map a compiled DB file read only
+	BOOL Open(LPCSTR pszPath);
+	// Use a compiled DB image in memory, it has to stay valid while open
+	BOOL Attach(const BYTE *pImage, UINT uSize);
+	void Close();
+	BOOL IsOpen() const { return(m_pHeader != NULL); }
+	BOOL IsFile() const { return(m_pView != NULL); }
+
+	// Build a compiled DB image, "pEntries" get sorted. "rInfo" supplies the
+	// type names, sources, stats and stock stamp, the rest of it is ignored.
+	// Returns a qalloc()'d image, NULL on allocation failure.
+	static PBYTE Build(tENTRY *pEntries, UINT uCount, const tHEADER &rInfo, UINT &ruSize);
+
+	// Build and write a compiled DB file
+	static BOOL Compile(LPCSTR pszPath, tENTRY *pEntries, UINT uCount, const tHEADER &rInfo);
+
+	// Get a text DB file's stamp
+	static BOOL GetSource(LPCSTR pszPath, tSOURCE &rSource);
+
+	const tHEADER *GetHeader() const { return(m_pHeader); }
+	UINT GetCount() const { return(m_pHeader ? m_pHeader->uCount : 0); }
+	UINT GetSize() const { return(m_pHeader ? m_pHeader->uFileSize : 0); }
+	UINT GetTypeCount() const { return(m_pHeader ? m_pHeader->uTypeCount : 0); }
+	LPCSTR GetTypeName(UINT uType) const { return(m_pHeader->aszType[uType]); }
+
+	// Hash of the keys, types, labels and type names; what DB entry numbers
+	// saved with hits are good for
+	ULONGLONG GetVersion() const;
+
+	const GUID *GetKeys() const { return(m_pKeys); }
+	UINT GetType(UINT uEntry) const { return(m_pbTypes[uEntry]); }
+	UINT GetLabelOffset(UINT uEntry) const { return(m_puLabels[uEntry]); }
+	LPCSTR GetLabel(UINT uEntry) const { return(m_pszStrings + m_puLabels[uEntry]); }
+
+private:
+	#ifdef _WIN32
+	HANDLE m_hFile;
+	HANDLE m_hMapping;
+	#endif
+	const BYTE *m_pView; // Mapped file, NULL if attached to an image
+	UINT m_uViewSize;
+	const tHEADER *m_pHeader;
+	const GUID *m_pKeys;
+	const BYTE *m_pbTypes;
+	const UINT *m_puLabels;
+	LPCSTR m_pszStrings;
+
+	BOOL Validate(const BYTE *pView, UINT uSize);
+
+	// No copies
+	CompiledDB(const CompiledDB &);
+	void operator=(const CompiledDB &);
+};
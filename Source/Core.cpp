@@ -5,50 +5,142 @@
 //
 // ****************************************************************************
 #include "stdafx.h"
-#include "ContainersInl.h"
+#include "ScanEngine.h"
+#include "GUIDDB.h"
+#include "ResultWriter.h"
 
-//#define SAVE_FIXED // To help sort out duplicates
+// Stock DB built into the plug-in, generated from the shipped text DB files
+// by MakeStockDB at build time
+#include "StockDB.inl"
 
-// DB info container
-struct tDB_ENTRY
-{
-	LPCSTR pszFileName;  // DB File name
-	LPCSTR pszType;    // DB Type prefix
-} static const aDBFile[] =
+
+// Label name suffix counter, one per unique label
+struct tNAMECOUNT
 {
-	{"Interfaces.txt", "IID"},
-	{"Classes.txt",    "CLSID"},
-	//{"Libraries.txt",  "LIBID"}, // TODO:
+	LPCSTR pszLabel;
+	UINT   uNextSuffix; // Next free "_NN" suffix
+	UINT   uCollisions; // Hits that needed a suffix
+	BOOL   bBaseUsed;	// Label without suffix is taken
 };
-static const UINT DB_FILE_COUNT = (sizeof(aDBFile) / sizeof(tDB_ENTRY));
 
+// Incremental rescans: the fingerprints of the segments the last complete
+// run scanned, and the GUIDs it applied, are kept in a private netnode.
+// A segment with the same fingerprint has the same GUIDs, it's not scanned
+// again and its GUIDs are taken from there.
+#define STATE_NODE    "$ GUID-Finder"
+#define STATE_VERSION 3
+#define STATE_TAG     'V' // supval 0, tSTATE
+#define SEGMENTS_TAG  'S' // Blob, a tSEGSTATE per segment scanned
+#define HITS_TAG      'H' // Blob, the tSCANHITs applied, by address
 
-// GUID info container
-struct tGUIDNODE : public Container::NodeEx<Container::ListHT, tGUIDNODE>
+// Saved state header
+struct tSTATE
 {
-	tid_t StructID;
-	char  szGUID[48];
-	char  szLabel[48];
-	UINT  uHash;
-	#ifdef SAVE_FIXED
-	char  szGUIDCpy[48];
-	#endif
+	DWORD dwVersion;	 // STATE_VERSION
+	UINT  uSegmentCount;
+	UINT  uHitCount;
+	ULONGLONG uDBVersion; // ScanEngine::GetVersion()
+};
 
-	// Use IDA allocs
-	static PVOID operator new(size_t size){	return(qalloc(size)); };
-	static void operator delete(PVOID _Ptr){ return(qfree(_Ptr)); }
+// Segment scanned
+struct tSEGSTATE
+{
+	ea_t startEA, endEA;
+	ULONGLONG uFingerprint; // Of its bytes and the scan settings, see ScanEngine::ScanRange()
+	UINT uFirstHit, uHitCount; // Its GUIDs in the saved hits
 };
 
 
 // === Function Prototypes ===
 static BOOL LoadDB();
-static void RemoveGUIDList();
+static void CreateTypeStructs();
+static void FreeDB();
+static void FreeScanData();
+static BOOL IsAlignmentReliable(segment_t *pSegInfo, LPCSTR pszName, UINT uStride, LPSTR pszReason, UINT uReasonSize);
+static UINT ApplyHits();
+static BOOL BuildNameCounts();
+static void ReportNameCollisions();
+static void ApplyGUID(ea_t ea, UINT uEntry, UINT uForm);
+static void ApplyGUIDText(ea_t ea, UINT uEntry, UINT uForm);
+static void SaveResults(const tSCANHIT *pHits, UINT uHitCount);
+static void LoadState();
+static void SaveState(const tSCANHIT *pHits, UINT uHitCount);
+static const tSEGSTATE *FindOldSegment(ea_t startEA, ea_t endEA);
+static BOOL KeepOldHits(const tSEGSTATE &rOldSegment);
+static tSCANHIT *GetRunHits(UINT &ruHitCount);
+static void NameGUID(ea_t ea, UINT uEntry);
 static BOOL CheckBreak();
 static void SafeJumpTo(ea_t ea);
 
 
+// IDB bytes for the scan engine
+class IDBSource : public ByteSource
+{
+public:
+	ea_t NextLoaded(ea_t ea, ea_t endEA)
+	{
+		if(hasValue(getFlags(ea)))
+			return(ea);
+		return(nextthat(ea, endEA, HasValue, NULL));
+	}
+
+	ea_t RunEnd(ea_t ea, ea_t endEA)
+	{
+		ea_t runEndEA = nextthat(ea, endEA, HasNoValue, NULL);
+		if((runEndEA == BADADDR) || (runEndEA > endEA))
+			runEndEA = endEA;
+		return(runEndEA);
+	}
+
+	BOOL Read(ea_t ea, PBYTE pBuffer, UINT uSize){ return(get_many_bytes(ea, pBuffer, uSize)); }
+	BOOL CheckBreak(){ return(::CheckBreak()); }
+
+private:
+	// Flag tests for walking initialized ranges
+	static bool idaapi HasValue(flags_t F, void *ud){ return(hasValue(F)); }
+	static bool idaapi HasNoValue(flags_t F, void *ud){ return(!hasValue(F)); }
+};
+
+// Annotates the scan hits in the IDB
+class IDBSink : public HitSink
+{
+public:
+	void OnHit(ea_t ea, UINT uEntry, UINT uForm)
+	{
+		if((uForm == HIT_BINARY) || (uForm == HIT_RFC4122))
+			ApplyGUID(ea, uEntry, uForm);
+		else
+			ApplyGUIDText(ea, uEntry, uForm);
+	}
+
+	BOOL CheckBreak(){ return(::CheckBreak()); }
+};
+
+
 // === Data ===
-static ALIGN(16) Container::ListEx<Container::ListHT, tGUIDNODE> s_GUIDList;
+static GUIDDB s_DB(s_abStockDB, STOCKDB_SIZE, STOCKDB_STAMP);
+static ScanEngine s_Engine;
+static tid_t s_aStructID[CompiledDB::MAX_TYPES]; // GUID struct per compiled DB type
+static tNAMECOUNT *s_pNameCounts = NULL; // Sorted by label
+static UINT s_uNameCountSize = 0;
+static tNAMECOUNT **s_ppEntryNames = NULL; // Name counter per DB entry
+static ResultWriter s_Results; // Hits saved to a file, when open
+static tSEGSTATE *s_pOldSegments = NULL; // Last run's, by address
+static UINT s_uOldSegmentCount = 0;
+static tSCANHIT *s_pOldHits = NULL; // Last run's, by address, each old segment has its run of them
+static tSEGSTATE *s_pSegments = NULL; // This run's, by address, with OPTION_CHANGED
+static UINT s_uSegmentCount = 0;
+static tSCANHIT *s_pKeptHits = NULL; // Last run's, of the segments that didn't change, not applied again
+static UINT s_uKeptHitCount = 0, s_uKeptHitMax = 0;
+
+// Dialog options
+#define OPTION_SKIP_CODE 1 // Skip code and import segments
+#define OPTION_KEEP_DB   2 // Keep the GUID DB loaded between runs
+#define OPTION_TEXT      4 // Find text GUIDs too
+#define OPTION_RFC4122   8 // Find RFC 4122 byte order GUIDs too
+#define OPTION_SAVE     16 // Save the hits to a JSON Lines file next to the IDB
+#define OPTION_CHANGED  32 // Skip the segments that didn't change since the last run
+static WORD s_wOptions = (OPTION_SKIP_CODE | OPTION_KEEP_DB | OPTION_CHANGED);
 
 
 // Main dialog
@@ -71,9 +163,24 @@ static const char szMainDialog[] =
 	// Message text
 	"-Version: %A, %A, by Sirmabus-\n\n" 		
 
-	// checkbox -> wbSkipCodeAndIAT
+	// checkboxes -> s_wOptions
 	"<#Skip code and import segments to make searching faster.\nUsually ok, but some times GUIDs are in code segments too, in particular Delphi executables. #"
-	"Skip code segments for speed. :C>>\n"				
+	"Skip code segments for speed. :C>\n"				
+	"<#Keep the plug-in and the GUID database loaded so the next run doesn't have to load it again.\nIt's reloaded anyway if any of the DB files change. Unchecked, the plug-in is unloaded after each run. #"
+	"Keep GUID database loaded. :C>\n"
+	"<#Also find GUIDs stored as text, like \"{01234567-89AB-CDEF-0123-456789ABCDEF}\", in ASCII or UTF-16.\nThey're typed as strings. Done in the same pass, at any alignment. #"
+	"Find text GUIDs. :C>\n"
+	"<#Also find GUIDs stored in RFC 4122 (network) byte order, with Data1, Data2 and Data3 big endian.\nUsed by non-Windows code, network protocols, etc. Done in the same pass. #"
+	"Find RFC 4122 byte order GUIDs. :C>\n"
+	"<#Also save the GUIDs found to \"<IDB name>.guids.jsonl\" next to the IDB, a JSON object per line with\nthe address, file offset, segment, type, GUID, form and label. For scripts and other tools. #"
+	"Save results as JSON Lines. :C>\n"
+	"<#Don't rescan segments whose bytes haven't changed since the last run with the same GUID database\nand options, their GUIDs saved then are kept as applied. Uncheck to rescan and reapply everything. #"
+	"Skip unchanged segments. :C>>\n"
+
+	// radio -> wScanMode
+	"<#Test every byte offset. Slowest, but finds GUIDs at any address. #Exhaustive scan.:R>\n"
+	"<#Only test 4 byte aligned addresses. Compilers place GUID constants on 4 byte boundaries.\nSegments where alignment is unreliable (packed data, Delphi, etc.) are scanned exhaustively. #4 byte aligned scan.:R>\n"
+	"<#Only test 8 byte aligned addresses. Same fallback as above. #8 byte aligned scan.:R>>\n"
 	
 	"\n\n"
 };
@@ -89,7 +196,15 @@ void CORE_Init()
 // Un-initialize
 void CORE_Exit()
 {
-	RemoveGUIDList();
+	FreeScanData();
+	FreeDB();
+}
+
+
+// Stay loaded after the run? With the GUID DB kept.
+BOOL CORE_KeepLoaded()
+{
+	return((s_wOptions & OPTION_KEEP_DB) != 0);
 }
 
 
@@ -101,8 +216,8 @@ void CORE_Process(int iArg)
 
 	if(autoIsOk())
 	{
-		WORD wbSkipCodeAndIAT = TRUE;
-		int iUIResult = AskUsingForm_c(szMainDialog, MY_VERSION, __DATE__, &wbSkipCodeAndIAT);
+		WORD wScanMode = 0; // Exhaustive
+		int iUIResult = AskUsingForm_c(szMainDialog, MY_VERSION, __DATE__, &s_wOptions, &wScanMode);
 		if(!iUIResult)
 		{			
 			msg(" - Canceled -\n");				
@@ -110,16 +225,40 @@ void CORE_Process(int iArg)
 		}
 
 		// Load in GUID database
-		if(LoadDB())
+		if(LoadDB() && s_Engine.BuildIndex(s_DB, (s_wOptions & OPTION_RFC4122)))
 		{			
-			msg("\nScanning, <Press Pause/Break key to abort>...\n");
+			eSCANKERNEL eKernel = SetScanKernel(SCAN_AVX2);
+			if(!s_Engine.Start())
+			{
+				msg("\n*** Failed to start scan threads! ***\n");
+				FreeDB();
+				return;
+			}
+			msg("\nScanning with %s prefilter on %u threads, <Press Pause/Break key to abort>...\n", GetScanKernelName(eKernel), s_Engine.GetThreadCount());
 			// TODO: Add UI handler for "cancel"
 			show_wait_box("Working..\nTake a smoke, drink some coffee, this could be a while..  \n\n<Press Pause/Break key to abort>"); 
 
 			//TIMESTAMP StartTime = GetTimeStamp();
+			static const UINT aStride[] = { 1, 4, 8 };
+			UINT uStride = aStride[(wScanMode < 3) ? wScanMode : 0];
+			UINT uFlags = ((s_wOptions & OPTION_TEXT) ? SCAN_TEXT : 0);
+			s_Engine.Reset();
+			IDBSource Source;
+
+			// Segments the aligned scan fell back to exhaustive on
+			char szFallbackReport[2048] = {0};
+			UINT uFallbackCount = 0;
+
+			// Last run's segments, and room for this run's
+			int iSegCount = get_segm_qty();
+			UINT uUnchanged = 0;
+			if((s_wOptions & OPTION_CHANGED) && (iSegCount > 0))
+			{
+				LoadState();
+				s_pSegments = (tSEGSTATE *) qalloc(sizeof(tSEGSTATE) * iSegCount);
+			}
 			
 			// Walk through segments
-			int iSegCount = get_segm_qty();              
 			for(int i = 0; i < iSegCount; i++)
 			{                            
 				if(segment_t *pSegInfo = getnseg(i))
@@ -133,72 +272,49 @@ void CORE_Process(int iArg)
 					get_segm_class(pSegInfo, szClass, (sizeof(szClass) - 1));
 
 					// Skip code and import/export segs?
-					if(wbSkipCodeAndIAT && ((pSegInfo->type == SEG_CODE) || (pSegInfo->type == SEG_XTRN)))		
+					if((s_wOptions & OPTION_SKIP_CODE) && ((pSegInfo->type == SEG_CODE) || (pSegInfo->type == SEG_XTRN)))		
 						msg("Seg: %6s, %s, (%08X - %08X) SKIPPED\n", szName, szClass, startEA, endEA);
 					else
 					{
-						msg("Seg: %6s, %s, (%08X - %08X) ..\n", szName, szClass, startEA, endEA);
-									
-						tGUIDNODE *pNode = s_GUIDList.GetHead();
-						while(pNode)
-						{	
-							//msg("Looking for: \"%s\", \"%s\".\n", pNode->szLabel, pNode->szGUID);				
-							//while(!_kbhit()) Sleep(100);
-
-							ea_t ea = startEA;
-							while((ea = find_binary(ea, endEA, pNode->szGUID, 0, (SEARCH_DOWN | SEARCH_NEXT | SEARCH_NOSHOW))) != BADADDR)
-							{
-								msg("%08X %s\n", ea, pNode->szLabel);
-
-								jumpto(ea, 0);
-								autoWait();								
-								do_unknown(ea, FALSE);
-								auto_mark_range(ea, (ea + sizeof(GUID)), AU_UNK);
-
-								// Place GUID struct here                             
-								if(pNode->StructID != BADADDR)
-								{
-									if(!doStruct(ea, sizeof(GUID), pNode->StructID))
-										msg("  %08X *** Set struct failed! ***\n", ea);
-								}
-								
-								// Label it
-								#define NAME_FLAGS (SN_AUTO | SN_NOCHECK | SN_NOWARN)                             
-								if(!set_name(ea, pNode->szLabel, NAME_FLAGS))
-								{	
-									// Can't name it if it's a tail byte (fixes hang-up bug)
-									if(isTail(getFlags(ea)))									
-										msg("  %08X *** \"Tail\" byte here, failed to set name! ***\n", ea);									
-									else
-									{
-										// Must already exist, append w/reference count suffix
-										for(UINT i = 0; i < 0x7FFFFFFF; i++)
-										{
-											char szName[256] = {0};
-											qsnprintf(szName, (sizeof(szName) - 1), "%s_%02u", pNode->szLabel, i);
-											//msg("    TRY[%u]: \"%s\" F: %d.\n", i, szName, isTail(getFlags(ea)));
-											if(set_name(ea, szName, NAME_FLAGS))
-												break;                                     
-										}
-									}
-								}
-								#undef NAME_FLAGS
-
-								// Anterior comment separator
-								//describe(ea, TRUE, ";");
-
-								// Add comment																							
-								char szComment[512];
-								qsnprintf(szComment, (sizeof(szComment) - 1), "GUID %s", pNode->szLabel);
-								set_cmt(ea, szComment, TRUE);
-							};
-							
-							// User abort?
-							if(CheckBreak())
+						// Aligned scan unreliable here?
+						UINT uSegStride = uStride;
+						char szReason[128];
+						if((uStride > 1) && !IsAlignmentReliable(pSegInfo, szName, uStride, szReason, sizeof(szReason)))
+						{
+							UINT uLength = strlen(szFallbackReport);
+							qsnprintf((szFallbackReport + uLength), (sizeof(szFallbackReport) - uLength), "  %6s (%08X - %08X) %s\n", szName, startEA, endEA, szReason);
+							uFallbackCount++;
+							uSegStride = 1;
+						}
+
+						msg("Seg: %6s, %s, (%08X - %08X) %s..\n", szName, szClass, startEA, endEA, ((uSegStride == 1) ? "" : ((uSegStride == 4) ? "4 aligned " : "8 aligned ")));
+						tSEGSTATE *pSegment = NULL;
+						if(s_pSegments)
+						{
+							pSegment = &s_pSegments[s_uSegmentCount++];
+							pSegment->startEA = startEA;
+							pSegment->endEA = endEA;
+							pSegment->uFingerprint = 0;
+						}
+
+						// Same bytes and settings as last run? Then its GUIDs are already applied, keep them without scanning.
+						// Only hashed here, a changed segment is read again by the scan.
+						if(const tSEGSTATE *pOldSegment = (pSegment ? FindOldSegment(startEA, endEA) : NULL))
+						{
+							pSegment->uFingerprint = s_Engine.FingerprintRange(Source, startEA, endEA, uSegStride, uFlags);
+							if(s_Engine.IsAborted())
 								goto BailOut;
+							if((pSegment->uFingerprint == pOldSegment->uFingerprint) && KeepOldHits(*pOldSegment))
+							{
+								msg("  unchanged, %u GUIDs kept as applied.\n", pOldSegment->uHitCount);
+								uUnchanged++;
+								continue;
+							}
+						}
 
-							pNode = pNode->GetNext();
-						};
+						s_Engine.ScanRange(Source, startEA, endEA, uSegStride, uFlags, (pSegment ? &pSegment->uFingerprint : NULL));
+						if(s_Engine.IsAborted())
+							goto BailOut;
 					}
 				}
 			}
@@ -212,8 +328,57 @@ void CORE_Process(int iArg)
 			// Test .data and .rdata only: 27.5386 Seconds.			
 			// Walking segments .data and .rdata: 27.7137 Seconds.
 
+			if(uFallbackCount)
+				msg("\nAligned scan unreliable, scanned exhaustively instead, %u segment(s):\n%s", uFallbackCount, szFallbackReport);
+			s_Engine.Stop();
+			msg("\n%u GUIDs found, %.2f MB scanned.\n", (s_uKeptHitCount + s_Engine.GetHitCount()), ((double) s_Engine.GetBytesRead() / (1024.0 * 1024.0)));
+			if(uUnchanged)
+				msg("%u segment(s) unchanged since the last run and not scanned, their %u GUIDs kept as applied then.\n", uUnchanged, s_uKeptHitCount);
+
+			// Annotate them all in one pass
+			BOOL bComplete = (!s_Engine.IsAborted() && !s_Engine.GetDroppedCount());
+			if(s_Engine.GetHitCount())
+			{
+				msg("\nApplying..\n");
+				if(!BuildNameCounts())
+				{
+					msg("*** Failed to allocate name counters! ***\n");
+					bComplete = FALSE;
+				}
+				else
+				{
+					UINT uApplied = ApplyHits();
+					if(uApplied < s_Engine.GetHitCount())
+					{
+						msg("%u of %u GUIDs applied.\n", uApplied, s_Engine.GetHitCount());
+						bComplete = FALSE;
+					}
+					ReportNameCollisions();
+				}
+			}
+
+			// Every GUID, the kept ones too, for the results file and the next run.
+			// A run cut short leaves the last state, what it didn't apply still matches it.
+			BOOL bSaveState = (bComplete && s_pSegments);
+			if((s_wOptions & OPTION_SAVE) || bSaveState)
+			{
+				UINT uRunHitCount = 0;
+				if(tSCANHIT *pRunHits = GetRunHits(uRunHitCount))
+				{
+					if(s_wOptions & OPTION_SAVE)
+						SaveResults(pRunHits, uRunHitCount);
+					if(bSaveState)
+						SaveState(pRunHits, uRunHitCount);
+					qfree(pRunHits);
+				}
+				else
+					msg("*** Failed to allocate the GUID list! ***\n");
+			}
+
 			// Clean up
-			RemoveGUIDList();
+			FreeScanData();
+			if(!(s_wOptions & OPTION_KEEP_DB))
+				FreeDB();
 			hide_wait_box();
 			msg("\nFinsihed.\n-------------------------------------------------------------\n");
 		}		
@@ -226,14 +391,542 @@ void CORE_Process(int iArg)
 }
 
 
-// Delete GUID list
-static void RemoveGUIDList()
+// Unload the DB and its index
+static void FreeDB()
+{
+	s_Engine.FreeIndex();
+	s_DB.Free();
+}
+
+// Free the per run scan and apply data
+static void FreeScanData()
+{
+	s_Engine.Reset();
+
+	if(s_pNameCounts)
+	{
+		qfree(s_pNameCounts);
+		s_pNameCounts = NULL;
+		s_uNameCountSize = 0;
+	}
+	if(s_ppEntryNames)
+	{
+		qfree(s_ppEntryNames);
+		s_ppEntryNames = NULL;
+	}
+
+	if(s_pOldSegments) { qfree(s_pOldSegments); s_pOldSegments = NULL; }
+	if(s_pOldHits)	   { qfree(s_pOldHits);		s_pOldHits = NULL; }
+	if(s_pSegments)    { qfree(s_pSegments);	s_pSegments = NULL; }
+	if(s_pKeptHits)	   { qfree(s_pKeptHits);	s_pKeptHits = NULL; }
+	s_uOldSegmentCount = s_uSegmentCount = 0;
+	s_uKeptHitCount = s_uKeptHitMax = 0;
+}
+
+
+// Apply all the scan hits in address order. No per hit jump or analysis
+// wait, the analyzer catches up once at the end.
+// Returns count applied.
+static UINT ApplyHits()
+{
+	IDBSink Sink;
+	UINT uApplied = s_Engine.ApplyHits(Sink);
+
+	autoWait();
+	jumpto(s_Engine.GetHits()[0].ea, 0);
+	return(uApplied);
+}
+
+// Save the run's GUIDs to "<IDB name>.guids.jsonl" next to the IDB
+static void SaveResults(const tSCANHIT *pHits, UINT uHitCount)
+{
+	char szPath[QMAXPATH];
+	qstrncpy(szPath, database_idb, (sizeof(szPath) - 16));
+	LPSTR pszExt = strrchr(szPath, '.');
+	if(!pszExt || strpbrk(pszExt, "\\/"))
+		pszExt = (szPath + strlen(szPath));
+	qstrncpy(pszExt, ".guids.jsonl", 16);
+	if(!s_Results.Open(szPath, RESULT_JSONL, s_DB))
+	{
+		msg("*** Failed to create \"%s\"! ***\n", szPath);
+		return;
+	}
+
+	for(UINT i = 0; i < uHitCount; i++)
+	{
+		ea_t ea = pHits[i].ea;
+		char szSegment[128] = {0};
+		tRESULT tResult;
+		tResult.pszFile = NULL;
+		tResult.ea = ea;
+		tResult.uEntry = pHits[i].uKey;
+		tResult.uForm = pHits[i].uForm;
+		tResult.pszSegment = NULL;
+		if(segment_t *pSegInfo = getseg(ea))
+		{
+			get_segm_name(pSegInfo, szSegment, (sizeof(szSegment) - 1));
+			tResult.pszSegment = szSegment;
+		}
+		int32 iOffset = get_fileregion_offset(ea);
+		tResult.uOffset = ((iOffset >= 0) ? (UINT) iOffset : BADADDR);
+		s_Results.Write(tResult);
+	}
+
+	if(s_Results.Close())
+		msg("%u GUIDs saved to \"%s\".\n", uHitCount, szPath);
+	else
+		msg("*** Failed to write \"%s\"! ***\n", szPath);
+}
+
+
+// The run's GUIDs, found and kept, in a qalloc()'d list by address
+static tSCANHIT *GetRunHits(UINT &ruHitCount)
+{
+	ruHitCount = (s_uKeptHitCount + s_Engine.GetHitCount());
+	tSCANHIT *pHits = (tSCANHIT *) qalloc(sizeof(tSCANHIT) * (ruHitCount + 1));
+	if(!pHits)
+		return(NULL);
+	if(s_uKeptHitCount)
+		memcpy(pHits, s_pKeptHits, (sizeof(tSCANHIT) * s_uKeptHitCount));
+	if(s_Engine.GetHitCount())
+		memcpy((pHits + s_uKeptHitCount), s_Engine.GetHits(), (sizeof(tSCANHIT) * s_Engine.GetHitCount()));
+	if(ruHitCount)
+		qsort(pHits, ruHitCount, sizeof(tSCANHIT), ScanEngine::CompareHit);
+	return(pHits);
+}
+
+
+// Load the last run's segments and GUIDs, if they're from the same DB and options
+static void LoadState()
 {
-	while(tGUIDNODE *pHeadNode = s_GUIDList.GetHead())
-	{		
-		s_GUIDList.RemoveHead();
-		delete pHeadNode;
-	};
+	netnode Node(STATE_NODE);
+	if(Node == BADNODE)
+		return;
+
+	tSTATE tState;
+	if((Node.supval(0, &tState, sizeof(tState), STATE_TAG) != sizeof(tState)) || (tState.dwVersion != STATE_VERSION))
+		return;
+	if(tState.uDBVersion != s_Engine.GetVersion())
+	{
+		msg("GUID database or options changed since the last run, scanning every segment.\n");
+		return;
+	}
+
+	size_t uSegmentsSize = (sizeof(tSEGSTATE) * tState.uSegmentCount);
+	size_t uHitsSize = (sizeof(tSCANHIT) * tState.uHitCount);
+	if(!uSegmentsSize || (Node.blobsize(0, SEGMENTS_TAG) != uSegmentsSize) || (uHitsSize && (Node.blobsize(0, HITS_TAG) != uHitsSize)))
+		return;
+	s_pOldSegments = (tSEGSTATE *) qalloc(uSegmentsSize);
+	s_pOldHits = (tSCANHIT *) qalloc(uHitsSize + sizeof(tSCANHIT));
+	if(s_pOldSegments && s_pOldHits && Node.getblob(s_pOldSegments, &uSegmentsSize, 0, SEGMENTS_TAG) && (!uHitsSize || Node.getblob(s_pOldHits, &uHitsSize, 0, HITS_TAG)))
+	{
+		// Each segment's GUIDs have to be in the list
+		UINT i = 0;
+		for(; i < tState.uSegmentCount; i++)
+		{
+			const tSEGSTATE &rOldSegment = s_pOldSegments[i];
+			if((rOldSegment.uFirstHit > tState.uHitCount) || (rOldSegment.uHitCount > (tState.uHitCount - rOldSegment.uFirstHit)))
+				break;
+		}
+		if(i == tState.uSegmentCount)
+		{
+			s_uOldSegmentCount = tState.uSegmentCount;
+			return;
+		}
+	}
+
+	if(s_pOldSegments) { qfree(s_pOldSegments); s_pOldSegments = NULL; }
+	if(s_pOldHits)	   { qfree(s_pOldHits);		s_pOldHits = NULL; }
+}
+
+// The last run's segment with this range, if it had one
+static const tSEGSTATE *FindOldSegment(ea_t startEA, ea_t endEA)
+{
+	for(UINT i = 0; i < s_uOldSegmentCount; i++)
+	{
+		const tSEGSTATE &rOldSegment = s_pOldSegments[i];
+		if((rOldSegment.startEA == startEA) && (rOldSegment.endEA == endEA))
+			return(&rOldSegment);
+	}
+	return(NULL);
+}
+
+// Keep the GUIDs the last run applied in an unchanged segment, so they're
+// not scanned for or applied again. FALSE if they don't belong to it.
+static BOOL KeepOldHits(const tSEGSTATE &rOldSegment)
+{
+	const tSCANHIT *pHits = (s_pOldHits + rOldSegment.uFirstHit);
+	UINT uCount = rOldSegment.uHitCount;
+	for(UINT i = 0; i < uCount; i++)
+	{
+		if((pHits[i].ea < rOldSegment.startEA) || (pHits[i].ea >= rOldSegment.endEA) || (pHits[i].uKey >= s_DB.GetCount()) || (pHits[i].uForm >= HIT_FORM_COUNT))
+			return(FALSE);
+	}
+
+	if((s_uKeptHitCount + uCount) > s_uKeptHitMax)
+	{
+		UINT uMax = (((s_uKeptHitMax * 2) > (s_uKeptHitCount + uCount)) ? (s_uKeptHitMax * 2) : (s_uKeptHitCount + uCount));
+		tSCANHIT *pNewHits = (tSCANHIT *) qrealloc(s_pKeptHits, (sizeof(tSCANHIT) * (uMax + 1)));
+		if(!pNewHits)
+			return(FALSE);
+		s_pKeptHits = pNewHits;
+		s_uKeptHitMax = uMax;
+	}
+	if(uCount)
+		memcpy((s_pKeptHits + s_uKeptHitCount), pHits, (sizeof(tSCANHIT) * uCount));
+	s_uKeptHitCount += uCount;
+	return(TRUE);
+}
+
+// Save this run's segments and GUIDs, "pHits" by address, for the next one.
+// The header goes last, so a state only part written is never used.
+static void SaveState(const tSCANHIT *pHits, UINT uHitCount)
+{
+	netnode Node(STATE_NODE, 0, true);
+	Node.supdel(0, STATE_TAG);
+	Node.delblob(0, SEGMENTS_TAG);
+	Node.delblob(0, HITS_TAG);
+	if(!s_uSegmentCount)
+		return;
+
+	// Each segment's run of the hits, segments are by address too
+	UINT uHit = 0;
+	for(UINT i = 0; i < s_uSegmentCount; i++)
+	{
+		tSEGSTATE &rSegment = s_pSegments[i];
+		while((uHit < uHitCount) && (pHits[uHit].ea < rSegment.startEA))
+			uHit++;
+		rSegment.uFirstHit = uHit;
+		while((uHit < uHitCount) && (pHits[uHit].ea < rSegment.endEA))
+			uHit++;
+		rSegment.uHitCount = (uHit - rSegment.uFirstHit);
+	}
+
+	BOOL bSaved = Node.setblob(s_pSegments, (sizeof(tSEGSTATE) * s_uSegmentCount), 0, SEGMENTS_TAG);
+	if(bSaved && uHitCount)
+		bSaved = Node.setblob(pHits, (sizeof(tSCANHIT) * uHitCount), 0, HITS_TAG);
+	if(bSaved)
+	{
+		tSTATE tState;
+		tState.dwVersion = STATE_VERSION;
+		tState.uSegmentCount = s_uSegmentCount;
+		tState.uHitCount = uHitCount;
+		tState.uDBVersion = s_Engine.GetVersion();
+		bSaved = Node.supset(0, &tState, sizeof(tState), STATE_TAG);
+	}
+	if(!bSaved)
+	{
+		msg("*** Failed to save the segment state, the next run scans everything! ***\n");
+		Node.kill();
+	}
+}
+
+
+static int __cdecl CompareEntryLabel(const void *pA, const void *pB)
+{
+	UINT a = s_DB.GetLabelOffset(*((const UINT *) pA)), b = s_DB.GetLabelOffset(*((const UINT *) pB));
+	return((a < b) ? -1 : ((a > b) ? 1 : 0));
+}
+
+static int __cdecl CompareNameCount(const void *pA, const void *pB)
+{
+	return(strcmp(((const tNAMECOUNT *) pA)->pszLabel, ((const tNAMECOUNT *) pB)->pszLabel));
+}
+
+static tNAMECOUNT *FindNameCount(LPCSTR pszLabel)
+{
+	tNAMECOUNT tKey = { pszLabel };
+	return((tNAMECOUNT *) bsearch(&tKey, s_pNameCounts, s_uNameCountSize, sizeof(tNAMECOUNT), CompareNameCount));
+}
+
+// Split a "label_NN" name; returns the label length with the suffix value
+// in "ruSuffix", or the whole length with -1 if there's no suffix.
+static UINT SplitSuffix(LPCSTR pszName, UINT &ruSuffix)
+{
+	UINT uLength = strlen(pszName);
+	ruSuffix = (UINT) -1;
+
+	UINT uDigits = 0;
+	while((uDigits < uLength) && (uDigits < 9) && (pszName[uLength - uDigits - 1] >= '0') && (pszName[uLength - uDigits - 1] <= '9'))
+		uDigits++;
+	if(uDigits && (uDigits < uLength) && (pszName[uLength - uDigits - 1] == '_'))
+	{
+		ruSuffix = atoi(pszName + (uLength - uDigits));
+		return(uLength - uDigits - 1);
+	}
+	return(uLength);
+}
+
+// Build per label name suffix counters, seeded once from the names already in the IDB,
+// so a unique name for each hit takes one set_name() call.
+static BOOL BuildNameCounts()
+{
+	UINT uEntries = s_DB.GetCount();
+	if(!uEntries)
+		return(TRUE);
+
+	UINT *puOrder  = (UINT *) qalloc(sizeof(UINT) * uEntries);
+	s_pNameCounts  = (tNAMECOUNT *)  qalloc(sizeof(tNAMECOUNT) * uEntries);
+	s_ppEntryNames = (tNAMECOUNT **) qalloc(sizeof(tNAMECOUNT *) * uEntries);
+	if(!puOrder || !s_pNameCounts || !s_ppEntryNames)
+	{
+		if(puOrder) qfree(puOrder);
+		return(FALSE);
+	}
+
+	// Entries by label. Equal labels share a string table offset, and offsets
+	// are in label order, so the counters come out sorted by label.
+	for(UINT i = 0; i < uEntries; i++)
+		puOrder[i] = i;
+	qsort(puOrder, uEntries, sizeof(UINT), CompareEntryLabel);
+
+	// One counter per unique label
+	s_uNameCountSize = 0;
+	for(UINT i = 0; i < uEntries; i++)
+	{
+		LPCSTR pszLabel = s_DB.GetLabel(puOrder[i]);
+		if(!s_uNameCountSize || (s_pNameCounts[s_uNameCountSize - 1].pszLabel != pszLabel))
+		{
+			tNAMECOUNT *pCount = &s_pNameCounts[s_uNameCountSize++];
+			pCount->pszLabel = pszLabel;
+			pCount->uNextSuffix = pCount->uCollisions = 0;
+			pCount->bBaseUsed = FALSE;
+		}
+		s_ppEntryNames[puOrder[i]] = &s_pNameCounts[s_uNameCountSize - 1];
+	}
+	qfree(puOrder);
+
+	// Seed from existing names
+	size_t uNames = get_nlist_size();
+	for(size_t j = 0; j < uNames; j++)
+	{
+		LPCSTR pszName = get_nlist_name(j);
+		if(!pszName)
+			continue;
+
+		if(tNAMECOUNT *pCount = FindNameCount(pszName))
+			pCount->bBaseUsed = TRUE;
+
+		UINT uSuffix;
+		UINT uLength = SplitSuffix(pszName, uSuffix);
+		if((uSuffix != (UINT) -1) && (uLength < MAXNAMELEN))
+		{
+			char szLabel[MAXNAMELEN];
+			memcpy(szLabel, pszName, uLength);
+			szLabel[uLength] = 0;
+			if(tNAMECOUNT *pCount = FindNameCount(szLabel))
+			{
+				if(uSuffix >= pCount->uNextSuffix)
+					pCount->uNextSuffix = (uSuffix + 1);
+			}
+		}
+	}
+
+	return(TRUE);
+}
+
+static int __cdecl CompareCollisions(const void *pA, const void *pB)
+{
+	UINT a = (*((tNAMECOUNT **) pA))->uCollisions, b = (*((tNAMECOUNT **) pB))->uCollisions;
+	return((a > b) ? -1 : ((a < b) ? 1 : 0));
+}
+
+// Report labels that needed suffixes, most first
+static void ReportNameCollisions()
+{
+	UINT uLabels = 0, uTotal = 0;
+	for(UINT i = 0; i < s_uNameCountSize; i++)
+	{
+		if(s_pNameCounts[i].uCollisions)
+		{
+			uLabels++;
+			uTotal += s_pNameCounts[i].uCollisions;
+		}
+	}
+	if(!uLabels)
+		return;
+
+	msg("\nName collisions, %u label(s) needed %u suffixed name(s):\n", uLabels, uTotal);
+	if(tNAMECOUNT **ppCounts = (tNAMECOUNT **) qalloc(sizeof(tNAMECOUNT *) * uLabels))
+	{
+		UINT uCount = 0;
+		for(UINT i = 0; i < s_uNameCountSize; i++)
+		{
+			if(s_pNameCounts[i].uCollisions)
+				ppCounts[uCount++] = &s_pNameCounts[i];
+		}
+		qsort(ppCounts, uCount, sizeof(tNAMECOUNT *), CompareCollisions);
+
+		const UINT MAX_REPORT = 50;
+		for(UINT i = 0; (i < uCount) && (i < MAX_REPORT); i++)
+			msg("  %5u %s\n", ppCounts[i]->uCollisions, ppCounts[i]->pszLabel);
+		if(uCount > MAX_REPORT)
+			msg("  ..and %u more.\n", (uCount - MAX_REPORT));
+		qfree(ppCounts);
+	}
+}
+
+
+// Returns FALSE with a reason if GUIDs in this segment might not be aligned to "uStride"
+static BOOL IsAlignmentReliable(segment_t *pSegInfo, LPCSTR pszName, UINT uStride, LPSTR pszReason, UINT uReasonSize)
+{
+	// Data mixed in with code is often packed
+	if(pSegInfo->type == SEG_CODE)
+	{
+		qstrncpy(pszReason, "code segment", uReasonSize);
+		return(FALSE);
+	}
+
+	// Delphi/Borland linker segments, data is packed
+	if((strcmp(pszName, "CODE") == 0) || (strcmp(pszName, "DATA") == 0) || (strcmp(pszName, "BSS") == 0))
+	{
+		qstrncpy(pszReason, "Delphi/Borland segment", uReasonSize);
+		return(FALSE);
+	}
+
+	// Byte or word aligned segments
+	if((pSegInfo->align == saRelByte) || (pSegInfo->align == saRelWord))
+	{
+		qstrncpy(pszReason, "byte/word aligned segment", uReasonSize);
+		return(FALSE);
+	}
+
+	// Segment base not on a stride boundary, so section relative alignment is lost
+	if(pSegInfo->startEA % uStride)
+	{
+		qsnprintf(pszReason, uReasonSize, "segment start not %u byte aligned", uStride);
+		return(FALSE);
+	}
+
+	return(TRUE);
+}
+
+
+// Give a GUID a unique name from its label's suffix counter
+static void NameGUID(ea_t ea, UINT uEntry)
+{
+	#define NAME_FLAGS (SN_AUTO | SN_NOCHECK | SN_NOWARN)
+	tNAMECOUNT *pCount = s_ppEntryNames[uEntry];
+
+	// Already named from a previous run?
+	char szName[MAXNAMELEN];
+	if(get_true_name(BADADDR, ea, szName, sizeof(szName)))
+	{
+		UINT uSuffix;
+		if(strcmp(szName, pCount->pszLabel) == 0)
+			return;
+		if((SplitSuffix(szName, uSuffix) == strlen(pCount->pszLabel)) && (strncmp(szName, pCount->pszLabel, strlen(pCount->pszLabel)) == 0))
+			return;
+	}
+
+	if(!pCount->bBaseUsed)
+	{
+		pCount->bBaseUsed = TRUE;
+		if(set_name(ea, pCount->pszLabel, NAME_FLAGS))
+			return;
+	}
+
+	// Label taken, append the next suffix.
+	// Only retry in case something was named out from under the counter.
+	pCount->uCollisions++;
+	for(UINT i = 0; i < 8; i++)
+	{
+		qsnprintf(szName, (sizeof(szName) - 1), "%s_%02u", pCount->pszLabel, pCount->uNextSuffix++);
+		if(set_name(ea, szName, NAME_FLAGS))
+			return;
+
+		// Can't name it if it's a tail byte (fixes hang-up bug)
+		if(isTail(getFlags(ea)))
+		{
+			msg("  %08X *** \"Tail\" byte here, failed to set name! ***\n", ea);
+			return;
+		}
+	}
+	msg("  %08X *** Failed to set name! ***\n", ea);
+	#undef NAME_FLAGS
+}
+
+
+// Place GUID struct, name and comment at the given address.
+// The GUID struct is Microsoft order, RFC 4122 order ones are made a byte array.
+static void ApplyGUID(ea_t ea, UINT uEntry, UINT uForm)
+{
+	LPCSTR pszLabel = s_DB.GetLabel(uEntry);
+	BOOL bRFC4122 = (uForm == HIT_RFC4122);
+	msg("%08X %s%s\n", ea, pszLabel, (bRFC4122 ? " (RFC 4122 order)" : ""));
+
+	// Clear whatever is over it
+	do_unknown_range(ea, sizeof(GUID), FALSE);
+
+	// Place GUID struct here                             
+	tid_t StructID = s_aStructID[s_DB.GetType(uEntry)];
+	if(bRFC4122)
+	{
+		if(!doByte(ea, sizeof(GUID)))
+			msg("  %08X *** Set byte array failed! ***\n", ea);
+	}
+	else
+	if(StructID != BADADDR)
+	{
+		if(!doStruct(ea, sizeof(GUID), StructID))
+			msg("  %08X *** Set struct failed! ***\n", ea);
+	}
+	
+	// Label it
+	NameGUID(ea, uEntry);
+
+	// Anterior comment separator
+	//describe(ea, TRUE, ";");
+
+	// Add comment																							
+	char szComment[512];
+	qsnprintf(szComment, (sizeof(szComment) - 1), (bRFC4122 ? "GUID %s, RFC 4122 byte order" : "GUID %s"), pszLabel);
+	set_cmt(ea, szComment, TRUE);
+}
+
+
+// Text GUID char at "ea", "uChar" is the char size
+static inline UINT GetTextChar(ea_t ea, UINT uChar)
+{
+	if(!isLoaded(ea) || ((uChar == 2) && !isLoaded(ea + 1)))
+		return((UINT) -1);
+	return((uChar == 2) ? get_word(ea) : get_byte(ea));
+}
+
+// Type a text GUID as a string, and name and comment it
+static void ApplyGUIDText(ea_t ea, UINT uEntry, UINT uForm)
+{
+	LPCSTR pszLabel = s_DB.GetLabel(uEntry);
+	UINT uChar = ((uForm == HIT_UTF16) ? 2 : 1);
+	msg("%08X %s (%s text)\n", ea, pszLabel, ((uChar == 2) ? "UTF-16" : "ASCII"));
+
+	// Take in the braces and terminator if they're there
+	ea_t startEA = ea, endEA = (ea + (TEXT_GUID_LENGTH * uChar));
+	if((GetTextChar((startEA - uChar), uChar) == '{') && (GetTextChar(endEA, uChar) == '}'))
+	{
+		startEA -= uChar;
+		endEA += uChar;
+	}
+	if(GetTextChar(endEA, uChar) == 0)
+		endEA += uChar;
+
+	char szComment[512];
+	qsnprintf(szComment, (sizeof(szComment) - 1), "GUID text %s", pszLabel);
+
+	// Inside a longer string already, just comment it
+	ea_t headEA = get_item_head(startEA);
+	flags_t Flags = getFlags(headEA);
+	if(isASCII(Flags) && ((headEA != startEA) || (get_item_end(headEA) > endEA)))
+	{
+		set_cmt(headEA, szComment, TRUE);
+		return;
+	}
+
+	do_unknown_range(startEA, (endEA - startEA), FALSE);
+	if(!make_ascii_string(startEA, (endEA - startEA), ((uChar == 2) ? ASCSTR_UNICODE : ASCSTR_C)))
+		msg("  %08X *** Set string failed! ***\n", startEA);
+	NameGUID(startEA, uEntry);
+	set_cmt(startEA, szComment, TRUE);
 }
 
 
@@ -250,198 +943,84 @@ static BOOL CheckBreak()
 }
 
 
-// Load in GUID database
+// Load in GUID database, see GUIDDB.
+// The type list, text DB files and compiled DB are all looked for in the
+// plug-in's "GUID-Finder" folder.
 static BOOL LoadDB()
 {
-	// Load it dynamically to allow DB edits between invocations
-	RemoveGUIDList();
-
-	// Iterate through DB list loading all the GUIDs	
-	for(int i = 0; i < DB_FILE_COUNT; i++)
-	{	
-		// Load next DB file
-		msg("Loading \"%s\"..\n", aDBFile[i].pszFileName);
-		UINT uGUIDCount = 0;
-		int iFileLine = 0;		
-		char szPath[MAX_PATH] = {0};
-		getsysfile(szPath, (MAX_PATH - 1), aDBFile[i].pszFileName, "plugins\\GUID-Finder");	
-		if(FILE *fp = qfopen(szPath, "rb"))
-		{
-			// Create GUID struct for this type
-			tid_t StructID = get_struc_id(aDBFile[i].pszType);
-			if(StructID == BADADDR)
-			{
-				// Create it
-				if((StructID = add_struc(BADADDR, aDBFile[i].pszType)) != BADADDR)
-				{									
-					if(struc_t *ptStuctInfo = get_struc(StructID))
-					{						
-						add_struc_member(ptStuctInfo, "Data1", 0x0, dwrdflag(), NULL, 4);
-						add_struc_member(ptStuctInfo, "Data2", 0x4, wordflag(), NULL, 2);
-						add_struc_member(ptStuctInfo, "Data3", 0x6, wordflag(), NULL, 2);
-						add_struc_member(ptStuctInfo, "Data4", 0x8, byteflag(), NULL, 8);
-					}
-				}
-			}		
-			if(StructID == BADADDR)
-				msg("*** Failed to build structure for GUID type \"%s\"! ***\n", aDBFile[i].pszType);
-
-			// Iterate through text lines..
-			char szLine[512]; 
-			szLine[sizeof(szLine) - 1] = 0;
-			while(qfgets(szLine, (sizeof(szLine) - 1), fp))
-			{ 
-				++iFileLine;
-
-				// Skip comment and blank lines
-				if((szLine[0] && szLine[1] && szLine[2]) && (szLine[0] != '#'))
-				{
-					// Parse fields
-					char szGUID[256]; 
-					char szLabel[256]; 
-					szGUID[sizeof(szGUID) - 1] = 0;
-					szLabel[sizeof(szLabel) - 1] = 0;
-
-					if(_snscanf(szLine, (sizeof(szLine) - 1), "%255s %255s", szGUID, szLabel) == 2)
-					{
-						_strupr(szGUID);
-						
-						// New GUID container
-						if(tGUIDNODE *pNode = new tGUIDNODE())
-						{			
-							// GUID search string quick'n dirty
-
-							// Data1
-							pNode->szGUID[ 0] = szGUID[ 6];
-							pNode->szGUID[ 1] = szGUID[ 7];
-							pNode->szGUID[ 2] = ' ';
-							pNode->szGUID[ 3] = szGUID[ 4];
-							pNode->szGUID[ 4] = szGUID[ 5];
-							pNode->szGUID[ 5] = ' ';
-							pNode->szGUID[ 6] = szGUID[ 2];
-							pNode->szGUID[ 7] = szGUID[ 3];
-							pNode->szGUID[ 8] = ' ';
-							pNode->szGUID[ 9] = szGUID[ 0];
-							pNode->szGUID[10] = szGUID[ 1];
-							pNode->szGUID[11] = ' ';
-
-							// Data 2
-							pNode->szGUID[12] = szGUID[11];
-							pNode->szGUID[13] = szGUID[12];
-							pNode->szGUID[14] = ' ';
-							pNode->szGUID[15] = szGUID[9];
-							pNode->szGUID[16] = szGUID[10];
-							pNode->szGUID[17] = ' ';
-
-							// Data3
-							pNode->szGUID[18] = szGUID[16];
-							pNode->szGUID[19] = szGUID[17];
-							pNode->szGUID[20] = ' ';
-							pNode->szGUID[21] = szGUID[14];
-							pNode->szGUID[22] = szGUID[15];
-							pNode->szGUID[23] = ' ';
-
-							// Data4-1
-							pNode->szGUID[24] = szGUID[19];
-							pNode->szGUID[25] = szGUID[20];
-							pNode->szGUID[26] = ' ';
-							pNode->szGUID[27] = szGUID[21];
-							pNode->szGUID[28] = szGUID[22];
-							pNode->szGUID[29] = ' ';
-
-							// Data4-2
-							pNode->szGUID[30] = szGUID[24];
-							pNode->szGUID[31] = szGUID[25];
-							pNode->szGUID[32] = ' ';
-							pNode->szGUID[33] = szGUID[26];
-							pNode->szGUID[34] = szGUID[27];
-							pNode->szGUID[35] = ' ';
-							pNode->szGUID[36] = szGUID[28];
-							pNode->szGUID[37] = szGUID[29];
-							pNode->szGUID[38] = ' ';
-							pNode->szGUID[39] = szGUID[30];
-							pNode->szGUID[40] = szGUID[31];
-							pNode->szGUID[41] = ' ';
-							pNode->szGUID[42] = szGUID[32];
-							pNode->szGUID[43] = szGUID[33];
-							pNode->szGUID[44] = ' ';
-							pNode->szGUID[45] = szGUID[34];
-							pNode->szGUID[46] = szGUID[35];
-
-							pNode->szGUID[47] = 0;
-
-
-							// Hash it for fast dupe compare
-							pNode->uHash = DJBHash((PBYTE) pNode->szGUID, 47);
-							#ifdef SAVE_FIXED
-							qstrncpy(pNode->szGUIDCpy, szGUID, 48);
-							#endif						
-
-							// Skip GUID duplicates
-							if(uGUIDCount)
-							{
-								BOOL bFoundDupe = FALSE;
-								tGUIDNODE *pTestNode = s_GUIDList.GetHead();
-								while(pTestNode)
-								{
-									if(pNode->uHash == pTestNode->uHash)
-									{
-										msg("** Duplicate GUID %s @ line %d **\n", pNode->szGUID, iFileLine);
-										bFoundDupe = TRUE;
-										break;
-									}
-
-									pTestNode = pTestNode->GetNext();
-								};
-	
-								// Skip dupes
-								if(bFoundDupe)									
-								{
-									delete pNode;
-									continue;
-								}								
-							}							
-							
-							// Label
-							qsnprintf(pNode->szLabel, (sizeof(pNode->szLabel) - 1), "%s_%s", aDBFile[i].pszType, szLabel);							
-							pNode->StructID = StructID;
-
-							if(!uGUIDCount)
-								s_GUIDList.InsertHead(*pNode);
-							else
-								s_GUIDList.InsertTail(*pNode);
-
-							uGUIDCount++;							
-						}
-					}
-					else
-						msg("\n*** GUID format parse error on line %d! ***\n", iFileLine);					
-				}
-			};			
+	FreeScanData();
 
-			qfclose(fp);
-			msg("%u GUIDs loaded.\n", uGUIDCount);
+	char szPath[MAX_PATH];
+	s_DB.LoadTypeList(getsysfile(szPath, (MAX_PATH - 1), TYPE_LIST_FILE, "plugins\\GUID-Finder") ? szPath : NULL);
 
-			if(s_GUIDList.IsEmpty())
-				msg("\n*** No GUIDs loaded! ***\n");
+	// Text DB files, each one is optional
+	char aszTextPath[CompiledDB::MAX_TYPES][MAX_PATH];
+	UINT uTextCount = 0, uFirstText = 0;
+	for(UINT i = 0; i < s_DB.GetTextTypeCount(); i++)
+	{
+		if(getsysfile(aszTextPath[i], (MAX_PATH - 1), s_DB.GetTextType(i).szFileName, "plugins\\GUID-Finder"))
+		{
+			if(!uTextCount++)
+				uFirstText = i;
 		}
 		else
-			msg("\n*** Error loading DB file \"%s\"! ***\n", szPath);		
+			aszTextPath[i][0] = 0;
 	}
 
-	#ifdef SAVE_FIXED
-	if(FILE *fp = qfopen("C:\\FixedList.txt", "wb"))
+	// Compiled DB goes with the text files
+	char szDBPath[MAX_PATH] = {0};
+	if(!getsysfile(szDBPath, (MAX_PATH - 1), COMPILED_DB_FILE, "plugins\\GUID-Finder"))
 	{
-		tGUIDNODE *pNode = s_GUIDList.GetHead();
-		while(pNode)
+		szDBPath[0] = 0;
+		if(uTextCount)
 		{
-			qfprintf(fp, "%s %s\n", pNode->szGUIDCpy, pNode->szLabel);					
-			pNode = pNode->GetNext();
-		};
-		
-		qfclose(fp);
+			qstrncpy(szDBPath, aszTextPath[uFirstText], sizeof(szDBPath));
+			if(LPSTR pszSlash = strrchr(szDBPath, '\\'))
+				pszSlash[1] = 0;
+			qstrncat(szDBPath, COMPILED_DB_FILE, sizeof(szDBPath));
+		}
 	}
-	#endif
-	
-	return(!s_GUIDList.IsEmpty());
-}
\ No newline at end of file
+
+	BOOL bKept;
+	if(!s_DB.Load(szDBPath, aszTextPath, bKept))
+	{
+		FreeDB();
+		return(FALSE);
+	}
+	if(!bKept)
+		s_Engine.FreeIndex();
+
+	CreateTypeStructs();
+	return(TRUE);
+}
+
+
+// Create the GUID struct for each DB type
+static void CreateTypeStructs()
+{
+	for(UINT i = 0; i < s_DB.GetTypeCount(); i++)
+	{
+		LPCSTR pszType = s_DB.GetTypeName(i);
+		LPCSTR pszStruct = s_DB.GetTypeStruct(i);
+
+		tid_t StructID = get_struc_id(pszStruct);
+		if(StructID == BADADDR)
+		{
+			// Create it
+			if((StructID = add_struc(BADADDR, pszStruct)) != BADADDR)
+			{
+				if(struc_t *ptStuctInfo = get_struc(StructID))
+				{
+					add_struc_member(ptStuctInfo, "Data1", 0x0, dwrdflag(), NULL, 4);
+					add_struc_member(ptStuctInfo, "Data2", 0x4, wordflag(), NULL, 2);
+					add_struc_member(ptStuctInfo, "Data3", 0x6, wordflag(), NULL, 2);
+					add_struc_member(ptStuctInfo, "Data4", 0x8, byteflag(), NULL, 8);
+				}
+			}
+		}
+		if(StructID == BADADDR)
+			msg("*** Failed to build structure \"%s\" for GUID type \"%s\"! ***\n", pszStruct, pszType);
+		s_aStructID[i] = StructID;
+	}
+}
+
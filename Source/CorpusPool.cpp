@@ -0,0 +1,348 @@
+
+// ****************************************************************************
+// File: CorpusPool.cpp
+// Desc: Worker thread pool for scanning a corpus of files
+//
+// ****************************************************************************
+#include "StdAfx.h"
+#ifdef _WIN32
+#include <process.h>
+#endif
+#include "CorpusPool.h"
+
+// Worker's hit buffer for the piece it's scanning
+struct tPIECEHITS
+{
+	ea_t ea;
+	tSCANHIT *pHits;
+	UINT uHitCount, uHitMax;
+	UINT uDropped; // Hits the buffer couldn't take
+};
+
+CorpusPool::CorpusPool() : m_pEngine(NULL), m_pClient(NULL), m_uThreadCount(0), m_hWork(NULL), m_hFileSlots(NULL), m_hFileDone(NULL), m_uFilesQueued(0), m_uBytesScanned(0), m_bQuit(FALSE)
+{
+	InitializeCriticalSection(&m_Lock);
+	InitializeCriticalSection(&m_DoneLock);
+	for(UINT i = 0; i < MAX_THREADS; i++)
+		InitializeCriticalSection(&m_aWorker[i].Lock);
+}
+
+CorpusPool::~CorpusPool()
+{
+	Finish();
+	for(UINT i = 0; i < MAX_THREADS; i++)
+		DeleteCriticalSection(&m_aWorker[i].Lock);
+	DeleteCriticalSection(&m_DoneLock);
+	DeleteCriticalSection(&m_Lock);
+}
+
+
+// Start "uThreads" workers (0 = one per CPU)
+BOOL CorpusPool::Start(const ScanEngine &rEngine, CorpusClient &rClient, UINT uThreads)
+{
+	Finish();
+
+	if(uThreads == 0)
+	{
+		SYSTEM_INFO tInfo;
+		GetSystemInfo(&tInfo);
+		uThreads = tInfo.dwNumberOfProcessors;
+	}
+	if(uThreads < 1) uThreads = 1;
+	if(uThreads > MAX_THREADS) uThreads = MAX_THREADS;
+
+	m_pEngine = &rEngine;
+	m_pClient = &rClient;
+	m_bQuit = FALSE;
+	m_uBytesScanned = 0;
+	m_hWork      = CreateSemaphore(NULL, 0, 0x7FFFFFFF, NULL);
+	m_hFileSlots = CreateSemaphore(NULL, MAX_QUEUED, MAX_QUEUED, NULL);
+	m_hFileDone  = CreateSemaphore(NULL, 0, 0x7FFFFFFF, NULL);
+	if(!m_hWork || !m_hFileSlots || !m_hFileDone)
+	{
+		Stop();
+		return(FALSE);
+	}
+
+	for(UINT i = 0; i < uThreads; i++)
+	{
+		tWORKER &rWorker = m_aWorker[m_uThreadCount];
+		rWorker.pPool = this;
+		rWorker.uIndex = m_uThreadCount;
+		rWorker.uBytesScanned = 0;
+		if((rWorker.hThread = (HANDLE) _beginthreadex(NULL, 0, WorkerThread, &rWorker, 0, NULL)) != NULL)
+			m_uThreadCount++;
+		else
+			break;
+	}
+	if(!m_uThreadCount)
+	{
+		Stop();
+		return(FALSE);
+	}
+
+	return(TRUE);
+}
+
+// Stop the workers, once every file is done
+void CorpusPool::Stop()
+{
+	if(m_uThreadCount)
+	{
+		m_bQuit = TRUE;
+		ReleaseSemaphore(m_hWork, m_uThreadCount, NULL);
+		for(UINT i = 0; i < m_uThreadCount; i++)
+		{
+			WaitForSingleObject(m_aWorker[i].hThread, INFINITE);
+			CloseHandle(m_aWorker[i].hThread);
+			m_uBytesScanned += m_aWorker[i].uBytesScanned;
+		}
+		m_uThreadCount = 0;
+	}
+
+	if(m_hWork)      { CloseHandle(m_hWork);      m_hWork = NULL; }
+	if(m_hFileSlots) { CloseHandle(m_hFileSlots); m_hFileSlots = NULL; }
+	if(m_hFileDone)  { CloseHandle(m_hFileDone);  m_hFileDone = NULL; }
+	m_pEngine = NULL;
+	m_pClient = NULL;
+}
+
+// Wait for every queued file to be done, then stop the workers
+void CorpusPool::Finish()
+{
+	for(; m_uFilesQueued; m_uFilesQueued--)
+		WaitForSingleObject(m_hFileDone, INFINITE);
+	Stop();
+}
+
+
+// Queue a file
+BOOL CorpusPool::AddFile(PVOID pContext)
+{
+	if(!m_uThreadCount)
+		return(FALSE);
+	tCORPUSFILE *pFile = new tCORPUSFILE();
+	if(!pFile)
+		return(FALSE);
+	ZeroMemory(pFile, sizeof(tCORPUSFILE));
+	pFile->pContext = pContext;
+
+	WaitForSingleObject(m_hFileSlots, INFINITE);
+	EnterCriticalSection(&m_Lock);
+	m_Files.InsertTail(*pFile);
+	LeaveCriticalSection(&m_Lock);
+	m_uFilesQueued++;
+	ReleaseSemaphore(m_hWork, 1, NULL);
+	return(TRUE);
+}
+
+// Split a file range into pieces on the opening worker's queue.
+// Pieces are laid out like SegReader's chunks: each one after the first
+// starts with the last OVERLAP bytes of the one before, so a GUID straddling
+// them is seen whole, and scans the same as a chunked range. All but the last
+// are SCAN_MORE.
+void CorpusPool::AddRange(tCORPUSFILE &rFile, const BYTE *pData, UINT uSize, ea_t ea, UINT uStride, UINT uFlags)
+{
+	if(uSize < sizeof(GUID))
+		return;
+
+	tWORKER &rWorker = m_aWorker[rFile.uWorker];
+	UINT uOffset = 0, uKeep = 0;
+	while(uOffset < uSize)
+	{
+		UINT uRead = (((uSize - uOffset) < (PIECE_SIZE - uKeep)) ? (uSize - uOffset) : (PIECE_SIZE - uKeep));
+		tPIECE *pPiece = new tPIECE();
+		if(!pPiece)
+		{
+			msg("  *** Failed to allocate a scan piece! ***\n");
+			return;
+		}
+		pPiece->pFile   = &rFile;
+		pPiece->pData   = (pData + (uOffset - uKeep));
+		pPiece->ea      = (ea + (uOffset - uKeep));
+		pPiece->uSize   = (uKeep + uRead);
+		pPiece->uKeep   = uKeep;
+		pPiece->uStride = uStride;
+		pPiece->uFlags  = (((uOffset + uRead) < uSize) ? (uFlags | SCAN_MORE) : uFlags);
+
+		EnterCriticalSection(&m_Lock);
+		rFile.uPieces++;
+		LeaveCriticalSection(&m_Lock);
+		EnterCriticalSection(&rWorker.Lock);
+		rWorker.Pieces.InsertTail(*pPiece);
+		LeaveCriticalSection(&rWorker.Lock);
+		ReleaseSemaphore(m_hWork, 1, NULL);
+
+		uOffset += uRead;
+		uKeep = OVERLAP;
+	};
+}
+
+
+CorpusPool::tPIECE *CorpusPool::TakePiece(tWORKER &rWorker)
+{
+	EnterCriticalSection(&rWorker.Lock);
+	tPIECE *pPiece = rWorker.Pieces.RemoveHead();
+	LeaveCriticalSection(&rWorker.Lock);
+	return(pPiece);
+}
+
+// Open a file on this worker, it gets the file's pieces
+void CorpusPool::OpenFile(tWORKER &rWorker, tCORPUSFILE *pFile)
+{
+	pFile->uWorker = rWorker.uIndex;
+	pFile->uPieces = 1; // Not done before it's opened
+	pFile->bOpened = m_pClient->OpenFile(*this, *pFile);
+	PieceDone(pFile);
+}
+
+// Piece hit handler, collects hits in the worker's buffer
+void CorpusPool::PieceHit(UINT uOffset, UINT uKey, UINT uForm, PVOID pContext)
+{
+	tPIECEHITS *pHits = (tPIECEHITS *) pContext;
+	if(pHits->uHitCount >= pHits->uHitMax)
+	{
+		UINT uMax = (pHits->uHitMax ? (pHits->uHitMax * 2) : 64);
+		tSCANHIT *pNewHits = (tSCANHIT *) qrealloc(pHits->pHits, (sizeof(tSCANHIT) * uMax));
+		if(!pNewHits)
+		{
+			pHits->uDropped++;
+			return;
+		}
+		pHits->pHits = pNewHits;
+		pHits->uHitMax = uMax;
+	}
+
+	tSCANHIT &rHit = pHits->pHits[pHits->uHitCount++];
+	rHit.ea = (pHits->ea + uOffset);
+	rHit.uKey = uKey;
+	rHit.uForm = uForm;
+}
+
+// Scan a piece and add its hits to its file
+void CorpusPool::ScanPiece(tWORKER &rWorker, tPIECE *pPiece)
+{
+	tPIECEHITS tHits = { pPiece->ea, NULL, 0, 0, 0 };
+	UINT uFirst = ((pPiece->uStride - (pPiece->ea % pPiece->uStride)) % pPiece->uStride);
+	ScanBuffer(m_pEngine->GetIndex(), pPiece->pData, pPiece->uSize, uFirst, pPiece->uStride, pPiece->uFlags, pPiece->uKeep, PieceHit, &tHits);
+	rWorker.uBytesScanned += (pPiece->uSize - pPiece->uKeep);
+
+	tCORPUSFILE *pFile = pPiece->pFile;
+	if(tHits.uHitCount)
+	{
+		AppendHits(*pFile, tHits.pHits, tHits.uHitCount, TRUE);
+		qfree(tHits.pHits);
+	}
+	if(tHits.uDropped)
+	{
+		// Counted with the file's, so it isn't taken as complete
+		EnterCriticalSection(&m_Lock);
+		pFile->uDropped += tHits.uDropped;
+		LeaveCriticalSection(&m_Lock);
+	}
+
+	delete pPiece;
+	PieceDone(pFile);
+}
+
+// Add hits to a file's list, mapping their entries if "bMap"
+void CorpusPool::AppendHits(tCORPUSFILE &rFile, const tSCANHIT *pHits, UINT uHitCount, BOOL bMap)
+{
+	EnterCriticalSection(&m_Lock);
+	if((rFile.uHitCount + uHitCount) > rFile.uHitMax)
+	{
+		UINT uMax = (((rFile.uHitMax * 2) > (rFile.uHitCount + uHitCount)) ? (rFile.uHitMax * 2) : (rFile.uHitCount + uHitCount));
+		if(tSCANHIT *pNewHits = (tSCANHIT *) qrealloc(rFile.pHits, (sizeof(tSCANHIT) * uMax)))
+		{
+			rFile.pHits = pNewHits;
+			rFile.uHitMax = uMax;
+		}
+	}
+	for(UINT i = 0; i < uHitCount; i++)
+	{
+		tSCANHIT tHit = pHits[i];
+		if(bMap && !m_pEngine->MapHit(tHit))
+			continue;
+		if(rFile.uHitCount < rFile.uHitMax)
+			rFile.pHits[rFile.uHitCount++] = tHit;
+		else
+			rFile.uDropped++;
+	}
+	LeaveCriticalSection(&m_Lock);
+}
+
+// Add hits found some other way
+void CorpusPool::AddHits(tCORPUSFILE &rFile, const tSCANHIT *pHits, UINT uHitCount)
+{
+	if(uHitCount)
+		AppendHits(rFile, pHits, uHitCount, FALSE);
+}
+
+// A piece of a file is done, hand the file to the client if it was the last
+void CorpusPool::PieceDone(tCORPUSFILE *pFile)
+{
+	EnterCriticalSection(&m_Lock);
+	BOOL bDone = (--pFile->uPieces == 0);
+	LeaveCriticalSection(&m_Lock);
+	if(!bDone)
+		return;
+
+	// Pieces finish in any order
+	if(pFile->uHitCount)
+		qsort(pFile->pHits, pFile->uHitCount, sizeof(tSCANHIT), ScanEngine::CompareHit);
+	if(pFile->uDropped)
+		msg("  *** Failed to allocate hit list, %u hits dropped! ***\n", pFile->uDropped);
+
+	EnterCriticalSection(&m_DoneLock);
+	m_pClient->FileDone(*pFile, pFile->pHits, pFile->uHitCount);
+	LeaveCriticalSection(&m_DoneLock);
+
+	if(pFile->pHits) qfree(pFile->pHits);
+	delete pFile;
+	ReleaseSemaphore(m_hFileDone, 1, NULL);
+}
+
+
+// Worker thread. Every queued file and piece releases a work count, each one
+// taken is one of them: its own pieces first, then a new file, then another
+// worker's pieces.
+unsigned __stdcall CorpusPool::WorkerThread(PVOID pParam)
+{
+	tWORKER &rWorker = *((tWORKER *) pParam);
+	CorpusPool *pPool = rWorker.pPool;
+	for(;;)
+	{
+		WaitForSingleObject(pPool->m_hWork, INFINITE);
+		for(;;)
+		{
+			if(tPIECE *pPiece = pPool->TakePiece(rWorker))
+			{
+				pPool->ScanPiece(rWorker, pPiece);
+				break;
+			}
+
+			EnterCriticalSection(&pPool->m_Lock);
+			tCORPUSFILE *pFile = pPool->m_Files.RemoveHead();
+			LeaveCriticalSection(&pPool->m_Lock);
+			if(pFile)
+			{
+				ReleaseSemaphore(pPool->m_hFileSlots, 1, NULL);
+				pPool->OpenFile(rWorker, pFile);
+				break;
+			}
+
+			tPIECE *pStolen = NULL;
+			for(UINT i = 1; (i < pPool->m_uThreadCount) && !pStolen; i++)
+				pStolen = pPool->TakePiece(pPool->m_aWorker[(rWorker.uIndex + i) % pPool->m_uThreadCount]);
+			if(pStolen)
+			{
+				pPool->ScanPiece(rWorker, pStolen);
+				break;
+			}
+
+			// Nothing left, or another worker took ours ahead of its own count
+			if(pPool->m_bQuit)
+				return(0);
+		};
+	};
+}
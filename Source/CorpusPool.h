@@ -0,0 +1,166 @@
+
+// ****************************************************************************
+// File: CorpusPool.h
+// Desc: Worker thread pool for scanning a corpus of files
+//
+// ****************************************************************************
+#pragma once
+#include "ScanEngine.h"
+
+class CorpusPool;
+
+// Corpus file in the pool
+struct tCORPUSFILE
+{
+	tCORPUSFILE *pNext;	// Queue link
+	PVOID pContext;		// Caller's, what to open
+	BOOL  bOpened;		// OpenFile() succeeded
+	UINT  uWorker;		// Worker that opened it, gets its pieces first
+	UINT  uPieces;		// Pieces not scanned yet, plus one while being opened
+	tSCANHIT *pHits;
+	UINT  uHitCount, uHitMax;
+	UINT  uDropped;		// Hits the hit list couldn't take
+
+	// Use IDA allocs
+	static PVOID operator new(size_t size){	return(qalloc(size)); };
+	static void operator delete(PVOID _Ptr){ return(qfree(_Ptr)); }
+};
+
+// What the pool does with the files, called on the worker threads
+class CorpusClient
+{
+public:
+	virtual ~CorpusClient(){}
+
+	// Open a file and add the ranges to scan with CorpusPool::AddRange(); FALSE if it can't be
+	virtual BOOL OpenFile(CorpusPool &rPool, tCORPUSFILE &rFile) = 0;
+
+	// A file is done, its hits in address order; "rFile.bOpened" is FALSE if
+	// it couldn't be opened. One call at a time, in the order files finish.
+	// The file's ranges aren't touched after this.
+	virtual void FileDone(tCORPUSFILE &rFile, const tSCANHIT *pHits, UINT uHitCount) = 0;
+};
+
+// Scans many files at once, against one engine's read only index.
+// Workers open queued files and split their ranges into pieces the size of
+// a scan chunk, scanned in place (the ranges are mapped or loaded by the
+// client). Each worker takes pieces from its own queue first, then opens
+// the next file, and when there's none steals pieces from the other workers,
+// so a file far bigger than the rest is spread over every worker.
+// Hits are collected per file and handed to the client as each file finishes.
+class CorpusPool
+{
+public:
+	enum
+	{
+		MAX_THREADS = ScanPool::MAX_THREADS,
+		MAX_QUEUED  = 1024, // Files waiting to be opened before AddFile() waits
+		PIECE_SIZE  = SegReader::CHUNK_SIZE,
+		OVERLAP     = SegReader::OVERLAP
+	};
+
+	CorpusPool();
+	~CorpusPool();
+
+	// Start "uThreads" workers (0 = one per CPU). "rEngine" has to have its
+	// index built and stay as is while the pool runs.
+	BOOL Start(const ScanEngine &rEngine, CorpusClient &rClient, UINT uThreads = 0);
+
+	// Queue a file, "pContext" is what the client's OpenFile() gets.
+	// Waits while MAX_QUEUED files are waiting to be opened.
+	BOOL AddFile(PVOID pContext);
+
+	// From OpenFile(): scan "uSize" bytes at "pData", addressed from "ea".
+	// The bytes have to stay valid until the file is done.
+	void AddRange(tCORPUSFILE &rFile, const BYTE *pData, UINT uSize, ea_t ea, UINT uStride, UINT uFlags);
+
+	// From OpenFile(): add hits found some other way, like from a cache,
+	// with their entries already mapped (see ScanEngine::MapHit())
+	void AddHits(tCORPUSFILE &rFile, const tSCANHIT *pHits, UINT uHitCount);
+
+	// Wait for every queued file to be done, then stop the workers
+	void Finish();
+
+	UINT GetThreadCount() const { return(m_uThreadCount); }
+	ULONGLONG GetBytesScanned() const { return(m_uBytesScanned); }
+
+private:
+	// Piece of a file range
+	struct tPIECE
+	{
+		tPIECE *pNext;
+		tCORPUSFILE *pFile;
+		const BYTE *pData;
+		ea_t  ea;		// Address of pData[0]
+		UINT  uSize;
+		UINT  uKeep;	// Leading bytes that are the end of the last piece
+		UINT  uStride;
+		UINT  uFlags;
+
+		static PVOID operator new(size_t size){	return(qalloc(size)); };
+		static void operator delete(PVOID _Ptr){ return(qfree(_Ptr)); }
+	};
+
+	// FIFO linked through the items
+	template <class T> struct LINKQUEUE
+	{
+		T *m_pHead, *m_pTail;
+
+		LINKQUEUE() : m_pHead(NULL), m_pTail(NULL) {}
+		void InsertTail(T &rItem)
+		{
+			rItem.pNext = NULL;
+			if(m_pTail)
+				m_pTail->pNext = &rItem;
+			else
+				m_pHead = &rItem;
+			m_pTail = &rItem;
+		}
+		T *RemoveHead()
+		{
+			T *pItem = m_pHead;
+			if(pItem && ((m_pHead = pItem->pNext) == NULL))
+				m_pTail = NULL;
+			return(pItem);
+		}
+	};
+
+	// Worker's piece queue
+	struct tWORKER
+	{
+		CorpusPool *pPool;
+		UINT uIndex;
+		HANDLE hThread;
+		CRITICAL_SECTION Lock;
+		LINKQUEUE<tPIECE> Pieces;
+		ULONGLONG uBytesScanned;
+	};
+
+	static unsigned __stdcall WorkerThread(PVOID pParam);
+	static void PieceHit(UINT uOffset, UINT uKey, UINT uForm, PVOID pContext);
+	tPIECE *TakePiece(tWORKER &rWorker);
+	void OpenFile(tWORKER &rWorker, tCORPUSFILE *pFile);
+	void ScanPiece(tWORKER &rWorker, tPIECE *pPiece);
+	void AppendHits(tCORPUSFILE &rFile, const tSCANHIT *pHits, UINT uHitCount, BOOL bMap);
+	void PieceDone(tCORPUSFILE *pFile);
+	void Stop();
+
+	const ScanEngine *m_pEngine;
+	CorpusClient *m_pClient;
+	tWORKER m_aWorker[MAX_THREADS];
+	UINT   m_uThreadCount;
+
+	CRITICAL_SECTION m_Lock;	  // Guards the file queue and the files
+	CRITICAL_SECTION m_DoneLock;  // Serializes FileDone()
+	LINKQUEUE<tCORPUSFILE> m_Files;
+	HANDLE m_hWork;		 // Semaphore, count of queued files and pieces
+	HANDLE m_hFileSlots; // Semaphore, room in the file queue
+	HANDLE m_hFileDone;	 // Semaphore, count of files done
+	UINT   m_uFilesQueued;
+	ULONGLONG m_uBytesScanned;
+	volatile BOOL m_bQuit;
+
+	// No copies
+	CorpusPool(const CorpusPool &);
+	void operator=(const CorpusPool &);
+};
@@ -0,0 +1,162 @@
+
+// ****************************************************************************
+// File: FileSource.cpp
+// Desc: Flat file byte source
+//
+// ****************************************************************************
+#include "StdAfx.h"
+#include "FileSource.h"
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#endif
+
+FileSource::FileSource() : m_pImage(NULL), m_pOwned(NULL), m_bMapped(FALSE), m_uSize(0), m_baseEA(0)
+{
+}
+
+FileSource::~FileSource()
+{
+	Close();
+}
+
+
+// Read a whole file in, addressed from "baseEA"
+BOOL FileSource::Open(LPCSTR pszPath, ea_t baseEA)
+{
+	Close();
+
+	FILE *fp = qfopen(pszPath, "rb");
+	if(!fp)
+		return(FALSE);
+	UINT uSize = qfsize(fp);
+	PBYTE pImage = (PBYTE) qalloc(uSize ? uSize : 1);
+	BOOL bRead = (pImage && ((UINT) qfread(fp, pImage, uSize) == uSize));
+	qfclose(fp);
+	if(!bRead)
+	{
+		if(pImage) qfree(pImage);
+		return(FALSE);
+	}
+
+	m_pImage = m_pOwned = pImage;
+	m_uSize  = uSize;
+	m_baseEA = baseEA;
+	return(TRUE);
+}
+
+// Map a whole file read only, the pages are read as they're scanned
+BOOL FileSource::Map(LPCSTR pszPath, ea_t baseEA)
+{
+	Close();
+
+	const BYTE *pView = NULL;
+	UINT uSize = 0;
+	BOOL bResult = FALSE;
+	#ifdef _WIN32
+	HANDLE hFile = CreateFile(pszPath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if(hFile == INVALID_HANDLE_VALUE)
+		return(FALSE);
+	DWORD dwHigh, dwSize = GetFileSize(hFile, &dwHigh);
+	if((dwSize != INVALID_FILE_SIZE) && !dwHigh && (dwSize < BADADDR))
+	{
+		// Empty files can't be mapped
+		uSize = dwSize;
+		bResult = !uSize;
+		if(uSize)
+		{
+			// The view stays valid after the handles are closed
+			if(HANDLE hMapping = CreateFileMapping(hFile, NULL, PAGE_READONLY, 0, 0, NULL))
+			{
+				bResult = ((pView = (const BYTE *) MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0)) != NULL);
+				CloseHandle(hMapping);
+			}
+		}
+	}
+	CloseHandle(hFile);
+	#else
+	int iFile = open(pszPath, O_RDONLY);
+	if(iFile < 0)
+		return(FALSE);
+	struct stat tStat;
+	if((fstat(iFile, &tStat) == 0) && S_ISREG(tStat.st_mode) && (tStat.st_size < (off_t) BADADDR))
+	{
+		uSize = (UINT) tStat.st_size;
+		bResult = !uSize;
+		if(uSize)
+		{
+			PVOID pMap = mmap(NULL, uSize, PROT_READ, MAP_PRIVATE, iFile, 0);
+			if(pMap != MAP_FAILED)
+			{
+				madvise(pMap, uSize, MADV_SEQUENTIAL);
+				pView = (const BYTE *) pMap;
+				bResult = TRUE;
+			}
+		}
+	}
+	close(iFile);
+	#endif
+	if(!bResult)
+		return(FALSE);
+
+	m_pImage  = pView;
+	m_bMapped = (pView != NULL);
+	m_uSize   = uSize;
+	m_baseEA  = baseEA;
+	return(TRUE);
+}
+
+// Use a buffer in place
+void FileSource::Attach(const BYTE *pImage, UINT uSize, ea_t baseEA)
+{
+	Close();
+	m_pImage = pImage;
+	m_uSize  = uSize;
+	m_baseEA = baseEA;
+}
+
+void FileSource::Close()
+{
+	if(m_pOwned)
+	{
+		qfree(m_pOwned);
+		m_pOwned = NULL;
+	}
+	if(m_bMapped)
+	{
+		#ifdef _WIN32
+		UnmapViewOfFile(m_pImage);
+		#else
+		munmap((PVOID) m_pImage, m_uSize);
+		#endif
+		m_bMapped = FALSE;
+	}
+	m_pImage = NULL;
+	m_uSize  = 0;
+	m_baseEA = 0;
+}
+
+
+// First address in [ea, endEA) in the image
+ea_t FileSource::NextLoaded(ea_t ea, ea_t endEA)
+{
+	if(ea < m_baseEA)
+		ea = m_baseEA;
+	if((ea >= endEA) || (ea >= GetEndEA()))
+		return(BADADDR);
+	return(ea);
+}
+
+// The image is one run
+ea_t FileSource::RunEnd(ea_t ea, ea_t endEA)
+{
+	return((endEA < GetEndEA()) ? endEA : GetEndEA());
+}
+
+BOOL FileSource::Read(ea_t ea, PBYTE pBuffer, UINT uSize)
+{
+	if((ea < m_baseEA) || (uSize > m_uSize) || ((ea - m_baseEA) > (m_uSize - uSize)))
+		return(FALSE);
+	memcpy(pBuffer, (m_pImage + (ea - m_baseEA)), uSize);
+	return(TRUE);
+}
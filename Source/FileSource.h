@@ -0,0 +1,46 @@
+
+// ****************************************************************************
+// File: FileSource.h
+// Desc: Flat file byte source
+//
+// ****************************************************************************
+#pragma once
+#include "ByteSource.h"
+
+// Byte source over a flat image, a whole file read in or mapped, or a caller's buffer,
+// at a base address. Every byte in it has a value.
+// The stand-in for the IDB in the tools and the benchmarks.
+class FileSource : public ByteSource
+{
+public:
+	FileSource();
+	~FileSource();
+
+	// Read a whole file in, addressed from "baseEA"
+	BOOL Open(LPCSTR pszPath, ea_t baseEA = 0);
+	// Map a whole file read only, addressed from "baseEA"
+	BOOL Map(LPCSTR pszPath, ea_t baseEA = 0);
+	// Use a buffer in place, it has to stay valid while attached
+	void Attach(const BYTE *pImage, UINT uSize, ea_t baseEA = 0);
+	void Close();
+
+	const BYTE *GetImage() const { return(m_pImage); }
+	UINT GetSize() const { return(m_uSize); }
+	ea_t GetStartEA() const { return(m_baseEA); }
+	ea_t GetEndEA() const { return(m_baseEA + m_uSize); }
+
+	ea_t NextLoaded(ea_t ea, ea_t endEA);
+	ea_t RunEnd(ea_t ea, ea_t endEA);
+	BOOL Read(ea_t ea, PBYTE pBuffer, UINT uSize);
+
+private:
+	const BYTE *m_pImage;
+	PBYTE m_pOwned; // qalloc()'d file image, NULL if attached
+	BOOL  m_bMapped; // m_pImage is a file mapping
+	UINT  m_uSize;
+	ea_t  m_baseEA;
+
+	// No copies
+	FileSource(const FileSource &);
+	void operator=(const FileSource &);
+};
@@ -0,0 +1,475 @@
+
+// ****************************************************************************
+// File: GUIDBench.cpp
+// Desc: Scan engine throughput benchmark for "GUID-Finder".
+//       Scans synthetic segment images with planted GUIDs and times the
+//       load, scan and apply phases against DBs of increasing size.
+//
+// ****************************************************************************
+#include "../StdAfx.h"
+#include "../GUIDDB.h"
+#include "../ScanEngine.h"
+#include "../FileSource.h"
+#include "../GUIDText.h"
+#include "StockDB.inl"
+
+/*
+	Usage: GUIDBench [options]
+	  -m <MB>        Image size, default 64
+	  -d <hits/MB>   Planted GUID density, default 64
+	  -a <align>     Planted GUID alignment, default 4
+	  -x <stride>    Scan stride 1, 4 or 8, default 4
+	  -n <count,..>  DB sizes, "stock" for the stock DB alone,
+	                 default "stock,16384,65536,262144,1048576"
+	  -t             Find text GUIDs too, every 8th planted GUID is text
+	  -r             Find RFC 4122 byte order GUIDs too, every 4th planted one is
+	  -j <threads>   Scan threads, default one per CPU
+	  -k <kernel>    Scan kernel "scalar", "sse2" or "avx2", default best supported
+	  -i <count>     Scan iterations, the best is reported, default 3
+	  -b [<count>]   Time the per GUID search the plug-in did before the
+	                 single pass scanner, over "count" DB GUIDs (default 64)
+	                 and scaled to the whole DB
+	  -w <dir>       Work dir for the generated DB files, default current
+	  -s <seed>      Random seed, default 1
+
+	The generated text DB goes through the same compile/load path as the
+	plug-in's (see GUIDDB). The apply phase does what the plug-in does per hit
+	short of the IDB calls: label and struct look up and comment formatting.
+*/
+
+// Benchmark settings
+struct tSETTINGS
+{
+	UINT uImageMB;
+	UINT uDensity;
+	UINT uAlign;
+	UINT uStride;
+	BOOL bText;
+	BOOL bRFC4122;
+	UINT uThreads;
+	eSCANKERNEL eKernel;
+	UINT uIterations;
+	UINT uBaseline;	// Baseline GUIDs, 0 for none
+	char szWorkDir[MAX_PATH];
+};
+
+// Phase results for one DB size
+struct tRESULT
+{
+	UINT uDBCount;
+	TIMESTAMP CompileTime;	// First load, from text; 0 for the stock DB
+	UINT uTextSize;
+	TIMESTAMP LoadTime;		// Mapped load
+	TIMESTAMP IndexTime;
+	TIMESTAMP ScanTime;		// Best of the iterations
+	UINT uPlanted;
+	UINT uFound;
+	TIMESTAMP ApplyTime;
+	TIMESTAMP BaselineTime; // Scaled to the whole DB, 0 if not run
+	UINT uBaselineGUIDs;	// DB GUIDs it searched for
+	UINT uBaselineFound;
+};
+
+static UINT s_uRandom = 1;
+
+// Xorshift PRNG, the same sequence on every platform
+static inline UINT Random()
+{
+	s_uRandom ^= (s_uRandom << 13);
+	s_uRandom ^= (s_uRandom >> 17);
+	s_uRandom ^= (s_uRandom << 5);
+	return(s_uRandom);
+}
+
+static void RandomGUID(GUID &rGUID)
+{
+	UINT *puGUID = (UINT *) &rGUID;
+	for(UINT i = 0; i < 4; i++)
+		puGUID[i] = Random();
+}
+
+// Swap a GUID to RFC 4122 byte order
+static void SwapGUIDOrder(const GUID &rIn, GUID &rOut)
+{
+	rOut.Data1 = _byteswap_ulong(rIn.Data1);
+	rOut.Data2 = _byteswap_ushort(rIn.Data2);
+	rOut.Data3 = _byteswap_ushort(rIn.Data3);
+	memcpy(rOut.Data4, rIn.Data4, sizeof(rOut.Data4));
+}
+
+
+// Write a text DB of "uCount" random GUIDs; returns its size, 0 on failure
+static UINT WriteTextDB(LPCSTR pszPath, UINT uCount)
+{
+	FILE *fp = qfopen(pszPath, "wb");
+	if(!fp)
+		return(0);
+
+	UINT uSize = 0;
+	for(UINT i = 0; i < uCount; i++)
+	{
+		GUID Guid;
+		RandomGUID(Guid);
+		char szGUID[GUID_TEXT_SIZE], szLine[128];
+		int iLength = qsnprintf(szLine, sizeof(szLine), "%s Bench_%u\r\n", GUIDToString(Guid, szGUID), i);
+		if(qfwrite(fp, szLine, iLength) != iLength)
+		{
+			qfclose(fp);
+			return(0);
+		}
+		uSize += iLength;
+	}
+	qfclose(fp);
+	return(uSize);
+}
+
+
+// Fill the image with noise and plant DB GUIDs in it; returns the planted count.
+// They're spread evenly, one per slot at a random aligned offset in it.
+static UINT BuildImage(PBYTE pImage, UINT uSize, const CompiledDB &rDB, const tSETTINGS &rSettings)
+{
+	UINT *puImage = (UINT *) pImage;
+	for(UINT i = 0; i < (uSize / sizeof(UINT)); i++)
+		puImage[i] = Random();
+
+	UINT uCount = (UINT) (((ULONGLONG) uSize * rSettings.uDensity) / (1024 * 1024));
+	if(!uCount || !rDB.GetCount())
+		return(0);
+	UINT uSlot = (uSize / uCount);
+	UINT uRoom = (MAX_GUID_FORM_SIZE + rSettings.uAlign);
+	if(uSlot <= uRoom)
+	{
+		uSlot = (uRoom + 1);
+		uCount = (uSize / uSlot);
+	}
+
+	for(UINT i = 0; i < uCount; i++)
+	{
+		UINT uOffset = ((i * uSlot) + (Random() % (uSlot - uRoom)));
+		uOffset -= (uOffset % rSettings.uAlign);
+		const GUID &rGUID = rDB.GetKeys()[Random() % rDB.GetCount()];
+
+		if(rSettings.bText && ((i & 7) == 7))
+		{
+			// Braced, so noise hex digits don't run into it
+			char szGUID[GUID_TEXT_SIZE];
+			pImage[uOffset] = '{';
+			memcpy(&pImage[uOffset + 1], GUIDToString(rGUID, szGUID), TEXT_GUID_LENGTH);
+			pImage[uOffset + 1 + TEXT_GUID_LENGTH] = '}';
+		}
+		else
+		if(rSettings.bRFC4122 && ((i & 3) == 3))
+		{
+			GUID Swapped;
+			SwapGUIDOrder(rGUID, Swapped);
+			memcpy(&pImage[uOffset], &Swapped, sizeof(GUID));
+		}
+		else
+			memcpy(&pImage[uOffset], &rGUID, sizeof(GUID));
+	}
+
+	return(uCount);
+}
+
+
+// Does the per hit work of the plug-in's apply, without the IDB
+class BenchSink : public HitSink
+{
+public:
+	BenchSink(const GUIDDB &rDB) : m_rDB(rDB), m_uHits(0), m_uCheck(0) {}
+
+	void OnHit(ea_t ea, UINT uEntry, UINT uForm)
+	{
+		LPCSTR pszLabel  = m_rDB.GetLabel(uEntry);
+		LPCSTR pszStruct = m_rDB.GetTypeStruct(m_rDB.GetType(uEntry));
+		char szComment[512];
+		int iLength = qsnprintf(szComment, (sizeof(szComment) - 1), ((uForm == HIT_RFC4122) ? "GUID %s, RFC 4122 byte order" : "GUID %s"), pszLabel);
+		m_uCheck += (iLength + pszStruct[0] + ea);
+		m_uHits++;
+	}
+
+	UINT GetHits() const { return(m_uHits); }
+	UINT GetCheck() const { return(m_uCheck); }
+
+private:
+	const GUIDDB &m_rDB;
+	UINT m_uHits;
+	UINT m_uCheck; // Keeps the work from being optimized out
+
+	void operator=(const BenchSink &);
+};
+
+
+// The plug-in's search before the single pass scanner: a pass over the whole
+// image per DB GUID, as with find_binary(). Times "uCount" GUIDs and scales
+// the time to the whole DB.
+static TIMESTAMP TimeBaseline(const BYTE *pImage, UINT uSize, const CompiledDB &rDB, UINT uCount, UINT &ruFound)
+{
+	if(uCount > rDB.GetCount())
+		uCount = rDB.GetCount();
+	ruFound = 0;
+	if(!uCount)
+		return(0);
+
+	TIMESTAMP StartTime = GetTimeStamp();
+	for(UINT i = 0; i < uCount; i++)
+	{
+		const BYTE *pGUID = (const BYTE *) &rDB.GetKeys()[(i * (rDB.GetCount() / uCount))];
+		const BYTE *pEnd  = (pImage + uSize - (sizeof(GUID) - 1));
+		for(const BYTE *p = pImage; p < pEnd; p++)
+		{
+			if(!(p = (const BYTE *) memchr(p, pGUID[0], (pEnd - p))))
+				break;
+			if(memcmp(p, pGUID, sizeof(GUID)) == 0)
+				ruFound++;
+		}
+	}
+	return((GetTimeStamp() - StartTime) * ((double) rDB.GetCount() / uCount));
+}
+
+
+// Run all the phases for one DB size; "uDBSize" 0 is the stock DB alone
+static BOOL RunDB(UINT uDBSize, PBYTE pImage, UINT uImageSize, const tSETTINGS &rSettings, tRESULT &rResult)
+{
+	ZeroMemory(&rResult, sizeof(rResult));
+	GUIDDB DB(s_abStockDB, STOCKDB_SIZE, STOCKDB_STAMP);
+	DB.LoadTypeList(NULL);
+	char aszTextPath[CompiledDB::MAX_TYPES][MAX_PATH];
+	ZeroMemory(aszTextPath, sizeof(aszTextPath));
+	char szDBPath[MAX_PATH] = {0};
+	BOOL bKept;
+
+	// Load phase
+	CompiledDB Stock;
+	Stock.Attach(s_abStockDB, STOCKDB_SIZE);
+	if(uDBSize <= Stock.GetCount())
+	{
+		TIMESTAMP StartTime = GetTimeStamp();
+		if(!DB.Load(NULL, aszTextPath, bKept))
+			return(FALSE);
+		rResult.LoadTime = (GetTimeStamp() - StartTime);
+	}
+	else
+	{
+		// Text DB with the GUIDs the stock DB doesn't supply, as the first type's file
+		qsnprintf(aszTextPath[0], MAX_PATH, "%s/GUIDBench_%u.txt", rSettings.szWorkDir, uDBSize);
+		qsnprintf(szDBPath, MAX_PATH, "%s/GUIDBench_%u.db", rSettings.szWorkDir, uDBSize);
+		DeleteFile(szDBPath);
+		if(!(rResult.uTextSize = WriteTextDB(aszTextPath[0], (uDBSize - Stock.GetCount()))))
+		{
+			printf("%s: error: Can't write the text DB.\n", aszTextPath[0]);
+			return(FALSE);
+		}
+
+		TIMESTAMP StartTime = GetTimeStamp();
+		BOOL bLoaded = DB.Load(szDBPath, aszTextPath, bKept);
+		rResult.CompileTime = (GetTimeStamp() - StartTime);
+		if(bLoaded)
+		{
+			DB.Free();
+			StartTime = GetTimeStamp();
+			bLoaded = DB.Load(szDBPath, aszTextPath, bKept);
+			rResult.LoadTime = (GetTimeStamp() - StartTime);
+		}
+		DeleteFile(aszTextPath[0]);
+		if(!bLoaded)
+		{
+			DeleteFile(szDBPath);
+			return(FALSE);
+		}
+	}
+	rResult.uDBCount = DB.GetCount();
+
+	ScanEngine Engine;
+	TIMESTAMP StartTime = GetTimeStamp();
+	if(!Engine.BuildIndex(DB, rSettings.bRFC4122))
+		return(FALSE);
+	rResult.IndexTime = (GetTimeStamp() - StartTime);
+
+	// Scan phase, the image is planted from this DB
+	rResult.uPlanted = BuildImage(pImage, uImageSize, DB, rSettings);
+	FileSource Source;
+	Source.Attach(pImage, uImageSize, 0x10000);
+	if(!Engine.Start(rSettings.uThreads))
+	{
+		printf("error: Failed to start scan threads.\n");
+		return(FALSE);
+	}
+	UINT uFlags = (rSettings.bText ? SCAN_TEXT : 0);
+	for(UINT i = 0; i < rSettings.uIterations; i++)
+	{
+		Engine.Reset();
+		StartTime = GetTimeStamp();
+		Engine.ScanRange(Source, Source.GetStartEA(), Source.GetEndEA(), rSettings.uStride, uFlags);
+		TIMESTAMP ScanTime = (GetTimeStamp() - StartTime);
+		if(!i || (ScanTime < rResult.ScanTime))
+			rResult.ScanTime = ScanTime;
+	}
+	Engine.Stop();
+	rResult.uFound = Engine.GetHitCount();
+
+	// Apply phase
+	BenchSink Sink(DB);
+	StartTime = GetTimeStamp();
+	Engine.ApplyHits(Sink);
+	rResult.ApplyTime = (GetTimeStamp() - StartTime);
+
+	// Baseline
+	if(rSettings.uBaseline)
+	{
+		rResult.uBaselineGUIDs = ((rSettings.uBaseline < DB.GetCount()) ? rSettings.uBaseline : DB.GetCount());
+		rResult.BaselineTime = TimeBaseline(pImage, uImageSize, DB, rResult.uBaselineGUIDs, rResult.uBaselineFound);
+	}
+
+	Engine.FreeIndex();
+	DB.Free();
+	if(szDBPath[0])
+		DeleteFile(szDBPath);
+	return(TRUE);
+}
+
+
+// Rate per second, 0 for no time
+static inline double Rate(double fCount, TIMESTAMP Time)
+{
+	return((Time > 0) ? (fCount / Time) : 0);
+}
+
+static void PrintResult(const tRESULT &rResult, UINT uImageSize)
+{
+	double fImageMB = ((double) uImageSize / (1024.0 * 1024.0));
+	printf("\n%u GUIDs:\n", rResult.uDBCount);
+	if(rResult.CompileTime > 0)
+		printf("  compile %9.2f ms, %8.1f MB/s of text, %10.0f GUIDs/s\n", (rResult.CompileTime * 1000.0), Rate(((double) rResult.uTextSize / (1024.0 * 1024.0)), rResult.CompileTime), Rate(rResult.uDBCount, rResult.CompileTime));
+	printf("  load    %9.3f ms\n", (rResult.LoadTime * 1000.0));
+	printf("  index   %9.2f ms, %10.0f GUIDs/s\n", (rResult.IndexTime * 1000.0), Rate(rResult.uDBCount, rResult.IndexTime));
+	printf("  scan    %9.2f ms, %8.1f MB/s, %10.0f hits/s, %u of %u planted found\n", (rResult.ScanTime * 1000.0), Rate(fImageMB, rResult.ScanTime), Rate(rResult.uFound, rResult.ScanTime), rResult.uFound, rResult.uPlanted);
+	printf("  apply   %9.2f ms, %10.0f hits/s\n", (rResult.ApplyTime * 1000.0), Rate(rResult.uFound, rResult.ApplyTime));
+	if(rResult.BaselineTime > 0)
+	{
+		printf("  per GUID search %.2f s (scaled from %u GUIDs, %u hits), %.3f MB/s, the scan is %.0fx faster\n", rResult.BaselineTime, rResult.uBaselineGUIDs, rResult.uBaselineFound,
+			   Rate(fImageMB, rResult.BaselineTime), Rate(rResult.BaselineTime, rResult.ScanTime));
+	}
+}
+
+
+static void Usage()
+{
+	printf("Usage: GUIDBench [-m <MB>] [-d <hits/MB>] [-a <align>] [-x <stride>] [-n <count,..>]\n"
+		   "                 [-t] [-r] [-j <threads>] [-k <kernel>] [-i <count>] [-b [<count>]]\n"
+		   "                 [-w <dir>] [-s <seed>]\n");
+}
+
+int main(int argc, char *argv[])
+{
+	tSETTINGS tSettings;
+	ZeroMemory(&tSettings, sizeof(tSettings));
+	tSettings.uImageMB = 64;
+	tSettings.uDensity = 64;
+	tSettings.uAlign   = 4;
+	tSettings.uStride  = 4;
+	tSettings.eKernel  = SCAN_AVX2;
+	tSettings.uIterations = 3;
+	qstrncpy(tSettings.szWorkDir, ".", sizeof(tSettings.szWorkDir));
+	char szSizes[512] = "stock,16384,65536,262144,1048576";
+
+	for(int i = 1; i < argc; i++)
+	{
+		LPCSTR pszArg = argv[i];
+		LPCSTR pszValue = (((i + 1) < argc) ? argv[i + 1] : NULL);
+		if((pszArg[0] != '-') || !pszArg[1] || pszArg[2])
+		{
+			Usage();
+			return(1);
+		}
+
+		switch(pszArg[1])
+		{
+			case 't': tSettings.bText = TRUE; continue;
+			case 'r': tSettings.bRFC4122 = TRUE; continue;
+			case 'b':
+			{
+				tSettings.uBaseline = 64;
+				if(pszValue && (pszValue[0] >= '0') && (pszValue[0] <= '9'))
+				{
+					tSettings.uBaseline = strtoul(pszValue, NULL, 10);
+					i++;
+				}
+				continue;
+			}
+		};
+
+		if(!pszValue)
+		{
+			Usage();
+			return(1);
+		}
+		i++;
+		switch(pszArg[1])
+		{
+			case 'm': tSettings.uImageMB = strtoul(pszValue, NULL, 10); break;
+			case 'd': tSettings.uDensity = strtoul(pszValue, NULL, 10); break;
+			case 'a': tSettings.uAlign   = strtoul(pszValue, NULL, 10); break;
+			case 'x': tSettings.uStride  = strtoul(pszValue, NULL, 10); break;
+			case 'n': qstrncpy(szSizes, pszValue, sizeof(szSizes)); break;
+			case 'j': tSettings.uThreads = strtoul(pszValue, NULL, 10); break;
+			case 'i': tSettings.uIterations = strtoul(pszValue, NULL, 10); break;
+			case 'w': qstrncpy(tSettings.szWorkDir, pszValue, sizeof(tSettings.szWorkDir)); break;
+			case 's': s_uRandom = strtoul(pszValue, NULL, 10); break;
+			case 'k':
+			{
+				if(strcmp(pszValue, "scalar") == 0)    tSettings.eKernel = SCAN_SCALAR;
+				else if(strcmp(pszValue, "sse2") == 0) tSettings.eKernel = SCAN_SSE2;
+				else if(strcmp(pszValue, "avx2") == 0) tSettings.eKernel = SCAN_AVX2;
+				else
+				{
+					Usage();
+					return(1);
+				}
+			}
+			break;
+
+			default:
+			Usage();
+			return(1);
+		};
+	}
+	if(!tSettings.uImageMB || (tSettings.uImageMB > 2048) || !tSettings.uAlign || ((tSettings.uStride != 1) && (tSettings.uStride != 4) && (tSettings.uStride != 8)) || !tSettings.uIterations)
+	{
+		Usage();
+		return(1);
+	}
+	if(!s_uRandom)
+		s_uRandom = 1;
+
+	UINT uImageSize = (tSettings.uImageMB * (1024 * 1024));
+	PBYTE pImage = (PBYTE) qalloc(uImageSize);
+	if(!pImage)
+	{
+		printf("error: Can't allocate a %u MB image.\n", tSettings.uImageMB);
+		return(1);
+	}
+
+	eSCANKERNEL eKernel = SetScanKernel(tSettings.eKernel);
+	printf("GUIDBench: %u MB image, %u GUIDs/MB planted %u aligned, %s scan%s%s, %s kernel.\n", tSettings.uImageMB, tSettings.uDensity, tSettings.uAlign,
+		   ((tSettings.uStride == 1) ? "exhaustive" : ((tSettings.uStride == 4) ? "4 aligned" : "8 aligned")), (tSettings.bText ? ", text" : ""), (tSettings.bRFC4122 ? ", RFC 4122" : ""), GetScanKernelName(eKernel));
+
+	// Each DB size in turn
+	int iResult = 0;
+	for(LPSTR pszSize = strtok(szSizes, ","); pszSize; pszSize = strtok(NULL, ","))
+	{
+		UINT uDBSize = ((strcmp(pszSize, "stock") == 0) ? 0 : strtoul(pszSize, NULL, 10));
+		printf("\n-- DB %s --\n", pszSize);
+		tRESULT tResult;
+		if(!RunDB(uDBSize, pImage, uImageSize, tSettings, tResult))
+		{
+			printf("error: DB %s run failed.\n", pszSize);
+			iResult = 1;
+			continue;
+		}
+		PrintResult(tResult, uImageSize);
+	}
+
+	qfree(pImage);
+	return(iResult);
+}
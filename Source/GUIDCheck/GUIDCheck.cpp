@@ -0,0 +1,826 @@
+
+// ****************************************************************************
+// File: GUIDCheck.cpp
+// Desc: Differential check of the scan engine for "GUID-Finder".
+//       Every scan kernel, stride, thread count and option combination has
+//       to find exactly the hits a plain per GUID search finds.
+//
+// ****************************************************************************
+#include "../StdAfx.h"
+#include "../ScanEngine.h"
+#include "../GUIDText.h"
+
+/*
+	Usage: GUIDCheck [-n <iterations>] [-s <seed>] [-m <KB>] [-v] [<file> ..]
+	  -n <iterations>  Random images to check, default 200
+	  -s <seed>        First random seed, default 1; each image uses the next one
+	  -m <KB>          Largest image size, default 2600 (a few scan chunks)
+	  -v               List every check
+	  <file> ..        Check these files as images instead, e.g. a saved failure
+
+	Images are random noise, runs of hex digits and dashes, or zeros, with DB
+	GUIDs planted in every form: binary, RFC 4122 order, ASCII and UTF-16 text
+	in mixed case. Plants go at every alignment, straddling scan chunk
+	boundaries and the edges of unloaded gaps, back to back, overlapping each
+	other, and with single byte mismatches. Fixed images first put text forms
+	right at a chunk boundary, with a hex digit or dash just outside them. The DB has keys sharing their
+	first 8 bytes, so the prefilter passes offsets the look up then rejects.
+
+	The reference is the plug-in's original approach: a pass over each loaded
+	run for every DB GUID and form, comparing byte by byte.
+
+	Build with GUIDFINDER_SANITIZE (see CMakeLists.txt) to run it under the
+	address and undefined behavior sanitizers. With GUIDFINDER_FUZZER and
+	Clang the same check is a libFuzzer target taking the image as the input.
+
+	Returns 0 when every check matched, 1 on the first mismatch. The failing
+	image is saved to "GUIDCheck_fail.bin" with its gaps zeroed.
+*/
+
+#define DB_SIZE    48
+#define MAX_RANGES 2
+
+// Image under check, with its unloaded gaps
+struct tIMAGE
+{
+	PBYTE pData;
+	PBYTE pLoaded; // Per byte, 0 if it has no value
+	UINT  uSize;
+	ea_t  baseEA;
+	ea_t  aRangeEA[MAX_RANGES + 1]; // Scanned ranges, end of one is the start of the next
+	UINT  uRanges;
+};
+
+// Engine configuration under check
+struct tVARIANT
+{
+	eSCANKERNEL eKernel;
+	UINT uStride;
+	UINT uThreads;
+	BOOL bText;
+	BOOL bRFC4122;
+};
+
+// Hit list
+struct tHITS
+{
+	tSCANHIT *pHits;
+	UINT uCount, uMax;
+};
+
+static UINT s_uRandom = 1;
+static BOOL s_bVerbose = FALSE;
+static CompiledDB s_DB;
+static PBYTE s_pDBImage = NULL;
+static GUID s_aSwapped[DB_SIZE]; // RFC 4122 order DB keys
+
+
+// Xorshift PRNG, the same sequence on every platform
+static inline UINT Random()
+{
+	s_uRandom ^= (s_uRandom << 13);
+	s_uRandom ^= (s_uRandom >> 17);
+	s_uRandom ^= (s_uRandom << 5);
+	return(s_uRandom);
+}
+
+static void SwapGUIDOrder(const GUID &rIn, GUID &rOut)
+{
+	rOut.Data1 = _byteswap_ulong(rIn.Data1);
+	rOut.Data2 = _byteswap_ushort(rIn.Data2);
+	rOut.Data3 = _byteswap_ushort(rIn.Data3);
+	memcpy(rOut.Data4, rIn.Data4, sizeof(rOut.Data4));
+}
+
+static BOOL AddHit(tHITS &rHits, ea_t ea, UINT uKey, UINT uForm)
+{
+	if(rHits.uCount >= rHits.uMax)
+	{
+		UINT uMax = (rHits.uMax ? (rHits.uMax * 2) : 1024);
+		tSCANHIT *pHits = (tSCANHIT *) qrealloc(rHits.pHits, (sizeof(tSCANHIT) * uMax));
+		if(!pHits)
+			return(FALSE);
+		rHits.pHits = pHits;
+		rHits.uMax  = uMax;
+	}
+	tSCANHIT &rHit = rHits.pHits[rHits.uCount++];
+	rHit.ea = ea;
+	rHit.uKey = uKey;
+	rHit.uForm = uForm;
+	return(TRUE);
+}
+
+static int __cdecl CompareHit(const void *pA, const void *pB)
+{
+	const tSCANHIT *pHitA = (const tSCANHIT *) pA, *pHitB = (const tSCANHIT *) pB;
+	if(pHitA->ea != pHitB->ea)
+		return((pHitA->ea < pHitB->ea) ? -1 : 1);
+	if(pHitA->uForm != pHitB->uForm)
+		return((pHitA->uForm < pHitB->uForm) ? -1 : 1);
+	return((pHitA->uKey < pHitB->uKey) ? -1 : (pHitA->uKey > pHitB->uKey));
+}
+
+
+// Test DB: random keys, pairs sharing the first 8 bytes (and so the prefilter
+// hash), a key whose RFC 4122 form is itself, and keys made of hex digit and
+// dash bytes that look like text.
+static BOOL BuildDB()
+{
+	CompiledDB::tENTRY aEntry[DB_SIZE];
+	static char aszLabel[DB_SIZE][16];
+	for(UINT i = 0; i < DB_SIZE; i++)
+	{
+		GUID &rGUID = aEntry[i].Guid;
+		UINT *puGUID = (UINT *) &rGUID;
+		for(UINT j = 0; j < 4; j++)
+			puGUID[j] = Random();
+		if((i & 7) == 1)
+		{
+			memcpy(&rGUID, &aEntry[i - 1].Guid, 8);
+			rGUID.Data4[7] ^= 0x5A;
+		}
+		else
+		if(i == 2)
+		{
+			rGUID.Data1 = 0x11000011;
+			rGUID.Data2 = rGUID.Data3 = 0;
+		}
+		else
+		if(i == 3)
+			memcpy(&rGUID, "0123-4567-89AB-C", sizeof(GUID));
+
+		qsnprintf(aszLabel[i], sizeof(aszLabel[i]), "IID_Check%u", i);
+		aEntry[i].uType = 0;
+		aEntry[i].pszLabel = aszLabel[i];
+	}
+
+	CompiledDB::tHEADER tInfo;
+	ZeroMemory(&tInfo, sizeof(tInfo));
+	qstrncpy(tInfo.aszType[0], "IID", CompiledDB::TYPE_NAME_SIZE);
+	tInfo.uTypeCount = 1;
+	UINT uSize;
+	if(!(s_pDBImage = CompiledDB::Build(aEntry, DB_SIZE, tInfo, uSize)) || !s_DB.Attach(s_pDBImage, uSize) || (s_DB.GetCount() != DB_SIZE))
+		return(FALSE);
+	for(UINT i = 0; i < DB_SIZE; i++)
+		SwapGUIDOrder(s_DB.GetKeys()[i], s_aSwapped[i]);
+	return(TRUE);
+}
+
+
+// Write a GUID form at "uOffset", as much of it as fits.
+// Sometimes a byte off for a near miss, unless "bExact".
+static void Plant(tIMAGE &rImage, UINT uOffset, UINT uKey, UINT uForm, BOOL bExact = FALSE)
+{
+	BYTE abForm[MAX_GUID_FORM_SIZE];
+	UINT uLength = sizeof(GUID);
+	const GUID &rGUID = s_DB.GetKeys()[uKey];
+	switch(uForm)
+	{
+		case HIT_BINARY:  memcpy(abForm, &rGUID, sizeof(GUID)); break;
+		case HIT_RFC4122: memcpy(abForm, &s_aSwapped[uKey], sizeof(GUID)); break;
+		default:
+		{
+			// Text, in mixed case
+			char szGUID[GUID_TEXT_SIZE];
+			GUIDToString(rGUID, szGUID);
+			UINT uCase = Random();
+			uLength = 0;
+			for(UINT i = 0; i < TEXT_GUID_LENGTH; i++)
+			{
+				char c = szGUID[i];
+				if((c >= 'A') && (c <= 'F') && ((uCase >> (i & 31)) & 1))
+					c |= 0x20;
+				abForm[uLength++] = c;
+				if(uForm == HIT_UTF16)
+					abForm[uLength++] = 0;
+			}
+		}
+		break;
+	};
+
+	// Sometimes one byte off, for a near miss
+	if(!bExact && !(Random() % 6))
+		abForm[Random() % uLength] ^= (BYTE) (1 << (Random() & 7));
+
+	if(uOffset < rImage.uSize)
+		memcpy(&rImage.pData[uOffset], abForm, (((rImage.uSize - uOffset) < uLength) ? (rImage.uSize - uOffset) : uLength));
+}
+
+static inline UINT RandomForm()
+{
+	static const BYTE abForm[] = { HIT_BINARY, HIT_BINARY, HIT_RFC4122, HIT_ASCII, HIT_UTF16 };
+	return(abForm[Random() % sizeof(abForm)]);
+}
+
+// Make a random image to check
+static BOOL MakeImage(tIMAGE &rImage, UINT uMaxSize)
+{
+	// Small to a few chunks, sometimes just over a chunk boundary
+	UINT uSize;
+	switch(Random() % 4)
+	{
+		case 0:  uSize = (Random() % 4096); break;
+		case 1:  uSize = (SegReader::CHUNK_SIZE + (Random() % 256)); break;
+		default: uSize = (Random() % uMaxSize); break;
+	};
+	if(uSize > uMaxSize)
+		uSize = uMaxSize;
+	rImage.uSize = uSize;
+	rImage.pData   = (PBYTE) qalloc(uSize + 1);
+	rImage.pLoaded = (PBYTE) qalloc(uSize + 1);
+	if(!rImage.pData || !rImage.pLoaded)
+		return(FALSE);
+	rImage.baseEA = (0x400000 + (Random() % 64));
+
+	// Fill: noise, hex digits and dashes, or zeros
+	UINT uFill = (Random() % 4);
+	for(UINT i = 0; i < uSize; i++)
+	{
+		switch(uFill)
+		{
+			case 0:  rImage.pData[i] = (BYTE) Random(); break;
+			case 1:  rImage.pData[i] = "0123456789abcdefABCDEF-"[Random() % 23]; break;
+			case 2:  rImage.pData[i] = (BYTE) (((i & 1) || (Random() & 1)) ? 0 : "0123456789ABCDEF-"[Random() % 17]); break;
+			default: rImage.pData[i] = 0; break;
+		};
+	}
+	memset(rImage.pLoaded, 1, uSize);
+	if(!uSize)
+		return(TRUE);
+
+	// Scattered plants at every alignment
+	UINT uPlants = (1 + (uSize / 2048));
+	for(UINT i = 0; i < uPlants; i++)
+		Plant(rImage, (Random() % uSize), (Random() % DB_SIZE), RandomForm());
+
+	// Back to back and overlapping
+	for(UINT i = 0; i < 4; i++)
+	{
+		UINT uOffset = (Random() % uSize), uForm = RandomForm();
+		UINT uStep = ((uForm == HIT_UTF16) ? (TEXT_GUID_LENGTH * 2) : ((uForm == HIT_ASCII) ? TEXT_GUID_LENGTH : sizeof(GUID)));
+		if(Random() & 1)
+			uStep = (1 + (Random() % uStep));
+		for(UINT j = 0; j < 3; j++)
+			Plant(rImage, (uOffset + (j * uStep)), (Random() % DB_SIZE), uForm);
+	}
+
+	// Straddling the chunk boundaries, counted from the image start
+	for(UINT uEnd = SegReader::CHUNK_SIZE; uEnd < uSize; uEnd += (SegReader::CHUNK_SIZE - SegReader::OVERLAP))
+	{
+		for(UINT i = 0; i < 3; i++)
+		{
+			UINT uOffset = (uEnd - MAX_GUID_FORM_SIZE - 2 + (Random() % (MAX_GUID_FORM_SIZE + 4)));
+			Plant(rImage, uOffset, (Random() % DB_SIZE), RandomForm());
+		}
+	}
+
+	// Unloaded gaps, some cutting through plants
+	UINT uGaps = (Random() % 4);
+	for(UINT i = 0; i < uGaps; i++)
+	{
+		UINT uStart = (Random() % uSize);
+		UINT uLength = (1 + (Random() % 80));
+		if(uLength > (uSize - uStart))
+			uLength = (uSize - uStart);
+		memset(&rImage.pLoaded[uStart], 0, uLength);
+		Plant(rImage, (uStart + uLength), (Random() % DB_SIZE), RandomForm());
+	}
+
+	// One range, or two split anywhere
+	rImage.uRanges = (1 + (Random() & 1));
+	rImage.aRangeEA[0] = rImage.baseEA;
+	rImage.aRangeEA[rImage.uRanges] = (rImage.baseEA + uSize);
+	if(rImage.uRanges == 2)
+		rImage.aRangeEA[1] = (rImage.baseEA + (Random() % (uSize + 1)));
+	return(TRUE);
+}
+
+static void FreeImage(tIMAGE &rImage)
+{
+	if(rImage.pData) qfree(rImage.pData);
+	if(rImage.pLoaded) qfree(rImage.pLoaded);
+	rImage.pData = rImage.pLoaded = NULL;
+}
+
+// Fixed image: a text form at the first chunk boundary with a hex digit or
+// dash just outside it, so only the neighbor check can reject it.
+// "bStart" puts it at the start of the second chunk instead of the end of the first.
+static BOOL MakeBoundaryImage(tIMAGE &rImage, UINT uForm, BOOL bStart, BYTE bOuter)
+{
+	rImage.uSize = (SegReader::CHUNK_SIZE + 4096);
+	rImage.pData   = (PBYTE) qcalloc((rImage.uSize + 1), 1);
+	rImage.pLoaded = (PBYTE) qalloc(rImage.uSize + 1);
+	if(!rImage.pData || !rImage.pLoaded)
+		return(FALSE);
+	memset(rImage.pLoaded, 1, rImage.uSize);
+	rImage.baseEA = 0x400000;
+	rImage.uRanges = 1;
+	rImage.aRangeEA[0] = rImage.baseEA;
+	rImage.aRangeEA[1] = (rImage.baseEA + rImage.uSize);
+
+	UINT uChar = ((uForm == HIT_UTF16) ? 2 : 1);
+	UINT uLength = (TEXT_GUID_LENGTH * uChar);
+	UINT uOffset = (bStart ? (SegReader::CHUNK_SIZE - SegReader::OVERLAP) : (SegReader::CHUNK_SIZE - uLength));
+	Plant(rImage, uOffset, 12, uForm, TRUE);
+	rImage.pData[bStart ? (uOffset - uChar) : (uOffset + uLength)] = bOuter;
+	return(TRUE);
+}
+
+
+// The image as a byte source, gaps and all
+class ImageSource : public ByteSource
+{
+public:
+	ImageSource(const tIMAGE &rImage) : m_rImage(rImage) {}
+
+	ea_t NextLoaded(ea_t ea, ea_t endEA)
+	{
+		for(; ea < endEA; ea++)
+		{
+			if(m_rImage.pLoaded[ea - m_rImage.baseEA])
+				return(ea);
+		}
+		return(BADADDR);
+	}
+
+	ea_t RunEnd(ea_t ea, ea_t endEA)
+	{
+		while((ea < endEA) && m_rImage.pLoaded[ea - m_rImage.baseEA])
+			ea++;
+		return(ea);
+	}
+
+	BOOL Read(ea_t ea, PBYTE pBuffer, UINT uSize)
+	{
+		for(UINT i = 0; i < uSize; i++)
+		{
+			// Reading a gap is an engine bug
+			if(!m_rImage.pLoaded[ea - m_rImage.baseEA + i])
+				return(FALSE);
+		}
+		memcpy(pBuffer, &m_rImage.pData[ea - m_rImage.baseEA], uSize);
+		return(TRUE);
+	}
+
+private:
+	const tIMAGE &m_rImage;
+	void operator=(const ImageSource &);
+};
+
+
+// Text GUID char at "p", as the scanner defines it: a hex digit or dash, with
+// a zero high byte for UTF-16
+static BOOL IsTextChar(const BYTE *p, UINT uChar)
+{
+	if((uChar == 2) && p[1])
+		return(FALSE);
+	BYTE c = p[0];
+	return((c == '-') || ((c >= '0') && (c <= '9')) || ((c >= 'a') && (c <= 'f')) || ((c >= 'A') && (c <= 'F')));
+}
+
+// Does the text at "p" spell "pszGUID", ignoring case
+static BOOL IsTextGUID(const BYTE *p, LPCSTR pszGUID, UINT uChar)
+{
+	for(UINT i = 0; i < TEXT_GUID_LENGTH; i++, p += uChar)
+	{
+		if((uChar == 2) && p[1])
+			return(FALSE);
+		BYTE c = p[0];
+		if((c >= 'a') && (c <= 'f'))
+			c &= ~0x20;
+		if(c != (BYTE) pszGUID[i])
+			return(FALSE);
+	}
+	return(TRUE);
+}
+
+// Reference matcher, one loaded run [startEA, endEA).
+// Every DB GUID is searched for in turn over the whole run, in each form.
+// The text forms stand alone, not inside a longer run of digits and dashes.
+static BOOL ReferenceRun(const tIMAGE &rImage, ea_t startEA, ea_t endEA, tHITS &rHits)
+{
+	const BYTE *pRun = &rImage.pData[startEA - rImage.baseEA];
+	UINT uSize = (endEA - startEA);
+
+	for(UINT uKey = 0; uKey < DB_SIZE; uKey++)
+	{
+		const GUID &rGUID = s_DB.GetKeys()[uKey];
+		char szGUID[GUID_TEXT_SIZE];
+		GUIDToString(rGUID, szGUID);
+
+		for(UINT uOffset = 0; uOffset < uSize; uOffset++)
+		{
+			ea_t ea = (startEA + uOffset);
+			UINT uLeft = (uSize - uOffset);
+			if(uLeft >= sizeof(GUID))
+			{
+				if(memcmp(&pRun[uOffset], &rGUID, sizeof(GUID)) == 0)
+				{
+					if(!AddHit(rHits, ea, uKey, HIT_BINARY))
+						return(FALSE);
+				}
+				if(memcmp(&pRun[uOffset], &s_aSwapped[uKey], sizeof(GUID)) == 0)
+				{
+					if(!AddHit(rHits, ea, uKey, HIT_RFC4122))
+						return(FALSE);
+				}
+			}
+
+			for(UINT uChar = 1; uChar <= 2; uChar++)
+			{
+				UINT uLength = (TEXT_GUID_LENGTH * uChar);
+				if((uLeft < uLength) || !IsTextGUID(&pRun[uOffset], szGUID, uChar))
+					continue;
+				if((uOffset >= uChar) && IsTextChar(&pRun[uOffset - uChar], uChar))
+					continue;
+				if(((uOffset + uLength + uChar) <= uSize) && IsTextChar(&pRun[uOffset + uLength], uChar))
+					continue;
+				if(!AddHit(rHits, ea, uKey, ((uChar == 2) ? HIT_UTF16 : HIT_ASCII)))
+					return(FALSE);
+			}
+		}
+	}
+	return(TRUE);
+}
+
+// Reference hits of the whole image, every form at every offset
+static BOOL Reference(const tIMAGE &rImage, tHITS &rHits)
+{
+	for(UINT r = 0; r < rImage.uRanges; r++)
+	{
+		ea_t ea = rImage.aRangeEA[r], endEA = rImage.aRangeEA[r + 1];
+		while(ea < endEA)
+		{
+			if(!rImage.pLoaded[ea - rImage.baseEA])
+			{
+				ea++;
+				continue;
+			}
+			ea_t runEndEA = ea;
+			while((runEndEA < endEA) && rImage.pLoaded[runEndEA - rImage.baseEA])
+				runEndEA++;
+			if(!ReferenceRun(rImage, ea, runEndEA, rHits))
+				return(FALSE);
+			ea = runEndEA;
+		};
+	}
+	if(rHits.uCount)
+		qsort(rHits.pHits, rHits.uCount, sizeof(tSCANHIT), CompareHit);
+	return(TRUE);
+}
+
+// The reference hits a variant should find.
+// Binary forms only at stride aligned addresses. An RFC 4122 form that's also
+// a DB key in Microsoft order is that key's hit.
+static BOOL Expected(const tHITS &rReference, const tVARIANT &rVariant, tHITS &rHits)
+{
+	for(UINT i = 0; i < rReference.uCount; i++)
+	{
+		const tSCANHIT &rHit = rReference.pHits[i];
+		switch(rHit.uForm)
+		{
+			case HIT_ASCII:
+			case HIT_UTF16:
+			if(!rVariant.bText)
+				continue;
+			break;
+
+			case HIT_RFC4122:
+			{
+				if(!rVariant.bRFC4122)
+					continue;
+				BOOL bIsKey = FALSE;
+				for(UINT uKey = 0; uKey < DB_SIZE; uKey++)
+					bIsKey |= (memcmp(&s_aSwapped[rHit.uKey], &s_DB.GetKeys()[uKey], sizeof(GUID)) == 0);
+				if(bIsKey)
+					continue;
+			}
+			// Fall through
+
+			default:
+			if(rHit.ea % rVariant.uStride)
+				continue;
+			break;
+		};
+		if(!AddHit(rHits, rHit.ea, rHit.uKey, rHit.uForm))
+			return(FALSE);
+	}
+	return(TRUE);
+}
+
+
+static LPCSTR GetFormName(UINT uForm)
+{
+	static const LPCSTR aszForm[] = { "binary", "ASCII", "UTF-16", "RFC 4122" };
+	return((uForm < 4) ? aszForm[uForm] : "?");
+}
+
+static void PrintVariant(const tVARIANT &rVariant)
+{
+	printf("%s kernel, stride %u, %u thread(s)%s%s", GetScanKernelName(rVariant.eKernel), rVariant.uStride, rVariant.uThreads, (rVariant.bText ? ", text" : ""), (rVariant.bRFC4122 ? ", RFC 4122" : ""));
+}
+
+// Report the differences between the expected and found hits, both sorted
+static void ReportMismatch(const tHITS &rExpected, const tSCANHIT *pFound, UINT uFound)
+{
+	UINT i = 0, j = 0, uReported = 0;
+	while(((i < rExpected.uCount) || (j < uFound)) && (uReported < 16))
+	{
+		int iCompare = ((i >= rExpected.uCount) ? 1 : ((j >= uFound) ? -1 : CompareHit(&rExpected.pHits[i], &pFound[j])));
+		if(!iCompare)
+		{
+			i++, j++;
+			continue;
+		}
+		const tSCANHIT &rHit = ((iCompare < 0) ? rExpected.pHits[i++] : pFound[j++]);
+		printf("  %s %08X key %u %s\n", ((iCompare < 0) ? "missed" : "extra "), rHit.ea, rHit.uKey, GetFormName(rHit.uForm));
+		uReported++;
+	}
+}
+
+static void SaveFailure(const tIMAGE &rImage)
+{
+	if(FILE *fp = qfopen("GUIDCheck_fail.bin", "wb"))
+	{
+		for(UINT i = 0; i < rImage.uSize; i++)
+			fputc((rImage.pLoaded[i] ? rImage.pData[i] : 0), fp);
+		qfclose(fp);
+		printf("Image saved to \"GUIDCheck_fail.bin\".\n");
+	}
+}
+
+
+// Check every engine variant against the reference; returns FALSE on a mismatch
+static BOOL CheckImage(const tIMAGE &rImage, LPCSTR pszName)
+{
+	static const eSCANKERNEL aeKernel[] = { SCAN_SCALAR, SCAN_SSE2, SCAN_AVX2 };
+	static const UINT auStride[] = { 1, 4, 8 };
+	static const UINT auThreads[] = { 1, 3 };
+
+	tHITS Reference = { NULL, 0, 0 };
+	if(!::Reference(rImage, Reference))
+	{
+		printf("error: Out of memory.\n");
+		return(FALSE);
+	}
+
+	BOOL bResult = TRUE;
+	ImageSource Source(rImage);
+	for(UINT uRFC = 0; (uRFC < 2) && bResult; uRFC++)
+	{
+		ScanEngine Engine;
+		if(!Engine.BuildIndex(s_DB, uRFC))
+		{
+			bResult = FALSE;
+			break;
+		}
+
+		for(UINT k = 0; (k < (sizeof(aeKernel) / sizeof(aeKernel[0]))) && bResult; k++)
+		{
+			// Kernels the CPU doesn't have are already covered
+			eSCANKERNEL eKernel = SetScanKernel(aeKernel[k]);
+			if(eKernel != aeKernel[k])
+				continue;
+
+			for(UINT t = 0; (t < (sizeof(auThreads) / sizeof(auThreads[0]))) && bResult; t++)
+			{
+				if(!Engine.Start(auThreads[t]))
+				{
+					printf("error: Failed to start scan threads.\n");
+					bResult = FALSE;
+					break;
+				}
+
+				for(UINT s = 0; (s < (sizeof(auStride) / sizeof(auStride[0]))) && bResult; s++)
+				{
+					for(UINT uText = 0; (uText < 2) && bResult; uText++)
+					{
+						tVARIANT tVariant = { eKernel, auStride[s], auThreads[t], (BOOL) uText, (BOOL) uRFC };
+						Engine.Reset();
+						for(UINT r = 0; r < rImage.uRanges; r++)
+							Engine.ScanRange(Source, rImage.aRangeEA[r], rImage.aRangeEA[r + 1], tVariant.uStride, (uText ? SCAN_TEXT : 0));
+
+						tHITS Expected = { NULL, 0, 0 };
+						if(!::Expected(Reference, tVariant, Expected))
+						{
+							printf("error: Out of memory.\n");
+							bResult = FALSE;
+							break;
+						}
+						tSCANHIT *pFound = (tSCANHIT *) qalloc(sizeof(tSCANHIT) * (Engine.GetHitCount() + 1));
+						if(!pFound)
+						{
+							printf("error: Out of memory.\n");
+							bResult = FALSE;
+						}
+						else
+						{
+							if(Engine.GetHitCount())
+							{
+								memcpy(pFound, Engine.GetHits(), (sizeof(tSCANHIT) * Engine.GetHitCount()));
+								qsort(pFound, Engine.GetHitCount(), sizeof(tSCANHIT), CompareHit);
+							}
+							BOOL bMatch = ((Expected.uCount == Engine.GetHitCount()) && (!Expected.uCount || (memcmp(Expected.pHits, pFound, (sizeof(tSCANHIT) * Expected.uCount)) == 0)));
+							if(s_bVerbose || !bMatch)
+							{
+								printf("%s: %u bytes, %u range(s), ", pszName, rImage.uSize, rImage.uRanges);
+								PrintVariant(tVariant);
+								printf(": %u hits%s\n", Engine.GetHitCount(), (bMatch ? "" : ", MISMATCH"));
+							}
+							if(!bMatch)
+							{
+								ReportMismatch(Expected, pFound, Engine.GetHitCount());
+								bResult = FALSE;
+							}
+							qfree(pFound);
+						}
+						if(Expected.pHits) qfree(Expected.pHits);
+					}
+				}
+				Engine.Stop();
+			}
+		}
+	}
+
+	if(Reference.pHits) qfree(Reference.pHits);
+	return(bResult);
+}
+
+
+// The fixed chunk boundary images, every form, side and outer char
+static BOOL CheckBoundaries()
+{
+	static const BYTE abOuter[] = { '7', '-' };
+	for(UINT uForm = HIT_ASCII; uForm <= HIT_UTF16; uForm++)
+	{
+		for(UINT uStart = 0; uStart < 2; uStart++)
+		{
+			for(UINT o = 0; o < sizeof(abOuter); o++)
+			{
+				tIMAGE tImage;
+				ZeroMemory(&tImage, sizeof(tImage));
+				if(!MakeBoundaryImage(tImage, uForm, uStart, abOuter[o]))
+				{
+					printf("error: Out of memory.\n");
+					FreeImage(tImage);
+					return(FALSE);
+				}
+				char szName[64];
+				qsnprintf(szName, sizeof(szName), "%s %s chunk boundary, '%c' outside", GetFormName(uForm), (uStart ? "starting at the" : "ending at the"), abOuter[o]);
+				BOOL bMatch = CheckImage(tImage, szName);
+				if(!bMatch)
+					SaveFailure(tImage);
+				FreeImage(tImage);
+				if(!bMatch)
+					return(FALSE);
+			}
+		}
+	}
+	return(TRUE);
+}
+
+
+#ifdef GUIDFINDER_FUZZER
+// libFuzzer entry, the input is the image: one range, no gaps
+extern "C" int LLVMFuzzerTestOneInput(const BYTE *pData, size_t uSize)
+{
+	if(!s_DB.IsOpen() && !BuildDB())
+		return(0);
+
+	tIMAGE tImage;
+	ZeroMemory(&tImage, sizeof(tImage));
+	tImage.uSize   = (UINT) ((uSize > (SegReader::CHUNK_SIZE * 3)) ? (SegReader::CHUNK_SIZE * 3) : uSize);
+	tImage.pData   = (PBYTE) pData;
+	tImage.pLoaded = (PBYTE) qalloc(tImage.uSize + 1);
+	if(!tImage.pLoaded)
+		return(0);
+	memset(tImage.pLoaded, 1, tImage.uSize);
+	tImage.baseEA = 0x400000;
+	tImage.uRanges = 1;
+	tImage.aRangeEA[0] = tImage.baseEA;
+	tImage.aRangeEA[1] = (tImage.baseEA + tImage.uSize);
+	if(!CheckImage(tImage, "input"))
+		abort();
+	qfree(tImage.pLoaded);
+	return(0);
+}
+#else
+
+int main(int argc, char *argv[])
+{
+	UINT uIterations = 200, uMaxKB = 2600;
+	int iFiles = 0;
+	for(int i = 1; i < argc; i++)
+	{
+		if((strcmp(argv[i], "-n") == 0) && ((i + 1) < argc))
+			uIterations = strtoul(argv[++i], NULL, 10);
+		else
+		if((strcmp(argv[i], "-s") == 0) && ((i + 1) < argc))
+			s_uRandom = strtoul(argv[++i], NULL, 10);
+		else
+		if((strcmp(argv[i], "-m") == 0) && ((i + 1) < argc))
+			uMaxKB = strtoul(argv[++i], NULL, 10);
+		else
+		if(strcmp(argv[i], "-v") == 0)
+			s_bVerbose = TRUE;
+		else
+		if(argv[i][0] == '-')
+		{
+			printf("Usage: GUIDCheck [-n <iterations>] [-s <seed>] [-m <KB>] [-v] [<file> ..]\n");
+			return(1);
+		}
+		else
+			iFiles++;
+	}
+	if(!s_uRandom)
+		s_uRandom = 1;
+	UINT uSeed = s_uRandom;
+
+	if(!BuildDB())
+	{
+		printf("error: Failed to build the test DB.\n");
+		return(1);
+	}
+
+	// Files given, check them as they are
+	if(iFiles)
+	{
+		for(int i = 1; i < argc; i++)
+		{
+			if(argv[i][0] == '-')
+			{
+				if(argv[i][1] != 'v')
+					i++;
+				continue;
+			}
+
+			tIMAGE tImage;
+			ZeroMemory(&tImage, sizeof(tImage));
+			FILE *fp = qfopen(argv[i], "rb");
+			if(!fp)
+			{
+				printf("%s: error: Can't open file.\n", argv[i]);
+				return(1);
+			}
+			tImage.uSize   = qfsize(fp);
+			tImage.pData   = (PBYTE) qalloc(tImage.uSize + 1);
+			tImage.pLoaded = (PBYTE) qalloc(tImage.uSize + 1);
+			BOOL bRead = (tImage.pData && tImage.pLoaded && ((UINT) qfread(fp, tImage.pData, tImage.uSize) == tImage.uSize));
+			qfclose(fp);
+			if(!bRead)
+			{
+				printf("%s: error: Can't read file.\n", argv[i]);
+				FreeImage(tImage);
+				return(1);
+			}
+			memset(tImage.pLoaded, 1, tImage.uSize);
+			tImage.baseEA = 0x400000;
+			tImage.uRanges = 1;
+			tImage.aRangeEA[0] = tImage.baseEA;
+			tImage.aRangeEA[1] = (tImage.baseEA + tImage.uSize);
+			BOOL bMatch = CheckImage(tImage, argv[i]);
+			FreeImage(tImage);
+			if(!bMatch)
+				return(1);
+			printf("%s: OK\n", argv[i]);
+		}
+		return(0);
+	}
+
+	// Text forms at a chunk boundary, with their neighbor check on the line
+	TIMESTAMP StartTime = GetTimeStamp();
+	if(!CheckBoundaries())
+		return(1);
+
+	// Random images, each from its own seed so a failure can be rerun alone
+	for(UINT i = 0; i < uIterations; i++)
+	{
+		s_uRandom = (uSeed + i);
+		if(!s_uRandom)
+			s_uRandom = 1;
+		char szName[32];
+		qsnprintf(szName, sizeof(szName), "seed %u", (uSeed + i));
+
+		tIMAGE tImage;
+		ZeroMemory(&tImage, sizeof(tImage));
+		if(!MakeImage(tImage, (uMaxKB * 1024)))
+		{
+			printf("error: Out of memory.\n");
+			FreeImage(tImage);
+			return(1);
+		}
+		BOOL bMatch = CheckImage(tImage, szName);
+		if(!bMatch)
+		{
+			SaveFailure(tImage);
+			printf("Rerun it with \"-s %u -n 1\".\n", (uSeed + i));
+		}
+		FreeImage(tImage);
+		if(!bMatch)
+			return(1);
+	}
+
+	printf("8 chunk boundary and %u random images checked, every variant matched the reference, %.1f seconds.\n", uIterations, (GetTimeStamp() - StartTime));
+	return(0);
+}
+#endif // GUIDFINDER_FUZZER
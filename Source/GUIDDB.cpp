@@ -0,0 +1,622 @@
+
+// ****************************************************************************
+// File: GUIDDB.cpp
+// Desc: GUID database loader
+//
+// ****************************************************************************
+#include "StdAfx.h"
+#include "GUIDDB.h"
+#include "GUIDText.h"
+
+//#define SAVE_FIXED // To help sort out duplicates
+
+// Default DB types, when there is no type list file
+struct tDB_ENTRY
+{
+	LPCSTR pszFileName;  // DB File name
+	LPCSTR pszType;    // DB Type prefix
+	LPCSTR pszStruct;  // IDA struct
+} static const aDefaultType[] =
+{
+	{"Interfaces.txt",     "IID",   "IID"},
+	{"Classes.txt",        "CLSID", "CLSID"},
+	{"Libraries.txt",      "LIBID", "LIBID"},
+	{"DispInterfaces.txt", "DIID",  "IID"},
+	{"Categories.txt",     "CATID", "CATID"},
+};
+
+// File name part of a path
+static LPCSTR GetFileName(LPCSTR pszPath)
+{
+	LPCSTR pszName = pszPath;
+	for(LPCSTR psz = pszPath; *psz; psz++)
+	{
+		if((*psz == '\\') || (*psz == '/'))
+			pszName = (psz + 1);
+	}
+	return(pszName);
+}
+
+
+GUIDDB::GUIDDB(const BYTE *pStock, UINT uStockSize, DWORD dwStockStamp) : m_pStock(pStock), m_uStockSize(uStockSize), m_dwStockStamp(dwStockStamp), m_uTypeCount(0),
+	m_pText(NULL), m_uTextCount(0), m_uTextMax(0), m_pGUIDSet(NULL), m_uGUIDSetMask(0), m_uGUIDSetCount(0)
+{
+	ZeroMemory(&m_DBStamp, sizeof(m_DBStamp));
+}
+
+GUIDDB::~GUIDDB()
+{
+	Free();
+}
+
+void GUIDDB::Free()
+{
+	Close();
+	FreeText();
+}
+
+
+// Load the DB type list file, or use the default types if there isn't one
+void GUIDDB::LoadTypeList(LPCSTR pszPath)
+{
+	m_uTypeCount = 0;
+	if(pszPath)
+	{
+		LPCSTR pszName = GetFileName(pszPath);
+		if(FILE *fp = qfopen(pszPath, "rb"))
+		{
+			char szLine[512];
+			int iFileLine = 0;
+			while(qfgets(szLine, sizeof(szLine), fp))
+			{
+				++iFileLine;
+				if(LPSTR pszComment = strchr(szLine, '#'))
+					*pszComment = 0;
+
+				char szType[64], szFileName[128], szStruct[128];
+				int iFields = _snscanf(szLine, (sizeof(szLine) - 1), "%63s %127s %127s", szType, szFileName, szStruct);
+				if(iFields <= 0)
+					continue;
+				if(iFields == 1)
+				{
+					msg("\n*** %s line %d: Expected \"<type> <text file> [<struct>]\"! ***\n", pszName, iFileLine);
+					continue;
+				}
+				if(iFields == 2)
+					qstrncpy(szStruct, szType, sizeof(szStruct));
+				if((strlen(szType) >= TYPE_NAME_SIZE) || (strlen(szFileName) >= sizeof(m_aType[0].szFileName)) || (strlen(szStruct) >= sizeof(m_aType[0].szStruct)))
+				{
+					msg("\n*** %s line %d: Name too long! ***\n", pszName, iFileLine);
+					continue;
+				}
+				if(m_uTypeCount >= MAX_TYPES)
+				{
+					msg("\n*** %s: Too many GUID types, max is %u! ***\n", pszName, MAX_TYPES);
+					break;
+				}
+
+				tDB_TYPE &rType = m_aType[m_uTypeCount++];
+				qstrncpy(rType.szType, szType, sizeof(rType.szType));
+				qstrncpy(rType.szFileName, szFileName, sizeof(rType.szFileName));
+				qstrncpy(rType.szStruct, szStruct, sizeof(rType.szStruct));
+			};
+			qfclose(fp);
+		}
+		if(m_uTypeCount)
+			return;
+		msg("\n*** No GUID types in \"%s\", using the defaults! ***\n", pszName);
+	}
+
+	for(UINT i = 0; i < (sizeof(aDefaultType) / sizeof(tDB_ENTRY)); i++)
+	{
+		tDB_TYPE &rType = m_aType[m_uTypeCount++];
+		qstrncpy(rType.szType, aDefaultType[i].pszType, sizeof(rType.szType));
+		qstrncpy(rType.szFileName, aDefaultType[i].pszFileName, sizeof(rType.szFileName));
+		qstrncpy(rType.szStruct, aDefaultType[i].pszStruct, sizeof(rType.szStruct));
+	}
+}
+
+// Struct name of a compiled DB type
+LPCSTR GUIDDB::GetTypeStruct(UINT uType) const
+{
+	LPCSTR pszType = GetTypeName(uType);
+	for(UINT i = 0; i < m_uTypeCount; i++)
+	{
+		if(strcmp(m_aType[i].szType, pszType) == 0)
+			return(m_aType[i].szStruct);
+	}
+	return(pszType);
+}
+
+
+// Load in GUID database
+BOOL GUIDDB::Load(LPCSTR pszDBPath, const char (*paszTextPath)[MAX_PATH], BOOL &rbKept)
+{
+	rbKept = FALSE;
+
+	// Text DB file stamps, each file is optional
+	char aszTextPath[MAX_TYPES][MAX_PATH];
+	tSOURCE aSource[MAX_TYPES];
+	UINT uTextCount = 0;
+	for(UINT i = 0; i < m_uTypeCount; i++)
+	{
+		ZeroMemory(&aSource[i], sizeof(tSOURCE));
+		if(paszTextPath[i][0] && GetSource(paszTextPath[i], aSource[i]))
+		{
+			qstrncpy(aszTextPath[i], paszTextPath[i], MAX_PATH);
+			uTextCount++;
+		}
+		else
+			aszTextPath[i][0] = 0;
+	}
+
+	// Just the stock DB
+	if(!pszDBPath || !pszDBPath[0])
+	{
+		if(IsOpen() && !IsFile())
+		{
+			msg("%u stock GUIDs still loaded from the last run.\n", GetCount());
+			rbKept = TRUE;
+			return(TRUE);
+		}
+		Free();
+		return(AttachStock());
+	}
+
+	// Still loaded from the last run, and none of the files changed?
+	tSOURCE DBStamp;
+	if(IsFile() && GetSource(pszDBPath, DBStamp) && (DBStamp.uSize == m_DBStamp.uSize) && (DBStamp.uWriteTime == m_DBStamp.uWriteTime) && IsCurrent(aSource, uTextCount))
+	{
+		msg("%u GUIDs still loaded from the last run.\n", GetCount());
+		rbKept = TRUE;
+		return(TRUE);
+	}
+
+	// Load it dynamically to allow DB edits between invocations
+	Free();
+
+	TIMESTAMP StartTime = GetTimeStamp();
+	if(!Open(pszDBPath) || !IsCurrent(aSource, uTextCount))
+	{
+		Close();
+		if(!uTextCount)
+		{
+			// Damaged or from another version, and nothing to compile it from
+			msg("\n*** Can't load compiled DB \"%s\", using the stock DB! ***\n", pszDBPath);
+			return(AttachStock());
+		}
+		if(!Compile(pszDBPath, aszTextPath, aSource))
+			return(FALSE);
+
+		StartTime = GetTimeStamp();
+		if(!Open(pszDBPath))
+		{
+			msg("\n*** Error loading compiled DB \"%s\"! ***\n", pszDBPath);
+			return(FALSE);
+		}
+	}
+	TIMESTAMP LoadTime = (GetTimeStamp() - StartTime);
+	GetSource(pszDBPath, m_DBStamp);
+
+	const tHEADER *pHeader = GetHeader();
+	msg("%u GUIDs loaded from \"%s\" in %.3f ms, %u KB mapped.\n", GetCount(), GetFileName(pszDBPath), (LoadTime * 1000.0), ((GetSize() + 1023) / 1024));
+	msg("  (Text DB parse was %.3f ms, %u KB.)\n", ((double) pHeader->uTextLoadMicros / 1000.0), ((pHeader->uTextMemory + 1023) / 1024));
+	if(!GetCount())
+	{
+		msg("\n*** No GUIDs loaded! ***\n");
+		return(FALSE);
+	}
+
+	return(TRUE);
+}
+
+
+// Use the stock DB in place
+BOOL GUIDDB::AttachStock()
+{
+	if(!Attach(m_pStock, m_uStockSize) || !GetCount())
+	{
+		Close();
+		msg("\n*** Error, the built in stock DB is damaged! ***\n");
+		return(FALSE);
+	}
+
+	msg("%u stock GUIDs built in.\n", GetCount());
+	return(TRUE);
+}
+
+
+// Returns TRUE if the open compiled DB was built from the current text DB files and stock DB
+BOOL GUIDDB::IsCurrent(const tSOURCE *pSources, UINT uTextCount)
+{
+	// No text to compile from, use what's there
+	if(!uTextCount)
+		return(TRUE);
+
+	const tHEADER *pHeader = GetHeader();
+	if((pHeader->dwStockStamp != m_dwStockStamp) || (pHeader->uTypeCount < m_uTypeCount))
+		return(FALSE);
+	for(UINT i = 0; i < m_uTypeCount; i++)
+	{
+		if((strcmp(pHeader->aszType[i], m_aType[i].szType) != 0) ||
+		   (pHeader->aSource[i].uSize != pSources[i].uSize) || (pHeader->aSource[i].uWriteTime != pSources[i].uWriteTime))
+		   return(FALSE);
+	}
+
+	return(TRUE);
+}
+
+
+static int __cdecl CompareEntryGUID(const void *pA, const void *pB)
+{
+	return(memcmp(&((const CompiledDB::tENTRY *) pA)->Guid, &((const CompiledDB::tENTRY *) pB)->Guid, sizeof(GUID)));
+}
+
+// Compile the text DB files merged over the stock DB into the binary DB
+BOOL GUIDDB::Compile(LPCSTR pszDBPath, const char (*paszTextPath)[MAX_PATH], const tSOURCE *pSources)
+{
+	msg("Compiling \"%s\"..\n", GetFileName(pszDBPath));
+	CompiledDB Stock;
+	if(!Stock.Attach(m_pStock, m_uStockSize))
+	{
+		msg("\n*** Error, the built in stock DB is damaged! ***\n");
+		return(FALSE);
+	}
+
+	// Types, the text DB ones first then any others the stock DB has
+	tHEADER tInfo;
+	ZeroMemory(&tInfo, sizeof(tInfo));
+	for(UINT i = 0; i < m_uTypeCount; i++)
+	{
+		qstrncpy(tInfo.aszType[i], m_aType[i].szType, TYPE_NAME_SIZE);
+		tInfo.aSource[i] = pSources[i];
+	}
+	tInfo.uTypeCount = m_uTypeCount;
+	UINT auStockType[MAX_TYPES];
+	for(UINT i = 0; i < Stock.GetTypeCount(); i++)
+	{
+		UINT j = 0;
+		while((j < tInfo.uTypeCount) && (strcmp(tInfo.aszType[j], Stock.GetTypeName(i)) != 0))
+			j++;
+		if(j == tInfo.uTypeCount)
+		{
+			if(j == MAX_TYPES)
+			{
+				msg("\n*** Too many GUID types, max is %u! ***\n", MAX_TYPES);
+				return(FALSE);
+			}
+			qstrncpy(tInfo.aszType[j], Stock.GetTypeName(i), TYPE_NAME_SIZE);
+			tInfo.uTypeCount++;
+		}
+		auStockType[i] = j;
+	}
+
+	TIMESTAMP StartTime = GetTimeStamp();
+	if(!LoadText(paszTextPath))
+	{
+		FreeText();
+		return(FALSE);
+	}
+	TIMESTAMP TextTime = (GetTimeStamp() - StartTime);
+
+	UINT uText = m_uTextCount;
+	BOOL bResult = FALSE;
+	if(tENTRY *pEntries = (tENTRY *) qalloc(sizeof(tENTRY) * ((uText + Stock.GetCount()) ? (uText + Stock.GetCount()) : 1)))
+	{
+		UINT uCount = 0;
+		for(; uCount < uText; uCount++)
+			pEntries[uCount] = m_pText[uCount].Entry;
+		qsort(pEntries, uText, sizeof(tENTRY), CompareEntryGUID);
+
+		// Merge in the stock GUIDs, both are sorted. A text DB GUID overrides the stock one.
+		const GUID *pStockKeys = Stock.GetKeys();
+		UINT uOverridden = 0;
+		for(UINT i = 0, t = 0; i < Stock.GetCount(); i++)
+		{
+			while((t < uText) && (memcmp(&pEntries[t].Guid, &pStockKeys[i], sizeof(GUID)) < 0))
+				t++;
+			if((t < uText) && (memcmp(&pEntries[t].Guid, &pStockKeys[i], sizeof(GUID)) == 0))
+			{
+				uOverridden++;
+				continue;
+			}
+			pEntries[uCount].Guid  = pStockKeys[i];
+			pEntries[uCount].uType = auStockType[Stock.GetType(i)];
+			pEntries[uCount].pszLabel = Stock.GetLabel(i);
+			uCount++;
+		}
+		msg("%u stock GUIDs merged in, %u overridden by the text DB.\n", (Stock.GetCount() - uOverridden), uOverridden);
+
+		if(!uCount)
+			msg("\n*** No GUIDs loaded! ***\n");
+		else
+		{
+			tInfo.uTextLoadMicros = (UINT) (TextTime * 1000000.0);
+			tInfo.uTextMemory  = (m_TextArena.GetReserved() + (m_uTextMax * sizeof(tTEXTENTRY)));
+			tInfo.dwStockStamp = m_dwStockStamp;
+			if(!(bResult = CompiledDB::Compile(pszDBPath, pEntries, uCount, tInfo)))
+				msg("\n*** Failed to write compiled DB \"%s\"! ***\n", pszDBPath);
+		}
+		qfree(pEntries);
+	}
+	else
+		msg("\n*** Failed to allocate GUID entries! ***\n");
+
+	// Done with the text DB
+	FreeText();
+	return(bResult);
+}
+
+
+// Delete the text DB GUIDs
+void GUIDDB::FreeText()
+{
+	if(m_pText)
+	{
+		qfree(m_pText);
+		m_pText = NULL;
+	}
+	m_uTextCount = m_uTextMax = 0;
+	m_TextArena.Reset();
+	GUIDSetFree();
+}
+
+
+// Hash of the whole 128 bit GUID value
+static inline UINT GUIDSetHash(const GUID &rGUID)
+{
+	const UINT *puGUID = (const UINT *) &rGUID;
+	UINT uHash = ((puGUID[0] * 0x9E3779B1) ^ (puGUID[1] * 0x85EBCA77) ^ (puGUID[2] * 0xC2B2AE3D) ^ (puGUID[3] * 0x27D4EB2F));
+	return(uHash ^ (uHash >> 15));
+}
+
+// Make room in the duplicate check set for "uCount" GUIDs in all
+BOOL GUIDDB::GUIDSetReserve(UINT uCount)
+{
+	// Keep it at most half full
+	if((uCount * 2) <= m_uGUIDSetMask)
+		return(TRUE);
+
+	UINT uSize = (m_uGUIDSetMask ? (m_uGUIDSetMask + 1) : 4096);
+	while((uCount * 2) > (uSize - 1))
+		uSize *= 2;
+	tGUIDSLOT *pSet = (tGUIDSLOT *) qalloc(sizeof(tGUIDSLOT) * uSize);
+	if(!pSet)
+		return(FALSE);
+	ZeroMemory(pSet, (sizeof(tGUIDSLOT) * uSize));
+
+	// Rehash, from the kept hashes
+	for(UINT i = 0; m_pGUIDSet && (i <= m_uGUIDSetMask); i++)
+	{
+		if(m_pGUIDSet[i].uEntry)
+		{
+			UINT j = (m_pGUIDSet[i].uHash & (uSize - 1));
+			while(pSet[j].uEntry)
+				j = ((j + 1) & (uSize - 1));
+			pSet[j] = m_pGUIDSet[i];
+		}
+	}
+
+	if(m_pGUIDSet) qfree(m_pGUIDSet);
+	m_pGUIDSet = pSet;
+	m_uGUIDSetMask = (uSize - 1);
+	return(TRUE);
+}
+
+// Add a text entry to the duplicate check set, an open addressed table keyed
+// on the full GUID value. If the GUID is already in it "ruExisting" gets the
+// entry that has it (else -1) and "uEntry" isn't added. Returns FALSE on
+// allocation failure. The hashes are kept in the table so probing only
+// touches an entry on a full hash match.
+BOOL GUIDDB::GUIDSetAdd(UINT uEntry, UINT &ruExisting)
+{
+	ruExisting = (UINT) -1;
+	if(!GUIDSetReserve(m_uGUIDSetCount + 1))
+		return(FALSE);
+
+	const GUID &rGUID = m_pText[uEntry].Entry.Guid;
+	UINT uHash = GUIDSetHash(rGUID);
+	UINT i = (uHash & m_uGUIDSetMask);
+	while(UINT uTest = m_pGUIDSet[i].uEntry)
+	{
+		if((m_pGUIDSet[i].uHash == uHash) && (memcmp(&m_pText[uTest - 1].Entry.Guid, &rGUID, sizeof(GUID)) == 0))
+		{
+			ruExisting = (uTest - 1);
+			return(TRUE);
+		}
+		i = ((i + 1) & m_uGUIDSetMask);
+	};
+
+	m_pGUIDSet[i].uHash  = uHash;
+	m_pGUIDSet[i].uEntry = (uEntry + 1);
+	m_uGUIDSetCount++;
+	return(TRUE);
+}
+
+void GUIDDB::GUIDSetFree()
+{
+	if(m_pGUIDSet)
+	{
+		qfree(m_pGUIDSet);
+		m_pGUIDSet = NULL;
+	}
+	m_uGUIDSetMask = m_uGUIDSetCount = 0;
+}
+
+
+// Load in the text GUID database files
+BOOL GUIDDB::LoadText(const char (*paszTextPath)[MAX_PATH])
+{
+	UINT uTotalSize = 0;
+	TIMESTAMP StartTime = GetTimeStamp();
+
+	// Iterate through DB list loading all the GUIDs
+	for(UINT i = 0; i < m_uTypeCount; i++)
+	{
+		// Load next DB file, if it's there
+		LPCSTR pszPath = paszTextPath[i];
+		if(!pszPath[0])
+			continue;
+		msg("Loading \"%s\"..\n", m_aType[i].szFileName);
+		UINT uGUIDCount = 0;
+
+		// Read it whole, lines are parsed in place
+		LPSTR pszText = NULL;
+		UINT uSize = 0;
+		if(FILE *fp = qfopen(pszPath, "rb"))
+		{
+			uSize = qfsize(fp);
+			if((pszText = (LPSTR) qalloc(uSize + 1)) != NULL)
+			{
+				if((UINT) qfread(fp, pszText, uSize) != uSize)
+				{
+					qfree(pszText);
+					pszText = NULL;
+				}
+			}
+			qfclose(fp);
+		}
+		if(!pszText)
+		{
+			msg("\n*** Error loading DB file \"%s\"! ***\n", pszPath);
+			continue;
+		}
+		uTotalSize += uSize;
+
+		// Size the entries and duplicate check set up front, lines are usually at least 40 chars
+		UINT uMax = (m_uTextCount + (uSize / 40) + 1);
+		if(uMax > m_uTextMax)
+		{
+			tTEXTENTRY *pText = (tTEXTENTRY *) qrealloc(m_pText, (sizeof(tTEXTENTRY) * uMax));
+			if(pText)
+			{
+				m_pText = pText;
+				m_uTextMax = uMax;
+			}
+		}
+		if(!m_pText)
+		{
+			msg("\n*** Failed to allocate GUID entries! ***\n");
+			qfree(pszText);
+			return(FALSE);
+		}
+		if(!GUIDSetReserve(m_uGUIDSetCount + (uSize / 40)))
+		{
+			msg("\n*** Failed to allocate GUID set! ***\n");
+			qfree(pszText);
+			return(FALSE);
+		}
+
+		// Iterate through text lines..
+		int iFileLine = 0;
+		LPCSTR pszEnd = (pszText + uSize);
+		for(LPCSTR pszLine = pszText; pszLine < pszEnd;)
+		{
+			++iFileLine;
+			LPCSTR pszNext = (LPCSTR) memchr(pszLine, '\n', (pszEnd - pszLine));
+			if(!pszNext)
+				pszNext = pszEnd;
+			UINT uLength = (UINT) (pszNext - pszLine);
+			LPCSTR pszThis = pszLine;
+			pszLine = (pszNext + 1);
+
+			tGUIDLINE tLine;
+			int iResult = ParseGUIDLine(pszThis, uLength, tLine);
+			if(iResult == GUIDLINE_BLANK)
+				continue;
+			if(iResult == GUIDLINE_ERROR)
+			{
+				msg("\n*** GUID format parse error @ %s line %d, column %u: %s! ***\n", m_aType[i].szFileName, iFileLine, tLine.uColumn, tLine.pszError);
+				continue;
+			}
+
+			// Label, whole. It has to fit an IDA name with room for a "_NN" suffix.
+			// The type prefix is left off if it's already there, as with "DEFINE_GUID(IID_..".
+			char szLabel[MAXNAMELEN];
+			UINT uTypeLength = strlen(m_aType[i].szType);
+			if((tLine.uLabelLength > uTypeLength) && (tLine.pszLabel[uTypeLength] == '_') && (memcmp(tLine.pszLabel, m_aType[i].szType, uTypeLength) == 0))
+			{
+				tLine.pszLabel += (uTypeLength + 1);
+				tLine.uLabelLength -= (uTypeLength + 1);
+			}
+			UINT uLabelLength = (uTypeLength + 1 + tLine.uLabelLength);
+			if(uLabelLength >= (MAXNAMELEN - 4))
+			{
+				msg("\n*** Label \"%.64s..\" @ %s line %d is too long for an IDA name! ***\n", tLine.pszLabel, m_aType[i].szFileName, iFileLine);
+				continue;
+			}
+			memcpy(szLabel, m_aType[i].szType, uTypeLength);
+			szLabel[uTypeLength] = '_';
+			memcpy(&szLabel[uTypeLength + 1], tLine.pszLabel, tLine.uLabelLength);
+			szLabel[uLabelLength] = 0;
+
+			// New GUID entry
+			if(m_uTextCount >= m_uTextMax)
+			{
+				UINT uMax = (m_uTextMax * 2);
+				tTEXTENTRY *pText = (tTEXTENTRY *) qrealloc(m_pText, (sizeof(tTEXTENTRY) * uMax));
+				if(!pText)
+				{
+					msg("\n*** Failed to allocate GUID entry! ***\n");
+					qfree(pszText);
+					return(FALSE);
+				}
+				m_pText = pText;
+				m_uTextMax = uMax;
+			}
+			tTEXTENTRY &rText = m_pText[m_uTextCount];
+			rText.Entry.Guid  = tLine.Guid;
+			rText.Entry.uType = i;
+			rText.Entry.pszLabel = NULL;
+			rText.uLine = iFileLine;
+
+			// Skip GUID duplicates
+			UINT uFirst;
+			if(!GUIDSetAdd(m_uTextCount, uFirst))
+			{
+				msg("\n*** Failed to allocate GUID set! ***\n");
+				qfree(pszText);
+				return(FALSE);
+			}
+			if(uFirst != (UINT) -1)
+			{
+				char szGUID[GUID_TEXT_SIZE];
+				const tTEXTENTRY &rFirst = m_pText[uFirst];
+				msg("** Duplicate GUID %s \"%s\" @ %s line %d, first \"%s\" @ %s line %u **\n", GUIDToString(tLine.Guid, szGUID), szLabel, m_aType[i].szFileName, iFileLine, rFirst.Entry.pszLabel, m_aType[rFirst.Entry.uType].szFileName, rFirst.uLine);
+				continue;
+			}
+			if(!(rText.Entry.pszLabel = m_TextArena.Intern(szLabel, uLabelLength)))
+			{
+				msg("\n*** Failed to allocate GUID label! ***\n");
+				qfree(pszText);
+				return(FALSE);
+			}
+
+			m_uTextCount++;
+			uGUIDCount++;
+		}
+
+		qfree(pszText);
+		msg("%u GUIDs loaded.\n", uGUIDCount);
+	}
+
+	TIMESTAMP ParseTime = (GetTimeStamp() - StartTime);
+	if(uTotalSize && (ParseTime > 0))
+		msg("Parsed %u KB of text in %.3f ms (%.1f MB/s).\n", ((uTotalSize + 1023) / 1024), (ParseTime * 1000.0), ((uTotalSize / ParseTime) / (1024.0 * 1024.0)));
+
+	GUIDSetFree();
+
+	#ifdef SAVE_FIXED
+	if(FILE *fp = qfopen("C:\\FixedList.txt", "wb"))
+	{
+		for(UINT i = 0; i < m_uTextCount; i++)
+		{
+			char szGUID[GUID_TEXT_SIZE];
+			qfprintf(fp, "%s %s\n", GUIDToString(m_pText[i].Entry.Guid, szGUID), m_pText[i].Entry.pszLabel);
+		}
+		qfclose(fp);
+	}
+	#endif
+
+	return(TRUE);
+}
@@ -0,0 +1,93 @@
+
+// ****************************************************************************
+// File: GUIDDB.h
+// Desc: GUID database loader
+//
+// ****************************************************************************
+#pragma once
+#include "CompiledDB.h"
+#include "Arena.h"
+
+// Type list, replaces the defaults. One "<type> <text file> [<struct>]" per line.
+#define TYPE_LIST_FILE "GUID-Finder.cfg"
+
+// Compiled DB, built from the text DB files merged over the stock DB
+#define COMPILED_DB_FILE "GUID-Finder.db"
+
+// DB type, a typed text DB file
+struct tDB_TYPE
+{
+	char szType[CompiledDB::TYPE_NAME_SIZE]; // Label prefix
+	char szFileName[64];	// Text DB file name
+	char szStruct[64];		// IDA struct name to apply
+};
+
+// The GUID DB in use.
+// The stock DB (built into the caller) is used in place when there are no
+// text DB files. Text DB files are merged over it into the compiled DB file,
+// which is used as is unless the text DB files or the stock DB changed since
+// it was compiled, then it's compiled again first.
+// The text DB files come from a type list, one "<type> <text file> [<struct>]"
+// per line, or the default types if there isn't one.
+class GUIDDB : public CompiledDB
+{
+public:
+	GUIDDB(const BYTE *pStock, UINT uStockSize, DWORD dwStockStamp);
+	~GUIDDB();
+
+	// Load the type list file, NULL or an empty list for the default types
+	void LoadTypeList(LPCSTR pszPath);
+	UINT GetTextTypeCount() const { return(m_uTypeCount); }
+	const tDB_TYPE &GetTextType(UINT uType) const { return(m_aType[uType]); }
+
+	// Struct name of a compiled DB type, types only in the stock DB use the type name
+	LPCSTR GetTypeStruct(UINT uType) const;
+
+	// Load the DB. "pszDBPath" is the compiled DB file, NULL or empty for the
+	// stock DB alone. "paszTextPath" has a path per text type, empty if it has
+	// none. "rbKept" is set if what's loaded from the last call is still current.
+	BOOL Load(LPCSTR pszDBPath, const char (*paszTextPath)[MAX_PATH], BOOL &rbKept);
+	void Free();
+
+private:
+	// Text DB GUID, for parsing the text DB
+	struct tTEXTENTRY
+	{
+		CompiledDB::tENTRY Entry;  // Label interned in m_TextArena
+		UINT uLine;				   // DB file line
+	};
+
+	// Text DB duplicate check set slot
+	struct tGUIDSLOT
+	{
+		UINT uHash;
+		UINT uEntry; // Text entry + 1, 0 if free
+	};
+
+	const BYTE *m_pStock;
+	UINT  m_uStockSize;
+	DWORD m_dwStockStamp;
+
+	tDB_TYPE m_aType[MAX_TYPES]; // Text DB types in use
+	UINT  m_uTypeCount;
+	tSOURCE m_DBStamp;		// Compiled DB file when loaded
+
+	Arena m_TextArena;		// Text entry labels
+	tTEXTENTRY *m_pText;	// Text DB GUIDs while compiling
+	UINT  m_uTextCount, m_uTextMax;
+	tGUIDSLOT *m_pGUIDSet;	// Text DB duplicate check, see GUIDSetAdd()
+	UINT  m_uGUIDSetMask, m_uGUIDSetCount;
+
+	BOOL AttachStock();
+	BOOL IsCurrent(const tSOURCE *pSources, UINT uTextCount);
+	BOOL Compile(LPCSTR pszDBPath, const char (*paszTextPath)[MAX_PATH], const tSOURCE *pSources);
+	BOOL LoadText(const char (*paszTextPath)[MAX_PATH]);
+	void FreeText();
+	BOOL GUIDSetReserve(UINT uCount);
+	BOOL GUIDSetAdd(UINT uEntry, UINT &ruExisting);
+	void GUIDSetFree();
+
+	// No copies
+	GUIDDB(const GUIDDB &);
+	void operator=(const GUIDDB &);
+};
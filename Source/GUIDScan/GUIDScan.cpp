@@ -0,0 +1,595 @@
+
+// ****************************************************************************
+// File: GUIDScan.cpp
+// Desc: Command line GUID scanner for "GUID-Finder".
+//       Scans PE files for the GUID DB without IDA, sections as the PE
+//       loader maps them, with the plug-in's options.
+//
+// ****************************************************************************
+#include "../StdAfx.h"
+#include "../GUIDDB.h"
+#include "../ScanEngine.h"
+#include "../CorpusPool.h"
+#include "../FileSource.h"
+#include "../PESource.h"
+#include "../ResultWriter.h"
+#include "../ScanCache.h"
+#include "StockDB.inl"
+#include <new>
+#ifndef _WIN32
+#include <dirent.h>
+#endif
+
+/*
+	Usage: GUIDScan [options] <file or dir> [<file or dir> ..]
+	  -d <dir>       GUID DB folder, what the plug-in's "plugins\GUID-Finder" folder
+	                 has: the type list, text DB files and compiled DB.
+	                 Default is the stock DB alone.
+	  -l <list>      Scan the files listed in a file too, one path per line,
+	                 "-" for stdin
+	  -x <stride>    Scan stride 1, 4 or 8, default 1 (every offset) like the
+	                 plug-in
+	  -t             Find text GUIDs too
+	  -r             Find RFC 4122 byte order GUIDs too
+	  -a             Scan every section, the plug-in's "skip code and import
+	                 segments" option off
+	  -j <threads>   Scan threads, default one per CPU
+	  -c <dir>       Cache each section's hits in a directory, keyed by its
+	                 bytes, the DB and the options. Sections seen before (the
+	                 same DLL again) aren't scanned again.
+	  -m <MB>        Cache size cap, default 256. Least recently used
+	                 sections go first.
+	  -o <file>      Write the hits to a file instead of stdout
+	  -f <format>    Hit output format:
+	                   text   The listing below, the default
+	                   jsonl  JSON Lines, an object per hit with "file",
+	                          "address" (RVA), "offset", "segment" (section),
+	                          "type", "guid", "form" and "label"
+	                   csv    The same fields as CSV, with a header row
+	                   bin    Fixed size records, see ResultWriter.h
+	  -v             Log each section
+
+	Directories are scanned with everything under them, for a corpus.
+	The DB is loaded and indexed once, then the files are mapped and scanned
+	a few at a time on every thread (see CorpusPool), big ones split up.
+
+	A hit per line on stdout, each file's hits together as it's done:
+	  <file> <file offset> <RVA> <section> <label>[ (<form>)]
+	Everything else goes to stderr. The hits are buffered and written out
+	in large blocks, not a line at a time.
+
+	Sections are scanned where the file has bytes for them, as IDA loads them.
+	Code sections and the import directory and IAT are skipped unless "-a",
+	like code and extern segments in the plug-in. Sections where GUIDs might
+	not be stride aligned are scanned at every offset, as the plug-in does.
+	Files that aren't PE files are scanned whole at every offset, with no RVA
+	or section.
+
+	Returns 0 if every file was scanned, 1 otherwise.
+*/
+
+// Scan settings
+static UINT s_uStride = 1;
+static UINT s_uFlags = 0;
+static BOOL s_bRFC4122 = FALSE;
+static BOOL s_bAllSections = FALSE;
+static BOOL s_bVerbose = FALSE;
+static ResultWriter s_Results;
+static ScanCache s_Cache;
+
+static GUIDDB s_DB(s_abStockDB, STOCKDB_SIZE, STOCKDB_STAMP);
+static ScanEngine s_Engine;
+
+// Range scanned, its hits go in the cache
+struct tSCANRANGE
+{
+	ea_t ea;
+	UINT uSize;
+	ScanCache::tKEY Key;
+};
+
+// Corpus file being scanned
+struct tSCANFILE
+{
+	FileSource File;
+	PESource PE;
+	BOOL bPE;
+	tSCANRANGE *pRanges; // Scanned, not from the cache
+	UINT uRangeCount, uRangeMax;
+	char szPath[1]; // Allocated to fit
+};
+
+
+// Path of a file in the DB folder if it's there
+static BOOL FindDBFile(LPCSTR pszDir, LPCSTR pszName, LPSTR pszPath)
+{
+	if(!pszDir)
+		return(FALSE);
+	qsnprintf(pszPath, MAX_PATH, "%s/%s", pszDir, pszName);
+	if(FILE *fp = qfopen(pszPath, "rb"))
+	{
+		qfclose(fp);
+		return(TRUE);
+	}
+	return(FALSE);
+}
+
+// Load the GUID DB from "pszDir", by the plug-in's rules (see LoadDB() in Core.cpp)
+static BOOL LoadDB(LPCSTR pszDir)
+{
+	char szPath[MAX_PATH];
+	s_DB.LoadTypeList(FindDBFile(pszDir, TYPE_LIST_FILE, szPath) ? szPath : NULL);
+
+	// Text DB files, each one is optional
+	char aszTextPath[CompiledDB::MAX_TYPES][MAX_PATH];
+	UINT uTextCount = 0;
+	for(UINT i = 0; i < s_DB.GetTextTypeCount(); i++)
+	{
+		if(FindDBFile(pszDir, s_DB.GetTextType(i).szFileName, aszTextPath[i]))
+			uTextCount++;
+		else
+			aszTextPath[i][0] = 0;
+	}
+
+	// Compiled DB goes with the text files
+	char szDBPath[MAX_PATH] = {0};
+	if(!FindDBFile(pszDir, COMPILED_DB_FILE, szDBPath))
+	{
+		szDBPath[0] = 0;
+		if(uTextCount)
+			qsnprintf(szDBPath, sizeof(szDBPath), "%s/%s", pszDir, COMPILED_DB_FILE);
+	}
+
+	BOOL bKept;
+	return(s_DB.Load(szDBPath, aszTextPath, bKept));
+}
+
+
+// Returns FALSE with a reason if GUIDs in this section might not be aligned to "uStride",
+// the plug-in's IsAlignmentReliable() for PE sections
+static BOOL IsAlignmentReliable(const tPESECTION &rSection, UINT uStride, LPCSTR &rpszReason)
+{
+	if(rSection.bCode)
+	{
+		rpszReason = "code section";
+		return(FALSE);
+	}
+	if((strcmp(rSection.szName, "CODE") == 0) || (strcmp(rSection.szName, "DATA") == 0) || (strcmp(rSection.szName, "BSS") == 0))
+	{
+		rpszReason = "Delphi/Borland section";
+		return(FALSE);
+	}
+	if(rSection.uRVA % uStride)
+	{
+		rpszReason = "section start not stride aligned";
+		return(FALSE);
+	}
+	return(TRUE);
+}
+
+// Queue a range to scan, or add its hits from the cache if it's there
+static void ScanRange(CorpusPool &rPool, tCORPUSFILE &rFile, tSCANFILE &rScan, const BYTE *pData, UINT uSize, ea_t ea, UINT uStride)
+{
+	if(s_Cache.IsOpen() && (uSize >= sizeof(GUID)))
+	{
+		ScanCache::tKEY tKey;
+		s_Cache.GetKey(pData, uSize, ea, uStride, s_uFlags, tKey);
+		tSCANHIT *pHits;
+		UINT uHitCount;
+		if(s_Cache.Lookup(tKey, ea, pHits, uHitCount))
+		{
+			rPool.AddHits(rFile, pHits, uHitCount);
+			if(pHits)
+				qfree(pHits);
+			return;
+		}
+
+		// Remember it to cache its hits when the file is done
+		if(rScan.uRangeCount >= rScan.uRangeMax)
+		{
+			UINT uMax = (rScan.uRangeMax ? (rScan.uRangeMax * 2) : 16);
+			if(tSCANRANGE *pNewRanges = (tSCANRANGE *) qrealloc(rScan.pRanges, (sizeof(tSCANRANGE) * uMax)))
+			{
+				rScan.pRanges = pNewRanges;
+				rScan.uRangeMax = uMax;
+			}
+		}
+		if(rScan.uRangeCount < rScan.uRangeMax)
+		{
+			tSCANRANGE &rRange = rScan.pRanges[rScan.uRangeCount++];
+			rRange.ea = ea;
+			rRange.uSize = uSize;
+			rRange.Key = tKey;
+		}
+	}
+	rPool.AddRange(rFile, pData, uSize, ea, uStride, s_uFlags);
+}
+
+// Cache the hits of a file's scanned ranges, "pHits" by address
+static void CacheHits(const tSCANFILE &rScan, const tSCANHIT *pHits, UINT uHitCount)
+{
+	for(UINT i = 0; i < rScan.uRangeCount; i++)
+	{
+		const tSCANRANGE &rRange = rScan.pRanges[i];
+		UINT uFirst = 0, uLast = uHitCount;
+		while(uFirst < uLast)
+		{
+			UINT uMiddle = ((uFirst + uLast) / 2);
+			if(pHits[uMiddle].ea < rRange.ea)
+				uFirst = (uMiddle + 1);
+			else
+				uLast = uMiddle;
+		};
+		UINT uEnd = uFirst;
+		while((uEnd < uHitCount) && ((pHits[uEnd].ea - rRange.ea) < rRange.uSize))
+			uEnd++;
+		s_Cache.Store(rRange.Key, rRange.ea, (pHits + uFirst), (uEnd - uFirst));
+	}
+}
+
+// Queue a section's bytes, less the import directory and IAT unless scanning everything
+static void AddSection(CorpusPool &rPool, tCORPUSFILE &rFile, tSCANFILE &rScan, const tPESECTION &rSection, UINT uStride)
+{
+	ea_t aSkip[2][2] = { { 0, 0 }, { 0, 0 } };
+	if(!s_bAllSections)
+	{
+		rScan.PE.GetImportRange(aSkip[0][0], aSkip[0][1]);
+		rScan.PE.GetIATRange(aSkip[1][0], aSkip[1][1]);
+	}
+
+	const BYTE *pSection = (rScan.File.GetImage() + rSection.uFileOffset);
+	ea_t ea = rSection.uRVA, endEA = (rSection.uRVA + rSection.uSize);
+	while(ea < endEA)
+	{
+		ea_t scanEndEA = endEA;
+		BOOL bSkipped = FALSE;
+		for(UINT i = 0; i < 2; i++)
+		{
+			if((ea >= aSkip[i][0]) && (ea < aSkip[i][1]))
+			{
+				ea = aSkip[i][1];
+				bSkipped = TRUE;
+			}
+			else
+			if((aSkip[i][0] > ea) && (aSkip[i][0] < scanEndEA))
+				scanEndEA = aSkip[i][0];
+		}
+		if(bSkipped)
+			continue;
+
+		ScanRange(rPool, rFile, rScan, (pSection + (ea - rSection.uRVA)), (scanEndEA - ea), ea, uStride);
+		ea = scanEndEA;
+	};
+}
+
+
+// Maps the corpus files and prints their hits
+class ScanClient : public CorpusClient
+{
+public:
+	ScanClient() : m_uFiles(0), m_uFailed(0), m_uHits(0) {}
+
+	// Map a file and queue its sections, or all of it if it's not a PE file
+	BOOL OpenFile(CorpusPool &rPool, tCORPUSFILE &rFile)
+	{
+		tSCANFILE &rScan = *((tSCANFILE *) rFile.pContext);
+		if(!rScan.File.Map(rScan.szPath))
+			return(FALSE);
+
+		rScan.bPE = rScan.PE.Attach(rScan.File.GetImage(), rScan.File.GetSize());
+		if(!rScan.bPE)
+		{
+			// Not a PE file, alignment is unknown
+			if(s_bVerbose)
+				msg("%s: not a PE file, scanning it whole\n", rScan.szPath);
+			ScanRange(rPool, rFile, rScan, rScan.File.GetImage(), rScan.File.GetSize(), rScan.File.GetStartEA(), 1);
+			return(TRUE);
+		}
+
+		for(UINT i = 0; i < rScan.PE.GetSectionCount(); i++)
+		{
+			const tPESECTION &rSection = rScan.PE.GetSection(i);
+			if(!rSection.uSize)
+				continue;
+			if(!s_bAllSections && (rSection.bCode || rSection.bImports))
+			{
+				if(s_bVerbose)
+					msg("%s: %-8s (%08X - %08X) SKIPPED\n", rScan.szPath, rSection.szName, rSection.uRVA, (rSection.uRVA + rSection.uSize));
+				continue;
+			}
+
+			UINT uStride = s_uStride;
+			LPCSTR pszReason = NULL;
+			if((uStride > 1) && !IsAlignmentReliable(rSection, uStride, pszReason))
+				uStride = 1;
+			if(s_bVerbose)
+				msg("%s: %-8s (%08X - %08X) %s%s%s\n", rScan.szPath, rSection.szName, rSection.uRVA, (rSection.uRVA + rSection.uSize), ((uStride == 1) ? "every offset" : ((uStride == 4) ? "4 aligned" : "8 aligned")), (pszReason ? ", " : ""), (pszReason ? pszReason : ""));
+			AddSection(rPool, rFile, rScan, rSection, uStride);
+		}
+		return(TRUE);
+	}
+
+	// Write a file's hits out
+	void FileDone(tCORPUSFILE &rFile, const tSCANHIT *pHits, UINT uHitCount)
+	{
+		tSCANFILE *pScan = (tSCANFILE *) rFile.pContext;
+		if(!rFile.bOpened)
+		{
+			msg("%s: error: Can't read file.\n", pScan->szPath);
+			m_uFailed++;
+		}
+		else
+		{
+			for(UINT i = 0; i < uHitCount; i++)
+			{
+				const tSCANHIT &rHit = pHits[i];
+				tRESULT tResult;
+				tResult.pszFile = pScan->szPath;
+				tResult.uEntry = rHit.uKey;
+				tResult.uForm = rHit.uForm;
+				if(pScan->bPE)
+				{
+					int iSection = pScan->PE.FindSection(rHit.ea);
+					tResult.ea = rHit.ea;
+					tResult.uOffset = pScan->PE.RVAToOffset(rHit.ea);
+					tResult.pszSegment = ((iSection >= 0) ? pScan->PE.GetSection(iSection).szName : NULL);
+				}
+				else
+				{
+					// Addressed by file offset
+					tResult.ea = BADADDR;
+					tResult.uOffset = rHit.ea;
+					tResult.pszSegment = NULL;
+				}
+				s_Results.Write(tResult);
+			}
+			m_uFiles++;
+			m_uHits += uHitCount;
+
+			// Not if some hits didn't make it
+			if(s_Cache.IsOpen() && !rFile.uDropped)
+				CacheHits(*pScan, pHits, uHitCount);
+		}
+
+		if(pScan->pRanges)
+			qfree(pScan->pRanges);
+		pScan->~tSCANFILE();
+		qfree(pScan);
+	}
+
+	UINT GetFileCount() const { return(m_uFiles); }
+	UINT GetFailedCount() const { return(m_uFailed); }
+	ULONGLONG GetHitCount() const { return(m_uHits); }
+
+private:
+	UINT m_uFiles, m_uFailed; // Only touched in FileDone(), one at a time
+	ULONGLONG m_uHits;
+};
+
+
+// Queue a file for the pool
+static BOOL QueueFile(CorpusPool &rPool, LPCSTR pszPath)
+{
+	size_t uLength = strlen(pszPath);
+	PVOID pMem = qalloc(sizeof(tSCANFILE) + uLength);
+	if(!pMem)
+	{
+		msg("error: Out of memory.\n");
+		return(FALSE);
+	}
+	tSCANFILE *pScan = new(pMem) tSCANFILE();
+	pScan->pRanges = NULL;
+	pScan->uRangeCount = pScan->uRangeMax = 0;
+	memcpy(pScan->szPath, pszPath, (uLength + 1));
+	if(!rPool.AddFile(pScan))
+	{
+		pScan->~tSCANFILE();
+		qfree(pMem);
+		return(FALSE);
+	}
+	return(TRUE);
+}
+
+// Queue a file, or every file under a directory
+static BOOL QueuePath(CorpusPool &rPool, LPCSTR pszPath)
+{
+	#ifdef _WIN32
+	DWORD dwAttributes = GetFileAttributes(pszPath);
+	if((dwAttributes == INVALID_FILE_ATTRIBUTES) || !(dwAttributes & FILE_ATTRIBUTE_DIRECTORY))
+		return(QueueFile(rPool, pszPath));
+
+	char szFind[MAX_PATH];
+	qsnprintf(szFind, sizeof(szFind), "%s\\*", pszPath);
+	WIN32_FIND_DATA tFind;
+	HANDLE hFind = FindFirstFile(szFind, &tFind);
+	if(hFind == INVALID_HANDLE_VALUE)
+		return(TRUE);
+	BOOL bResult = TRUE;
+	do
+	{
+		// Not following links, they can loop
+		if((strcmp(tFind.cFileName, ".") == 0) || (strcmp(tFind.cFileName, "..") == 0) || (tFind.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT))
+			continue;
+		char szPath[MAX_PATH];
+		qsnprintf(szPath, sizeof(szPath), "%s\\%s", pszPath, tFind.cFileName);
+		bResult = QueuePath(rPool, szPath);
+	}
+	while(bResult && FindNextFile(hFind, &tFind));
+	FindClose(hFind);
+	return(bResult);
+	#else
+	struct stat tStat;
+	if((stat(pszPath, &tStat) != 0) || !S_ISDIR(tStat.st_mode))
+		return(QueueFile(rPool, pszPath));
+
+	DIR *pDir = opendir(pszPath);
+	if(!pDir)
+	{
+		msg("%s: error: Can't open directory.\n", pszPath);
+		return(TRUE);
+	}
+	BOOL bResult = TRUE;
+	while(dirent *pEntry = readdir(pDir))
+	{
+		if((strcmp(pEntry->d_name, ".") == 0) || (strcmp(pEntry->d_name, "..") == 0))
+			continue;
+		char szPath[MAX_PATH];
+		qsnprintf(szPath, sizeof(szPath), "%s/%s", pszPath, pEntry->d_name);
+
+		// Not following links, they can loop
+		struct stat tLink;
+		if(lstat(szPath, &tLink) != 0)
+			continue;
+		if(S_ISDIR(tLink.st_mode))
+			bResult = QueuePath(rPool, szPath);
+		else
+		if(S_ISREG(tLink.st_mode))
+			bResult = QueueFile(rPool, szPath);
+		if(!bResult)
+			break;
+	};
+	closedir(pDir);
+	return(bResult);
+	#endif
+}
+
+// Queue the files in a list file, one per line
+static BOOL QueueList(CorpusPool &rPool, LPCSTR pszList)
+{
+	FILE *fp = ((strcmp(pszList, "-") == 0) ? stdin : qfopen(pszList, "rb"));
+	if(!fp)
+	{
+		msg("%s: error: Can't open list file.\n", pszList);
+		return(FALSE);
+	}
+
+	BOOL bResult = TRUE;
+	char szLine[MAX_PATH];
+	while(bResult && qfgets(szLine, sizeof(szLine), fp))
+	{
+		size_t uLength = strlen(szLine);
+		while(uLength && ((szLine[uLength - 1] == '\n') || (szLine[uLength - 1] == '\r')))
+			szLine[--uLength] = 0;
+		if(uLength)
+			bResult = QueuePath(rPool, szLine);
+	};
+	if(fp != stdin)
+		qfclose(fp);
+	return(bResult);
+}
+
+
+int main(int argc, char *argv[])
+{
+	LPCSTR pszDBDir = NULL, pszList = NULL, pszOutput = NULL, pszCacheDir = NULL;
+	UINT uCacheMB = (ScanCache::DEFAULT_MAX_SIZE / (1024 * 1024));
+	eRESULTFORMAT eFormat = RESULT_TEXT;
+	BOOL bFormat = TRUE;
+	UINT uThreads = 0;
+	int iFirstFile = argc;
+	for(int i = 1; i < argc; i++)
+	{
+		if(argv[i][0] != '-')
+		{
+			iFirstFile = i;
+			break;
+		}
+
+		if((strcmp(argv[i], "-d") == 0) && ((i + 1) < argc))
+			pszDBDir = argv[++i];
+		else
+		if((strcmp(argv[i], "-l") == 0) && ((i + 1) < argc))
+			pszList = argv[++i];
+		else
+		if((strcmp(argv[i], "-x") == 0) && ((i + 1) < argc))
+			s_uStride = strtoul(argv[++i], NULL, 10);
+		else
+		if(strcmp(argv[i], "-t") == 0)
+			s_uFlags |= SCAN_TEXT;
+		else
+		if(strcmp(argv[i], "-r") == 0)
+			s_bRFC4122 = TRUE;
+		else
+		if(strcmp(argv[i], "-a") == 0)
+			s_bAllSections = TRUE;
+		else
+		if((strcmp(argv[i], "-j") == 0) && ((i + 1) < argc))
+			uThreads = strtoul(argv[++i], NULL, 10);
+		else
+		if((strcmp(argv[i], "-c") == 0) && ((i + 1) < argc))
+			pszCacheDir = argv[++i];
+		else
+		if((strcmp(argv[i], "-m") == 0) && ((i + 1) < argc))
+			uCacheMB = strtoul(argv[++i], NULL, 10);
+		else
+		if((strcmp(argv[i], "-o") == 0) && ((i + 1) < argc))
+			pszOutput = argv[++i];
+		else
+		if((strcmp(argv[i], "-f") == 0) && ((i + 1) < argc))
+			bFormat = ResultWriter::GetFormat(argv[++i], eFormat);
+		else
+		if(strcmp(argv[i], "-v") == 0)
+			s_bVerbose = TRUE;
+		else
+		{
+			iFirstFile = argc + 1;
+			break;
+		}
+	}
+	if((iFirstFile > argc) || ((iFirstFile == argc) && !pszList) || ((s_uStride != 1) && (s_uStride != 4) && (s_uStride != 8)) || !bFormat || (uCacheMB < 1) || (uCacheMB > 4095))
+	{
+		fprintf(stderr, "Usage: GUIDScan [-d <DB dir>] [-l <list>] [-x <stride>] [-t] [-r] [-a] [-j <threads>] [-c <cache dir>] [-m <MB>] [-o <file>] [-f text|jsonl|csv|bin] [-v] <file or dir> [<file or dir> ..]\n");
+		return(1);
+	}
+
+	// Hits on stdout, the rest on stderr
+	ToolLog() = stderr;
+	TIMESTAMP StartTime = GetTimeStamp();
+	if(!LoadDB(pszDBDir) || !s_Engine.BuildIndex(s_DB, s_bRFC4122))
+	{
+		msg("error: Failed to load the GUID DB.\n");
+		return(1);
+	}
+	SetScanKernel(SCAN_AVX2);
+	if(pszCacheDir && !s_Cache.Open(pszCacheDir, s_Engine.GetVersion(), s_DB.GetCount(), (uCacheMB * 1024 * 1024)))
+	{
+		msg("%s: error: Can't open the cache.\n", pszCacheDir);
+		return(1);
+	}
+	if(!s_Results.Open(pszOutput, eFormat, s_DB))
+	{
+		msg("%s: error: Can't create the output file.\n", (pszOutput ? pszOutput : "stdout"));
+		return(1);
+	}
+
+	ScanClient Client;
+	CorpusPool Pool;
+	if(!Pool.Start(s_Engine, Client, uThreads))
+	{
+		msg("error: Failed to start scan threads.\n");
+		return(1);
+	}
+
+	BOOL bQueued = TRUE;
+	for(int i = iFirstFile; (i < argc) && bQueued; i++)
+		bQueued = QueuePath(Pool, argv[i]);
+	if(pszList && bQueued)
+		bQueued = QueueList(Pool, pszList);
+	Pool.Finish();
+	BOOL bWritten = s_Results.Close();
+	if(!bWritten)
+		msg("%s: error: Failed to write the hits.\n", (pszOutput ? pszOutput : "stdout"));
+
+	double fTime = (GetTimeStamp() - StartTime);
+	double fMB = ((double) Pool.GetBytesScanned() / (1024.0 * 1024.0));
+	msg("%u file(s), %llu GUIDs found, %.2f MB scanned in %.2f seconds (%.1f MB/s).\n", Client.GetFileCount(), Client.GetHitCount(), fMB, fTime, ((fTime > 0.0) ? (fMB / fTime) : 0.0));
+	if(s_Cache.IsOpen())
+	{
+		msg("%u of %u sections (%.2f MB) from the cache.\n", s_Cache.GetFoundCount(), s_Cache.GetLookupCount(), ((double) s_Cache.GetBytesFound() / (1024.0 * 1024.0)));
+		if(!s_Cache.Close())
+			msg("%s: error: Failed to write the cache.\n", pszCacheDir);
+	}
+	if(Client.GetFailedCount())
+		msg("%u file(s) couldn't be read.\n", Client.GetFailedCount());
+	return((Client.GetFailedCount() || !bQueued || !bWritten) ? 1 : 0);
+}
@@ -0,0 +1,267 @@
+
+// ****************************************************************************
+// File: GUIDText.cpp
+// Desc: Text DB line parser
+//
+// ****************************************************************************
+#include "StdAfx.h"
+#include "GUIDText.h"
+
+// Char classes
+#define CC_HEX   0x0F // Hex digit value mask
+#define CC_DIGIT 0x10 // Hex digit
+#define CC_SPACE 0x20 // Blank
+#define CC_IDENT 0x40 // C identifier char
+
+static const BYTE s_abClass[256] =
+{
+	   0,    0,    0,    0,    0,    0,    0,    0,    0, 0x20,    0,    0,    0, 0x20,    0,    0, // 00
+	   0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0, // 10
+	0x20,    0,    0,    0, 0x40,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0, // 20 ' ', '$'
+	0x50, 0x51, 0x52, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59,    0,    0,    0,    0,    0,    0, // 30 '0'-'9'
+	   0, 0x5A, 0x5B, 0x5C, 0x5D, 0x5E, 0x5F, 0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0x40, // 40 'A'-'O'
+	0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0x40,    0,    0,    0,    0, 0x40, // 50 'P'-'Z', '_'
+	   0, 0x5A, 0x5B, 0x5C, 0x5D, 0x5E, 0x5F, 0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0x40, // 60 'a'-'o'
+	0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0x40,    0,    0,    0,    0,    0, // 70 'p'-'z'
+};
+
+// Line cursor
+struct tCURSOR
+{
+	const BYTE *pbStart;
+	const BYTE *pb;
+	const BYTE *pbEnd;
+	tGUIDLINE  *pLine;
+};
+
+static inline BYTE CharClass(const tCURSOR &rCur)
+{
+	return((rCur.pb < rCur.pbEnd) ? s_abClass[*rCur.pb] : 0);
+}
+
+static inline BOOL IsChar(const tCURSOR &rCur, char c)
+{
+	return((rCur.pb < rCur.pbEnd) && (*rCur.pb == (BYTE) c));
+}
+
+static inline void SkipSpace(tCURSOR &rCur)
+{
+	while(CharClass(rCur) & CC_SPACE)
+		rCur.pb++;
+}
+
+static inline BOOL IsEnd(const tCURSOR &rCur)
+{
+	return((rCur.pb >= rCur.pbEnd) || (*rCur.pb == '#'));
+}
+
+static BOOL Error(tCURSOR &rCur, LPCSTR pszError)
+{
+	rCur.pLine->uColumn  = (UINT) ((rCur.pb - rCur.pbStart) + 1);
+	rCur.pLine->pszError = pszError;
+	return(FALSE);
+}
+
+// Expect char "c", skipping blanks before it
+static BOOL Expect(tCURSOR &rCur, char c, LPCSTR pszError)
+{
+	SkipSpace(rCur);
+	if(!IsChar(rCur, c))
+		return(Error(rCur, pszError));
+	rCur.pb++;
+	return(TRUE);
+}
+
+// Exactly "uDigits" hex digits
+static BOOL ParseHexFixed(tCURSOR &rCur, UINT uDigits, UINT &ruValue)
+{
+	UINT uValue = 0;
+	for(UINT i = 0; i < uDigits; i++, rCur.pb++)
+	{
+		BYTE bClass = CharClass(rCur);
+		if(!(bClass & CC_DIGIT))
+			return(Error(rCur, "Expected a hex digit"));
+		uValue = ((uValue << 4) | (bClass & CC_HEX));
+	}
+	ruValue = uValue;
+	return(TRUE);
+}
+
+// "0x" prefixed C hex number of at most "uDigits" digits, blanks before it skipped
+static BOOL ParseHexC(tCURSOR &rCur, UINT uDigits, UINT &ruValue)
+{
+	SkipSpace(rCur);
+	if(((rCur.pbEnd - rCur.pb) < 2) || (rCur.pb[0] != '0') || ((rCur.pb[1] | 0x20) != 'x'))
+		return(Error(rCur, "Expected a \"0x\" number"));
+	rCur.pb += 2;
+
+	UINT uValue = 0, uCount = 0;
+	for(BYTE bClass; (bClass = CharClass(rCur)) & CC_DIGIT;)
+	{
+		if(++uCount > uDigits)
+			return(Error(rCur, "Number too big"));
+		uValue = ((uValue << 4) | (bClass & CC_HEX));
+		rCur.pb++;
+	};
+	if(!uCount)
+		return(Error(rCur, "Expected a hex digit"));
+	ruValue = uValue;
+	return(TRUE);
+}
+
+// 01234567-89AB-CDEF-0123-456789ABCDEF
+static BOOL ParseRegistryForm(tCURSOR &rCur, GUID &rGUID)
+{
+	UINT uValue;
+	if(!ParseHexFixed(rCur, 8, uValue)) return(FALSE);
+	rGUID.Data1 = uValue;
+	if(!IsChar(rCur, '-')) return(Error(rCur, "Expected '-'"));
+	rCur.pb++;
+	if(!ParseHexFixed(rCur, 4, uValue)) return(FALSE);
+	rGUID.Data2 = (WORD) uValue;
+	if(!IsChar(rCur, '-')) return(Error(rCur, "Expected '-'"));
+	rCur.pb++;
+	if(!ParseHexFixed(rCur, 4, uValue)) return(FALSE);
+	rGUID.Data3 = (WORD) uValue;
+	if(!IsChar(rCur, '-')) return(Error(rCur, "Expected '-'"));
+	rCur.pb++;
+	for(UINT i = 0; i < 8; i++)
+	{
+		if(i == 2)
+		{
+			if(!IsChar(rCur, '-')) return(Error(rCur, "Expected '-'"));
+			rCur.pb++;
+		}
+		if(!ParseHexFixed(rCur, 2, uValue)) return(FALSE);
+		rGUID.Data4[i] = (BYTE) uValue;
+	}
+	return(TRUE);
+}
+
+// 0x01234567,0x89AB,0xCDEF,{0x01,0x23,0x45,0x67,0x89,0xAB,0xCD,0xEF}
+// The braces around the bytes are optional.
+static BOOL ParseStructForm(tCURSOR &rCur, GUID &rGUID)
+{
+	UINT uValue;
+	if(!ParseHexC(rCur, 8, uValue)) return(FALSE);
+	rGUID.Data1 = uValue;
+	if(!Expect(rCur, ',', "Expected ','")) return(FALSE);
+	if(!ParseHexC(rCur, 4, uValue)) return(FALSE);
+	rGUID.Data2 = (WORD) uValue;
+	if(!Expect(rCur, ',', "Expected ','")) return(FALSE);
+	if(!ParseHexC(rCur, 4, uValue)) return(FALSE);
+	rGUID.Data3 = (WORD) uValue;
+	if(!Expect(rCur, ',', "Expected ','")) return(FALSE);
+
+	SkipSpace(rCur);
+	BOOL bBrace = IsChar(rCur, '{');
+	if(bBrace)
+		rCur.pb++;
+	for(UINT i = 0; i < 8; i++)
+	{
+		if(i && !Expect(rCur, ',', "Expected ','")) return(FALSE);
+		if(!ParseHexC(rCur, 2, uValue)) return(FALSE);
+		rGUID.Data4[i] = (BYTE) uValue;
+	}
+	if(bBrace && !Expect(rCur, '}', "Expected '}'")) return(FALSE);
+	return(TRUE);
+}
+
+// Label after the GUID, up to the next blank
+static BOOL ParseLabel(tCURSOR &rCur)
+{
+	if(!(CharClass(rCur) & CC_SPACE))
+		return(Error(rCur, IsEnd(rCur) ? "Expected a label" : "Expected a blank after the GUID"));
+	SkipSpace(rCur);
+	if(IsEnd(rCur))
+		return(Error(rCur, "Expected a label"));
+	const BYTE *pbLabel = rCur.pb;
+	while((rCur.pb < rCur.pbEnd) && !(s_abClass[*rCur.pb] & CC_SPACE))
+		rCur.pb++;
+	rCur.pLine->pszLabel = (LPCSTR) pbLabel;
+	rCur.pLine->uLabelLength = (UINT) (rCur.pb - pbLabel);
+	return(TRUE);
+}
+
+static BOOL ParseDefineGUID(tCURSOR &rCur, GUID &rGUID)
+{
+	if(!Expect(rCur, '(', "Expected '('")) return(FALSE);
+
+	SkipSpace(rCur);
+	const BYTE *pbLabel = rCur.pb;
+	while(CharClass(rCur) & CC_IDENT)
+		rCur.pb++;
+	if(rCur.pb == pbLabel)
+		return(Error(rCur, "Expected a label"));
+	rCur.pLine->pszLabel = (LPCSTR) pbLabel;
+	rCur.pLine->uLabelLength = (UINT) (rCur.pb - pbLabel);
+
+	if(!Expect(rCur, ',', "Expected ','")) return(FALSE);
+	if(!ParseStructForm(rCur, rGUID)) return(FALSE);
+	if(!Expect(rCur, ')', "Expected ')'")) return(FALSE);
+	SkipSpace(rCur);
+	if(IsChar(rCur, ';'))
+		rCur.pb++;
+	return(TRUE);
+}
+
+
+// Parse a text DB line
+int ParseGUIDLine(LPCSTR pszLine, UINT uLength, tGUIDLINE &rLine)
+{
+	tCURSOR tCur = { (const BYTE *) pszLine, (const BYTE *) pszLine, ((const BYTE *) pszLine + uLength), &rLine };
+	rLine.pszLabel = NULL;
+	rLine.uLabelLength = 0;
+	rLine.uColumn = 0;
+	rLine.pszError = NULL;
+
+	SkipSpace(tCur);
+	if(IsEnd(tCur))
+		return(GUIDLINE_BLANK);
+
+	static const char szDefine[] = "DEFINE_GUID";
+	const UINT uDefine = (sizeof(szDefine) - 1);
+	if(((UINT) (tCur.pbEnd - tCur.pb) > uDefine) && (memcmp(tCur.pb, szDefine, uDefine) == 0) && !(s_abClass[tCur.pb[uDefine]] & CC_IDENT))
+	{
+		tCur.pb += uDefine;
+		if(!ParseDefineGUID(tCur, rLine.Guid))
+			return(GUIDLINE_ERROR);
+	}
+	else
+	{
+		BOOL bBrace = IsChar(tCur, '{');
+		if(bBrace)
+			tCur.pb++;
+		SkipSpace(tCur);
+
+		if(((tCur.pbEnd - tCur.pb) >= 2) && (tCur.pb[0] == '0') && ((tCur.pb[1] | 0x20) == 'x'))
+		{
+			if(!ParseStructForm(tCur, rLine.Guid))
+				return(GUIDLINE_ERROR);
+		}
+		else
+		if(!ParseRegistryForm(tCur, rLine.Guid))
+			return(GUIDLINE_ERROR);
+
+		if(bBrace && !Expect(tCur, '}', "Expected '}'"))
+			return(GUIDLINE_ERROR);
+
+		// Trailing struct initializer punctuation
+		while(IsChar(tCur, ';') || IsChar(tCur, ','))
+			tCur.pb++;
+
+		if(!ParseLabel(tCur))
+			return(GUIDLINE_ERROR);
+	}
+
+	// Whatever follows, comments or more columns, is ignored like the "%s %s" loader did
+	return(GUIDLINE_OK);
+}
+
+// Format a GUID in registry form
+LPSTR GUIDToString(const GUID &rGUID, LPSTR pszBuffer)
+{
+	qsnprintf(pszBuffer, GUID_TEXT_SIZE, "%08X-%04X-%04X-%02X%02X-%02X%02X%02X%02X%02X%02X", rGUID.Data1, rGUID.Data2, rGUID.Data3, 
+			  rGUID.Data4[0], rGUID.Data4[1], rGUID.Data4[2], rGUID.Data4[3], rGUID.Data4[4], rGUID.Data4[5], rGUID.Data4[6], rGUID.Data4[7]);
+	return(pszBuffer);
+}
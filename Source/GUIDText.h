@@ -0,0 +1,39 @@
+
+// ****************************************************************************
+// File: GUIDText.h
+// Desc: Text DB line parser
+//
+// ****************************************************************************
+#pragma once
+
+#define GUID_TEXT_SIZE 37 // Registry form text with terminator
+
+// Parsed text DB line
+struct tGUIDLINE
+{
+	GUID   Guid;
+	LPCSTR pszLabel;	 // In the line, not terminated
+	UINT   uLabelLength;
+	UINT   uColumn;		 // Error column, 1 based
+	LPCSTR pszError;	 // Error description
+};
+
+enum
+{
+	GUIDLINE_BLANK,	// Blank or comment line
+	GUIDLINE_OK,
+	GUIDLINE_ERROR	// See "uColumn" and "pszError"
+};
+
+// Parse a text DB line of "uLength" chars (line end excluded) straight to a
+// binary GUID and label. Accepted forms, with the label after the GUID:
+//  01234567-89AB-CDEF-0123-456789ABCDEF Label
+//  {01234567-89AB-CDEF-0123-456789ABCDEF} Label
+//  {0x01234567,0x89AB,0xCDEF,{0x01,0x23,0x45,0x67,0x89,0xAB,0xCD,0xEF}}; Label
+//  DEFINE_GUID(Label, 0x01234567,0x89AB,0xCDEF,0x01,0x23,0x45,0x67,0x89,0xAB,0xCD,0xEF);
+// '#' starts a comment, and anything after the label is ignored.
+// Table driven, nothing locale dependent.
+int ParseGUIDLine(LPCSTR pszLine, UINT uLength, tGUIDLINE &rLine);
+
+// Format a GUID in registry form, "pszBuffer" is GUID_TEXT_SIZE chars
+LPSTR GUIDToString(const GUID &rGUID, LPSTR pszBuffer);
@@ -15,6 +15,7 @@ void IDAP_run(int arg);
 extern void CORE_Init();
 extern void CORE_Process(int iArg);
 extern void CORE_Exit();
+extern BOOL CORE_KeepLoaded();
 
 
 // === Data ===
@@ -27,7 +28,7 @@ char IDAP_hotkey[] 	= "Alt-5"; // Preferred/default hotkey
 extern "C" ALIGN(32) plugin_t PLUGIN =
 {
 	IDP_INTERFACE_VERSION,	// IDA version plug-in is written for
-	PLUGIN_UNL,				// Plug-in flags
+	0,						// Plug-in flags, PLUGIN_UNL set by IDAP_run() unless the GUID DB is kept loaded
 	IDAP_init,	            // Initialization function
 	IDAP_term,	            // Clean-up function
 	IDAP_run,	            // Main plug-in body
@@ -54,6 +55,12 @@ void IDAP_term()
 void IDAP_run(int iArg)
 {	
     CORE_Process(iArg);   
+
+    // Unload after the run, unless the GUID DB is kept for the next one
+    if(CORE_KeepLoaded())
+        PLUGIN.flags &= ~PLUGIN_UNL;
+    else
+        PLUGIN.flags |= PLUGIN_UNL;
 }
 
 
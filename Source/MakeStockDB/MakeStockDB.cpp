@@ -0,0 +1,265 @@
+
+// ****************************************************************************
+// File: MakeStockDB.cpp
+// Desc: Build step for "GUID-Finder" IDA Pro plug-in.
+//       Compiles the shipped text GUID DB files into a source file that
+//       builds the stock DB into the plug-in.
+//
+// ****************************************************************************
+#include "../StdAfx.h"
+#include "../CompiledDB.h"
+#include "../GUIDText.h"
+#include "../Arena.h"
+
+/*
+	Usage: MakeStockDB <output.inl> <type> <text file> [<type> <text file> ..]
+	e.g.:  MakeStockDB StockDB.inl IID Interfaces.txt CLSID Classes.txt LIBID Libraries.txt
+
+	Writes a compiled DB image (see CompiledDB.h) as a byte array, with a stamp
+	of it the plug-in uses to tell when a merged ".db" was built with another
+	stock DB. The output is only rewritten when it changes.
+*/
+
+// Text DB entry with where it came from
+struct tSTOCKENTRY
+{
+	CompiledDB::tENTRY Entry;
+	UINT uFile;
+	UINT uLine;
+};
+
+static Arena s_Labels;
+static tSTOCKENTRY *s_pEntries = NULL;
+static UINT s_uCount = 0, s_uMax = 0;
+
+
+// By GUID, then by file position so the first one of duplicates sorts first
+static int __cdecl CompareStockEntry(const void *pA, const void *pB)
+{
+	const tSTOCKENTRY *pEntryA = (const tSTOCKENTRY *) pA;
+	const tSTOCKENTRY *pEntryB = (const tSTOCKENTRY *) pB;
+	int iResult = memcmp(&pEntryA->Entry.Guid, &pEntryB->Entry.Guid, sizeof(GUID));
+	if(!iResult)
+		iResult = ((pEntryA->uFile != pEntryB->uFile) ? ((pEntryA->uFile < pEntryB->uFile) ? -1 : 1) : ((pEntryA->uLine < pEntryB->uLine) ? -1 : (pEntryA->uLine > pEntryB->uLine)));
+	return(iResult);
+}
+
+// FNV-1a hash of the image
+static DWORD StampImage(const BYTE *pImage, UINT uSize)
+{
+	DWORD dwHash = 0x811C9DC5;
+	for(UINT i = 0; i < uSize; i++)
+		dwHash = ((dwHash ^ pImage[i]) * 0x01000193);
+	return(dwHash ? dwHash : 1);
+}
+
+
+// Load a text DB file, same rules as the plug-in's text DB loader
+static BOOL LoadText(UINT uFile, LPCSTR pszType, LPCSTR pszPath)
+{
+	FILE *fp = qfopen(pszPath, "rb");
+	if(!fp)
+	{
+		printf("%s: error: Can't open file.\n", pszPath);
+		return(FALSE);
+	}
+	UINT uSize = qfsize(fp);
+	LPSTR pszText = (LPSTR) qalloc(uSize + 1);
+	BOOL bRead = (pszText && ((UINT) qfread(fp, pszText, uSize) == uSize));
+	qfclose(fp);
+	if(!bRead)
+	{
+		printf("%s: error: Can't read file.\n", pszPath);
+		if(pszText) qfree(pszText);
+		return(FALSE);
+	}
+
+	UINT uTypeLength = strlen(pszType);
+	UINT uLine = 0;
+	LPCSTR pszEnd = (pszText + uSize);
+	for(LPCSTR pszLine = pszText; pszLine < pszEnd;)
+	{
+		++uLine;
+		LPCSTR pszNext = (LPCSTR) memchr(pszLine, '\n', (pszEnd - pszLine));
+		if(!pszNext)
+			pszNext = pszEnd;
+		tGUIDLINE tLine;
+		int iResult = ParseGUIDLine(pszLine, (UINT) (pszNext - pszLine), tLine);
+		pszLine = (pszNext + 1);
+
+		if(iResult == GUIDLINE_BLANK)
+			continue;
+		if(iResult == GUIDLINE_ERROR)
+		{
+			printf("%s(%u,%u): warning: %s, line skipped.\n", pszPath, uLine, tLine.uColumn, tLine.pszError);
+			continue;
+		}
+
+		// Type prefixed label
+		if((tLine.uLabelLength > uTypeLength) && (tLine.pszLabel[uTypeLength] == '_') && (memcmp(tLine.pszLabel, pszType, uTypeLength) == 0))
+		{
+			tLine.pszLabel += (uTypeLength + 1);
+			tLine.uLabelLength -= (uTypeLength + 1);
+		}
+		UINT uLabelLength = (uTypeLength + 1 + tLine.uLabelLength);
+		if(uLabelLength >= (MAXNAMELEN - 4))
+		{
+			printf("%s(%u): warning: Label too long for an IDA name, line skipped.\n", pszPath, uLine);
+			continue;
+		}
+		char szLabel[MAXNAMELEN];
+		memcpy(szLabel, pszType, uTypeLength);
+		szLabel[uTypeLength] = '_';
+		memcpy(&szLabel[uTypeLength + 1], tLine.pszLabel, tLine.uLabelLength);
+		szLabel[uLabelLength] = 0;
+
+		if(s_uCount >= s_uMax)
+		{
+			UINT uMax = (s_uMax ? (s_uMax * 2) : 4096);
+			tSTOCKENTRY *pEntries = (tSTOCKENTRY *) qrealloc(s_pEntries, (sizeof(tSTOCKENTRY) * uMax));
+			if(!pEntries)
+			{
+				printf("error: Out of memory.\n");
+				qfree(pszText);
+				return(FALSE);
+			}
+			s_pEntries = pEntries;
+			s_uMax = uMax;
+		}
+		tSTOCKENTRY &rEntry = s_pEntries[s_uCount];
+		rEntry.Entry.Guid  = tLine.Guid;
+		rEntry.Entry.uType = uFile;
+		if(!(rEntry.Entry.pszLabel = s_Labels.Intern(szLabel, uLabelLength)))
+		{
+			printf("error: Out of memory.\n");
+			qfree(pszText);
+			return(FALSE);
+		}
+		rEntry.uFile = uFile;
+		rEntry.uLine = uLine;
+		s_uCount++;
+	}
+
+	qfree(pszText);
+	return(TRUE);
+}
+
+
+// Write the image as source, if it's not the same already
+static BOOL WriteSource(LPCSTR pszPath, const BYTE *pImage, UINT uSize, UINT uCount)
+{
+	// Build it in memory, about 6 chars per byte
+	UINT uMax = ((uSize * 6) + 4096);
+	LPSTR pszSource = (LPSTR) qalloc(uMax);
+	if(!pszSource)
+		return(FALSE);
+
+	UINT uLength = qsnprintf(pszSource, uMax,
+		"\r\n"
+		"// ****************************************************************************\r\n"
+		"// File: StockDB.inl\r\n"
+		"// Desc: Stock GUID DB, %u GUIDs. Generated by MakeStockDB, don't edit.\r\n"
+		"//\r\n"
+		"// ****************************************************************************\r\n"
+		"\r\n"
+		"#define STOCKDB_STAMP 0x%08X\r\n"
+		"#define STOCKDB_SIZE  %u\r\n"
+		"\r\n"
+		"static const ALIGN(16) BYTE s_abStockDB[STOCKDB_SIZE] =\r\n"
+		"{\r\n", uCount, StampImage(pImage, uSize), uSize);
+	for(UINT i = 0; i < uSize; i++)
+	{
+		if(!(i & 15))
+			uLength += qsnprintf((pszSource + uLength), (uMax - uLength), "\t");
+		uLength += qsnprintf((pszSource + uLength), (uMax - uLength), "0x%02X,%s", pImage[i], (((i & 15) == 15) || (i == (uSize - 1))) ? "\r\n" : "");
+	}
+	uLength += qsnprintf((pszSource + uLength), (uMax - uLength), "};\r\n");
+
+	// Same as the last one?
+	BOOL bSame = FALSE;
+	if(FILE *fp = qfopen(pszPath, "rb"))
+	{
+		if(qfsize(fp) == uLength)
+		{
+			if(LPSTR pszOld = (LPSTR) qalloc(uLength))
+			{
+				bSame = (((UINT) qfread(fp, pszOld, uLength) == uLength) && (memcmp(pszOld, pszSource, uLength) == 0));
+				qfree(pszOld);
+			}
+		}
+		qfclose(fp);
+	}
+
+	BOOL bResult = TRUE;
+	if(!bSame)
+	{
+		bResult = FALSE;
+		if(FILE *fp = qfopen(pszPath, "wb"))
+		{
+			bResult = ((UINT) qfwrite(fp, pszSource, uLength) == uLength);
+			qfclose(fp);
+		}
+	}
+	qfree(pszSource);
+
+	printf("%s: %u GUIDs, %u bytes, %s.\n", pszPath, uCount, uSize, (bSame ? "unchanged" : "written"));
+	return(bResult);
+}
+
+
+int main(int argc, char *argv[])
+{
+	if((argc < 4) || (argc & 1) || (((argc - 2) / 2) > CompiledDB::MAX_TYPES))
+	{
+		printf("Usage: MakeStockDB <output.inl> <type> <text file> [<type> <text file> ..]\n");
+		return(1);
+	}
+
+	CompiledDB::tHEADER tInfo;
+	ZeroMemory(&tInfo, sizeof(tInfo));
+	for(int i = 2; i < argc; i += 2)
+	{
+		UINT uFile = ((i - 2) / 2);
+		if(strlen(argv[i]) >= CompiledDB::TYPE_NAME_SIZE)
+		{
+			printf("error: Type name \"%s\" too long.\n", argv[i]);
+			return(1);
+		}
+		qstrncpy(tInfo.aszType[uFile], argv[i], CompiledDB::TYPE_NAME_SIZE);
+		tInfo.uTypeCount++;
+		if(!LoadText(uFile, argv[i], argv[i + 1]))
+			return(1);
+	}
+
+	// Drop duplicates, the first one is kept
+	qsort(s_pEntries, s_uCount, sizeof(tSTOCKENTRY), CompareStockEntry);
+	CompiledDB::tENTRY *pEntries = (CompiledDB::tENTRY *) qalloc(sizeof(CompiledDB::tENTRY) * (s_uCount ? s_uCount : 1));
+	if(!pEntries)
+	{
+		printf("error: Out of memory.\n");
+		return(1);
+	}
+	UINT uCount = 0;
+	for(UINT i = 0; i < s_uCount; i++)
+	{
+		if(uCount && (memcmp(&s_pEntries[i].Entry.Guid, &pEntries[uCount - 1].Guid, sizeof(GUID)) == 0))
+		{
+			printf("%s(%u): warning: Duplicate GUID \"%s\", skipped.\n", argv[3 + (s_pEntries[i].uFile * 2)], s_pEntries[i].uLine, s_pEntries[i].Entry.pszLabel);
+			continue;
+		}
+		pEntries[uCount++] = s_pEntries[i].Entry;
+	}
+
+	UINT uSize;
+	PBYTE pImage = CompiledDB::Build(pEntries, uCount, tInfo, uSize);
+	if(!pImage || !WriteSource(argv[1], pImage, uSize, uCount))
+	{
+		printf("%s: error: Failed to write the stock DB.\n", argv[1]);
+		return(1);
+	}
+
+	qfree(pImage);
+	qfree(pEntries);
+	qfree(s_pEntries);
+	return(0);
+}
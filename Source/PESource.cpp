@@ -0,0 +1,214 @@
+
+// ****************************************************************************
+// File: PESource.cpp
+// Desc: PE file byte source
+//
+// ****************************************************************************
+#include "StdAfx.h"
+#include "PESource.h"
+
+// PE header fields, from winnt.h
+#define PE_DOS_MAGIC      0x5A4D     // "MZ"
+#define PE_NT_MAGIC       0x00004550 // "PE\0\0"
+#define PE_OPT32_MAGIC    0x10B
+#define PE_OPT64_MAGIC    0x20B
+#define PE_SECTION_SIZE   40
+#define PE_SCN_CNT_CODE   0x00000020
+#define PE_SCN_MEM_EXEC   0x20000000
+#define PE_DIR_IMPORT     1
+#define PE_DIR_IAT        12
+
+// Header fields are read with bounds checks, samples are often malformed
+static inline BOOL GetWord(const BYTE *pImage, UINT uSize, UINT uOffset, UINT &ruValue)
+{
+	if((uOffset > uSize) || ((uSize - uOffset) < sizeof(WORD)))
+		return(FALSE);
+	ruValue = (pImage[uOffset] | (pImage[uOffset + 1] << 8));
+	return(TRUE);
+}
+
+static inline BOOL GetDword(const BYTE *pImage, UINT uSize, UINT uOffset, UINT &ruValue)
+{
+	if((uOffset > uSize) || ((uSize - uOffset) < sizeof(DWORD)))
+		return(FALSE);
+	ruValue = (pImage[uOffset] | (pImage[uOffset + 1] << 8) | (pImage[uOffset + 2] << 16) | ((UINT) pImage[uOffset + 3] << 24));
+	return(TRUE);
+}
+
+static int __cdecl CompareSection(const void *pA, const void *pB)
+{
+	const tPESECTION *pSectionA = (const tPESECTION *) pA, *pSectionB = (const tPESECTION *) pB;
+	return((pSectionA->uRVA < pSectionB->uRVA) ? -1 : (pSectionA->uRVA > pSectionB->uRVA));
+}
+
+
+PESource::PESource()
+{
+	Close();
+}
+
+void PESource::Close()
+{
+	m_pImage = NULL;
+	m_uSize  = 0;
+	m_bIs64  = FALSE;
+	m_uSectionCount = 0;
+	m_importRVA = m_importEndRVA = 0;
+	m_iatRVA = m_iatEndRVA = 0;
+}
+
+
+// Parse a file image's PE headers
+BOOL PESource::Attach(const BYTE *pImage, UINT uSize)
+{
+	Close();
+
+	UINT uMagic, uNTOffset, uSignature;
+	if(!GetWord(pImage, uSize, 0, uMagic) || (uMagic != PE_DOS_MAGIC))
+		return(FALSE);
+	if(!GetDword(pImage, uSize, 0x3C, uNTOffset) || !GetDword(pImage, uSize, uNTOffset, uSignature) || (uSignature != PE_NT_MAGIC))
+		return(FALSE);
+
+	// File header
+	UINT uFileHeader = (uNTOffset + 4);
+	UINT uSections, uOptionalSize;
+	if(!GetWord(pImage, uSize, (uFileHeader + 2), uSections) || !GetWord(pImage, uSize, (uFileHeader + 16), uOptionalSize))
+		return(FALSE);
+
+	// Optional header, for the file alignment and the import data directories
+	UINT uOptional = (uFileHeader + 20);
+	UINT uOptMagic, uFileAlign = 0, uDirCount = 0, uDirOffset = 0;
+	if(!GetWord(pImage, uSize, uOptional, uOptMagic))
+		return(FALSE);
+	if(uOptMagic == PE_OPT32_MAGIC)
+		uDirOffset = (uOptional + 96);
+	else
+	if(uOptMagic == PE_OPT64_MAGIC)
+	{
+		m_bIs64 = TRUE;
+		uDirOffset = (uOptional + 112);
+	}
+	else
+		return(FALSE);
+	GetDword(pImage, uSize, (uOptional + 36), uFileAlign);
+	GetDword(pImage, uSize, (uDirOffset - 4), uDirCount);
+
+	UINT uDirRVA, uDirSize;
+	if((uDirCount > PE_DIR_IMPORT) && ((uDirOffset + (PE_DIR_IMPORT * 8) + 8) <= (uOptional + uOptionalSize)) &&
+		GetDword(pImage, uSize, (uDirOffset + (PE_DIR_IMPORT * 8)), uDirRVA) && GetDword(pImage, uSize, (uDirOffset + (PE_DIR_IMPORT * 8) + 4), uDirSize) && uDirRVA && uDirSize)
+	{
+		m_importRVA = uDirRVA;
+		m_importEndRVA = (((uDirRVA + uDirSize) < uDirRVA) ? BADADDR : (uDirRVA + uDirSize));
+	}
+	if((uDirCount > PE_DIR_IAT) && ((uDirOffset + (PE_DIR_IAT * 8) + 8) <= (uOptional + uOptionalSize)) &&
+		GetDword(pImage, uSize, (uDirOffset + (PE_DIR_IAT * 8)), uDirRVA) && GetDword(pImage, uSize, (uDirOffset + (PE_DIR_IAT * 8) + 4), uDirSize) && uDirRVA && uDirSize)
+	{
+		m_iatRVA = uDirRVA;
+		m_iatEndRVA = (((uDirRVA + uDirSize) < uDirRVA) ? BADADDR : (uDirRVA + uDirSize));
+	}
+
+	// Section table
+	UINT uTable = (uOptional + uOptionalSize);
+	for(UINT i = 0; (i < uSections) && (m_uSectionCount < MAX_SECTIONS); i++)
+	{
+		UINT uEntry = (uTable + (i * PE_SECTION_SIZE));
+		UINT uVirtualSize, uRVA, uRawSize, uRawOffset, uCharacteristics;
+		if(!GetDword(pImage, uSize, (uEntry + 8), uVirtualSize) || !GetDword(pImage, uSize, (uEntry + 12), uRVA) ||
+		   !GetDword(pImage, uSize, (uEntry + 16), uRawSize) || !GetDword(pImage, uSize, (uEntry + 20), uRawOffset) ||
+		   !GetDword(pImage, uSize, (uEntry + 36), uCharacteristics))
+			break;
+
+		// The loader rounds the raw offset down to a sector when the file alignment allows
+		if(uFileAlign >= 0x200)
+			uRawOffset &= ~0x1FF;
+
+		// Bytes with values: the raw data, not past the virtual size or the file end
+		UINT uLoaded = uRawSize;
+		if(uVirtualSize && (uVirtualSize < uLoaded))
+			uLoaded = uVirtualSize;
+		if(uRawOffset >= uSize)
+			uLoaded = 0;
+		else
+		if(uLoaded > (uSize - uRawOffset))
+			uLoaded = (uSize - uRawOffset);
+		if((uRVA + uLoaded) < uRVA)
+			uLoaded = (BADADDR - uRVA);
+
+		tPESECTION &rSection = m_aSection[m_uSectionCount++];
+		for(UINT j = 0; j < 8; j++)
+		{
+			char c = (char) pImage[uEntry + j];
+			rSection.szName[j] = (((c >= ' ') && (c < 0x7F)) || !c) ? c : '?';
+		}
+		rSection.szName[8] = 0;
+		rSection.uRVA = uRVA;
+		rSection.uSize = uLoaded;
+		rSection.uFileOffset = uRawOffset;
+		rSection.dwCharacteristics = uCharacteristics;
+		rSection.bCode = ((uCharacteristics & (PE_SCN_CNT_CODE | PE_SCN_MEM_EXEC)) != 0);
+		rSection.bImports = (strcmp(rSection.szName, ".idata") == 0);
+	}
+	qsort(m_aSection, m_uSectionCount, sizeof(tPESECTION), CompareSection);
+
+	m_pImage = pImage;
+	m_uSize  = uSize;
+	return(TRUE);
+}
+
+
+// Section holding an RVA, the first one if overlapping
+int PESource::FindSection(ea_t rva) const
+{
+	for(UINT i = 0; i < m_uSectionCount; i++)
+	{
+		const tPESECTION &rSection = m_aSection[i];
+		if((rva >= rSection.uRVA) && ((rva - rSection.uRVA) < rSection.uSize))
+			return((int) i);
+	}
+	return(-1);
+}
+
+// File offset of an RVA with a value
+UINT PESource::RVAToOffset(ea_t rva) const
+{
+	int iSection = FindSection(rva);
+	if(iSection < 0)
+		return(BADADDR);
+	return(m_aSection[iSection].uFileOffset + (rva - m_aSection[iSection].uRVA));
+}
+
+
+// First RVA in [ea, endEA) in a section's file bytes
+ea_t PESource::NextLoaded(ea_t ea, ea_t endEA)
+{
+	ea_t nextEA = BADADDR;
+	for(UINT i = 0; i < m_uSectionCount; i++)
+	{
+		const tPESECTION &rSection = m_aSection[i];
+		if(!rSection.uSize || ((rSection.uRVA + rSection.uSize) <= ea))
+			continue;
+		ea_t startEA = ((rSection.uRVA > ea) ? rSection.uRVA : ea);
+		if(startEA < nextEA)
+			nextEA = startEA;
+	}
+	return((nextEA < endEA) ? nextEA : BADADDR);
+}
+
+// Sections are separate runs, even when back to back
+ea_t PESource::RunEnd(ea_t ea, ea_t endEA)
+{
+	int iSection = FindSection(ea);
+	if(iSection < 0)
+		return(ea);
+	ea_t runEndEA = (m_aSection[iSection].uRVA + m_aSection[iSection].uSize);
+	return((runEndEA < endEA) ? runEndEA : endEA);
+}
+
+BOOL PESource::Read(ea_t ea, PBYTE pBuffer, UINT uSize)
+{
+	int iSection = FindSection(ea);
+	if((iSection < 0) || (uSize > (m_aSection[iSection].uSize - (ea - m_aSection[iSection].uRVA))))
+		return(FALSE);
+	memcpy(pBuffer, (m_pImage + m_aSection[iSection].uFileOffset + (ea - m_aSection[iSection].uRVA)), uSize);
+	return(TRUE);
+}
@@ -0,0 +1,71 @@
+
+// ****************************************************************************
+// File: PESource.h
+// Desc: PE file byte source
+//
+// ****************************************************************************
+#pragma once
+#include "ByteSource.h"
+
+// PE section as loaded
+struct tPESECTION
+{
+	char  szName[9];
+	UINT  uRVA;
+	UINT  uSize;		// Bytes with values from the file: raw size, limited to the virtual size and the file
+	UINT  uFileOffset;
+	DWORD dwCharacteristics;
+	BOOL  bCode;		// Code or executable, what IDA makes a code segment
+	BOOL  bImports;		// ".idata", what IDA makes an extern segment
+};
+
+// Byte source over a PE file image, addressed by RVA the way the loader maps it.
+// Only section bytes that come from the file have values: the headers, the
+// uninitialized tail of sections and the overlay aren't scanned, like in an IDB.
+// The image is the caller's and has to stay valid while attached.
+class PESource : public ByteSource
+{
+public:
+	enum
+	{
+		MAX_SECTIONS = 96
+	};
+
+	PESource();
+
+	// Parse a file image's PE headers; FALSE if it's not a PE file
+	BOOL Attach(const BYTE *pImage, UINT uSize);
+	void Close();
+
+	BOOL Is64() const { return(m_bIs64); }
+	UINT GetSectionCount() const { return(m_uSectionCount); }
+	const tPESECTION &GetSection(UINT uSection) const { return(m_aSection[uSection]); }
+
+	// Section holding an RVA, -1 if none does
+	int FindSection(ea_t rva) const;
+
+	// File offset of an RVA with a value, BADADDR if it has none
+	UINT RVAToOffset(ea_t rva) const;
+
+	// Import directory and IAT RVA ranges, the rest of what IDA puts in the
+	// extern segment when they share a section with data. Empty if absent.
+	void GetImportRange(ea_t &rStartRVA, ea_t &rEndRVA) const { rStartRVA = m_importRVA; rEndRVA = m_importEndRVA; }
+	void GetIATRange(ea_t &rStartRVA, ea_t &rEndRVA) const { rStartRVA = m_iatRVA; rEndRVA = m_iatEndRVA; }
+
+	ea_t NextLoaded(ea_t ea, ea_t endEA);
+	ea_t RunEnd(ea_t ea, ea_t endEA);
+	BOOL Read(ea_t ea, PBYTE pBuffer, UINT uSize);
+
+private:
+	const BYTE *m_pImage;
+	UINT m_uSize;
+	BOOL m_bIs64;
+	tPESECTION m_aSection[MAX_SECTIONS]; // By RVA
+	UINT m_uSectionCount;
+	ea_t m_importRVA, m_importEndRVA;
+	ea_t m_iatRVA, m_iatEndRVA;
+
+	// No copies
+	PESource(const PESource &);
+	void operator=(const PESource &);
+};
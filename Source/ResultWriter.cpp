@@ -0,0 +1,405 @@
+
+// ****************************************************************************
+// File: ResultWriter.cpp
+// Desc: Machine readable scan result output
+//
+// ****************************************************************************
+#include "StdAfx.h"
+#include "ResultWriter.h"
+#include "Scanner.h"
+#include "GUIDText.h"
+#ifdef _WIN32
+#include <fcntl.h>
+#endif
+
+static const LPCSTR aszFormatName[RESULT_FORMAT_COUNT] = { "text", "jsonl", "csv", "bin" };
+
+// Hit form names by eHITFORM, for the text listing and the JSON and CSV fields
+static const LPCSTR aszFormSuffix[] = { "", " (ASCII text)", " (UTF-16 text)", " (RFC 4122 order)" };
+static const LPCSTR aszFormName[]	= { "binary", "ascii", "utf16", "rfc4122" };
+#define FORM_COUNT (sizeof(aszFormName) / sizeof(aszFormName[0]))
+
+// Room for a record's fixed parts, the strings are added to it
+#define RECORD_SIZE 256
+
+
+ResultWriter::ResultWriter() : m_fp(NULL), m_bStdout(FALSE), m_bError(FALSE), m_eFormat(RESULT_TEXT), m_pDB(NULL), m_pBuffer(NULL), m_uUsed(0), m_pbLabelSent(NULL), m_pszFile(NULL), m_uFileSize(0)
+{
+}
+
+ResultWriter::~ResultWriter()
+{
+	Close();
+}
+
+void ResultWriter::Free()
+{
+	if(m_pBuffer)
+	{
+		qfree(m_pBuffer);
+		m_pBuffer = NULL;
+	}
+	if(m_pbLabelSent)
+	{
+		qfree(m_pbLabelSent);
+		m_pbLabelSent = NULL;
+	}
+	if(m_pszFile)
+	{
+		qfree(m_pszFile);
+		m_pszFile = NULL;
+		m_uFileSize = 0;
+	}
+	m_fp = NULL;
+	m_pDB = NULL;
+	m_uUsed = 0;
+}
+
+
+// Format by name
+BOOL ResultWriter::GetFormat(LPCSTR pszName, eRESULTFORMAT &reFormat)
+{
+	for(UINT i = 0; i < RESULT_FORMAT_COUNT; i++)
+	{
+		if(strcmp(pszName, aszFormatName[i]) == 0)
+		{
+			reFormat = (eRESULTFORMAT) i;
+			return(TRUE);
+		}
+	}
+	return(FALSE);
+}
+
+
+// Start writing to "pszPath", NULL for stdout
+BOOL ResultWriter::Open(LPCSTR pszPath, eRESULTFORMAT eFormat, const CompiledDB &rDB)
+{
+	Close();
+	m_pBuffer = (LPSTR) qalloc(BUFFER_SIZE);
+	if(!m_pBuffer || ((eFormat == RESULT_BINARY) && ((m_pbLabelSent = (PBYTE) qcalloc(((rDB.GetCount() + 7) / 8), 1)) == NULL)))
+	{
+		Free();
+		return(FALSE);
+	}
+
+	if(pszPath)
+	{
+		m_fp = qfopen(pszPath, "wb");
+		m_bStdout = FALSE;
+	}
+	else
+	{
+		#ifdef _WIN32
+		_setmode(_fileno(stdout), _O_BINARY);
+		#endif
+		m_fp = stdout;
+		m_bStdout = TRUE;
+	}
+	if(!m_fp)
+	{
+		Free();
+		return(FALSE);
+	}
+
+	m_bError  = FALSE;
+	m_eFormat = eFormat;
+	m_pDB	  = &rDB;
+	m_uUsed	  = 0;
+	m_uFileID = BADADDR;
+	m_uSegmentCount = m_uSegmentBase = 0;
+
+	if(eFormat == RESULT_CSV)
+	{
+		static const char szHeader[] = "file,address,offset,segment,type,guid,form,label\r\n";
+		Append(szHeader, (sizeof(szHeader) - 1));
+	}
+	else
+	if(eFormat == RESULT_BINARY)
+	{
+		tRESULTHEADER tHeader;
+		tHeader.dwMagic	   = RESULT_MAGIC;
+		tHeader.wVersion   = RESULT_VERSION;
+		tHeader.wHitSize   = sizeof(tRESULTHIT);
+		tHeader.dwDBCount  = rDB.GetCount();
+		tHeader.dwReserved = 0;
+		Append((LPCSTR) &tHeader, sizeof(tHeader));
+		for(UINT i = 0; i < rDB.GetTypeCount(); i++)
+			AppendString(RESULT_TAG_TYPE, i, rDB.GetTypeName(i));
+	}
+	return(TRUE);
+}
+
+
+// Write out what's buffered and close
+BOOL ResultWriter::Close()
+{
+	if(!m_fp)
+		return(FALSE);
+
+	Flush();
+	if(m_bStdout)
+	{
+		if(fflush(m_fp) != 0)
+			m_bError = TRUE;
+	}
+	else
+	if(qfclose(m_fp) != 0)
+		m_bError = TRUE;
+	Free();
+	return(!m_bError);
+}
+
+
+// Write the buffer out
+BOOL ResultWriter::Flush()
+{
+	if(m_uUsed && !m_bError && ((UINT) qfwrite(m_fp, m_pBuffer, m_uUsed) != m_uUsed))
+		m_bError = TRUE;
+	m_uUsed = 0;
+	return(!m_bError);
+}
+
+// Make room for "uSize" more bytes
+inline void ResultWriter::Reserve(UINT uSize)
+{
+	if(uSize > (BUFFER_SIZE - m_uUsed))
+		Flush();
+}
+
+inline void ResultWriter::Append(LPCSTR pszString, UINT uLength)
+{
+	Reserve(uLength);
+	memcpy((m_pBuffer + m_uUsed), pszString, uLength);
+	m_uUsed += uLength;
+}
+
+// The record has to have been reserved for
+void ResultWriter::AppendFormat(LPCSTR pszFormat, ...)
+{
+	va_list vl;
+	va_start(vl, pszFormat);
+	int iLength = _vsnprintf((m_pBuffer + m_uUsed), (BUFFER_SIZE - m_uUsed), pszFormat, vl);
+	va_end(vl);
+	if((iLength > 0) && ((UINT) iLength < (BUFFER_SIZE - m_uUsed)))
+		m_uUsed += iLength;
+}
+
+// JSON string with quotes, escaped. Bytes over 0x7F go as is, like the labels.
+void ResultWriter::AppendJSON(LPCSTR pszString)
+{
+	static const char szHex[] = "0123456789abcdef";
+	m_pBuffer[m_uUsed++] = '"';
+	for(const BYTE *pb = (const BYTE *) pszString; *pb; pb++)
+	{
+		if((*pb == '"') || (*pb == '\\'))
+		{
+			m_pBuffer[m_uUsed++] = '\\';
+			m_pBuffer[m_uUsed++] = *pb;
+		}
+		else
+		if(*pb < ' ')
+		{
+			memcpy((m_pBuffer + m_uUsed), "\\u00", 4);
+			m_pBuffer[m_uUsed + 4] = szHex[*pb >> 4];
+			m_pBuffer[m_uUsed + 5] = szHex[*pb & 15];
+			m_uUsed += 6;
+		}
+		else
+			m_pBuffer[m_uUsed++] = *pb;
+	}
+	m_pBuffer[m_uUsed++] = '"';
+}
+
+// CSV field, quoted only if it has to be
+void ResultWriter::AppendCSV(LPCSTR pszString)
+{
+	if(!strpbrk(pszString, ",\"\r\n"))
+	{
+		UINT uLength = strlen(pszString);
+		memcpy((m_pBuffer + m_uUsed), pszString, uLength);
+		m_uUsed += uLength;
+		return;
+	}
+
+	m_pBuffer[m_uUsed++] = '"';
+	for(LPCSTR psz = pszString; *psz; psz++)
+	{
+		if(*psz == '"')
+			m_pBuffer[m_uUsed++] = '"';
+		m_pBuffer[m_uUsed++] = *psz;
+	}
+	m_pBuffer[m_uUsed++] = '"';
+}
+
+// Binary string record
+void ResultWriter::AppendString(UINT uTag, UINT uID, LPCSTR pszString)
+{
+	UINT uLength = strlen(pszString);
+	if(uLength > 0xFFFF)
+		uLength = 0xFFFF;
+	tRESULTSTRING tString;
+	tString.wTag	= (WORD) uTag;
+	tString.wLength = (WORD) uLength;
+	tString.dwID	= uID;
+	Append((LPCSTR) &tString, sizeof(tString));
+	Append(pszString, uLength);
+}
+
+
+// Binary format file ID, a new one whenever the file changes
+UINT ResultWriter::GetFileID(LPCSTR pszFile)
+{
+	if((m_uFileID == BADADDR) || !m_pszFile || (strcmp(pszFile, m_pszFile) != 0))
+	{
+		// Kept whole, a cut one would never match again
+		UINT uSize = (strlen(pszFile) + 1);
+		if(uSize > m_uFileSize)
+		{
+			if(LPSTR pszNewFile = (LPSTR) qrealloc(m_pszFile, uSize))
+			{
+				m_pszFile = pszNewFile;
+				m_uFileSize = uSize;
+			}
+		}
+		if(uSize <= m_uFileSize)
+			memcpy(m_pszFile, pszFile, uSize);
+		else
+		if(m_pszFile)
+			m_pszFile[0] = 0;
+		AppendString(RESULT_TAG_FILE, ++m_uFileID, pszFile);
+	}
+	return(m_uFileID);
+}
+
+// Binary format segment ID, the same one for a name seen lately
+UINT ResultWriter::GetSegmentID(LPCSTR pszSegment)
+{
+	char szName[SEGMENT_SIZE];
+	qstrncpy(szName, pszSegment, sizeof(szName));
+	for(UINT i = 0; i < m_uSegmentCount; i++)
+	{
+		if(strcmp(szName, m_aszSegment[i]) == 0)
+			return(m_uSegmentBase + i);
+	}
+
+	// Start over when the table is full, the old names get new IDs when seen again
+	if(m_uSegmentCount == MAX_SEGMENTS)
+	{
+		m_uSegmentBase += m_uSegmentCount;
+		m_uSegmentCount = 0;
+	}
+	memcpy(m_aszSegment[m_uSegmentCount], szName, sizeof(szName));
+	UINT uID = (m_uSegmentBase + m_uSegmentCount++);
+	AppendString(RESULT_TAG_SEGMENT, uID, szName);
+	return(uID);
+}
+
+
+// Write a hit
+void ResultWriter::Write(const tRESULT &rResult)
+{
+	if(!m_fp || m_bError)
+		return;
+
+	const CompiledDB &rDB = *m_pDB;
+	UINT uForm = ((rResult.uForm < FORM_COUNT) ? rResult.uForm : (UINT) HIT_BINARY);
+	LPCSTR pszLabel = rDB.GetLabel(rResult.uEntry);
+	LPCSTR pszType	= rDB.GetTypeName(rDB.GetType(rResult.uEntry));
+	LPCSTR pszFile	= (rResult.pszFile ? rResult.pszFile : "");
+	LPCSTR pszSegment = (rResult.pszSegment ? rResult.pszSegment : "");
+
+	if(m_eFormat == RESULT_BINARY)
+	{
+		tRESULTHIT tHit;
+		tHit.wTag	   = RESULT_TAG_HIT;
+		tHit.bForm	   = (BYTE) uForm;
+		tHit.bType	   = (BYTE) rDB.GetType(rResult.uEntry);
+		tHit.dwAddress = rResult.ea;
+		tHit.dwOffset  = rResult.uOffset;
+		tHit.dwEntry   = rResult.uEntry;
+		tHit.dwFile	   = (rResult.pszFile ? GetFileID(rResult.pszFile) : BADADDR);
+		tHit.dwSegment = (rResult.pszSegment ? GetSegmentID(rResult.pszSegment) : BADADDR);
+		tHit.Guid	   = rDB.GetKeys()[rResult.uEntry];
+		if(!(m_pbLabelSent[rResult.uEntry >> 3] & (1 << (rResult.uEntry & 7))))
+		{
+			m_pbLabelSent[rResult.uEntry >> 3] |= (1 << (rResult.uEntry & 7));
+			AppendString(RESULT_TAG_LABEL, rResult.uEntry, pszLabel);
+		}
+		Append((LPCSTR) &tHit, sizeof(tHit));
+		return;
+	}
+
+	// Worst case, every string char escaped
+	Reserve(RECORD_SIZE + ((strlen(pszFile) + strlen(pszSegment) + strlen(pszLabel) + strlen(pszType)) * 6));
+	switch(m_eFormat)
+	{
+		case RESULT_TEXT:
+		{
+			if(rResult.pszFile)
+				AppendFormat("%s ", pszFile);
+			if(rResult.uOffset != BADADDR)
+				AppendFormat("%08X ", rResult.uOffset);
+			else
+				AppendFormat("-------- ");
+			if(rResult.ea != BADADDR)
+				AppendFormat("%08X ", rResult.ea);
+			else
+				AppendFormat("-------- ");
+			AppendFormat("%-8s %s%s\n", (rResult.pszSegment ? pszSegment : "-"), pszLabel, aszFormSuffix[uForm]);
+		}
+		break;
+
+		case RESULT_JSONL:
+		{
+			char szGUID[GUID_TEXT_SIZE];
+			AppendFormat("{\"file\":");
+			if(rResult.pszFile)
+				AppendJSON(pszFile);
+			else
+				AppendFormat("null");
+			if(rResult.ea != BADADDR)
+				AppendFormat(",\"address\":%u", rResult.ea);
+			else
+				AppendFormat(",\"address\":null");
+			if(rResult.uOffset != BADADDR)
+				AppendFormat(",\"offset\":%u", rResult.uOffset);
+			else
+				AppendFormat(",\"offset\":null");
+			AppendFormat(",\"segment\":");
+			if(rResult.pszSegment)
+				AppendJSON(pszSegment);
+			else
+				AppendFormat("null");
+			AppendFormat(",\"type\":");
+			AppendJSON(pszType);
+			AppendFormat(",\"guid\":\"%s\",\"form\":\"%s\",\"label\":", GUIDToString(rDB.GetKeys()[rResult.uEntry], szGUID), aszFormName[uForm]);
+			AppendJSON(pszLabel);
+			AppendFormat("}\n");
+		}
+		break;
+
+		case RESULT_CSV:
+		{
+			char szGUID[GUID_TEXT_SIZE];
+			AppendCSV(pszFile);
+			if(rResult.ea != BADADDR)
+				AppendFormat(",%u", rResult.ea);
+			else
+				AppendFormat(",");
+			if(rResult.uOffset != BADADDR)
+				AppendFormat(",%u,", rResult.uOffset);
+			else
+				AppendFormat(",,");
+			AppendCSV(pszSegment);
+			AppendFormat(",");
+			AppendCSV(pszType);
+			AppendFormat(",%s,%s,", GUIDToString(rDB.GetKeys()[rResult.uEntry], szGUID), aszFormName[uForm]);
+			AppendCSV(pszLabel);
+			AppendFormat("\r\n");
+		}
+		break;
+
+		default:
+		break;
+	};
+}
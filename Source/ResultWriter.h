@@ -0,0 +1,139 @@
+
+// ****************************************************************************
+// File: ResultWriter.h
+// Desc: Machine readable scan result output
+//
+// ****************************************************************************
+#pragma once
+#include "CompiledDB.h"
+
+// Output formats
+enum eRESULTFORMAT
+{
+	RESULT_TEXT,	// A line per hit, GUIDScan's listing
+	RESULT_JSONL,	// JSON Lines, an object per hit
+	RESULT_CSV,		// RFC 4180 CSV with a header row
+	RESULT_BINARY,	// Fixed size hit records, strings sent once (see below)
+
+	RESULT_FORMAT_COUNT
+};
+
+// A hit to write
+struct tRESULT
+{
+	LPCSTR pszFile;		// Scanned file, NULL for none (the IDB)
+	ea_t   ea;			// Address or RVA, BADADDR for none
+	UINT   uOffset;		// File offset, BADADDR for none
+	LPCSTR pszSegment;	// Segment or section name, NULL for none
+	UINT   uEntry;		// DB entry
+	UINT   uForm;		// eHITFORM
+};
+
+// Binary format, little endian. A tRESULTHEADER, then records, each one
+// starting with its WORD tag. Hits are fixed size tRESULTHIT records; the
+// strings they refer to by ID come once each, in a tRESULTSTRING record
+// ahead of the first hit using them, followed by "wLength" chars with no
+// terminator. Type names are all sent up front. IDs are DB entries for
+// labels and DB types for type names, and are numbered from 0 in the order
+// they're first seen for files and segments.
+#define RESULT_MAGIC   0x42524647 // "GFRB"
+#define RESULT_VERSION 1
+
+enum
+{
+	RESULT_TAG_HIT = 1,
+	RESULT_TAG_LABEL,
+	RESULT_TAG_TYPE,
+	RESULT_TAG_FILE,
+	RESULT_TAG_SEGMENT
+};
+
+struct tRESULTHEADER
+{
+	DWORD dwMagic;		// RESULT_MAGIC
+	WORD  wVersion;		// RESULT_VERSION
+	WORD  wHitSize;		// sizeof(tRESULTHIT)
+	DWORD dwDBCount;	// DB entries
+	DWORD dwReserved;
+};
+
+struct tRESULTSTRING
+{
+	WORD  wTag;			// RESULT_TAG_LABEL .. RESULT_TAG_SEGMENT
+	WORD  wLength;		// Chars following
+	DWORD dwID;
+};
+
+struct tRESULTHIT
+{
+	WORD  wTag;			// RESULT_TAG_HIT
+	BYTE  bForm;		// eHITFORM
+	BYTE  bType;		// DB type
+	DWORD dwAddress;	// BADADDR for none
+	DWORD dwOffset;		// BADADDR for none
+	DWORD dwEntry;		// DB entry, the label's ID
+	DWORD dwFile;		// BADADDR for none
+	DWORD dwSegment;	// BADADDR for none
+	GUID  Guid;			// The DB's GUID, "bForm" says how it was stored
+};
+
+// Streams hits to a file or stdout in one of the formats above.
+// Records are formatted straight into a large buffer that's only written
+// out when full and on Close(), never per hit, so output keeps up with
+// the scan. One Write() at a time; the corpus scanner's FileDone() calls are.
+class ResultWriter
+{
+public:
+	enum
+	{
+		BUFFER_SIZE  = (1024 * 1024),
+		MAX_SEGMENTS = 256,	// Segment names remembered for IDs, more start over
+		SEGMENT_SIZE = 64	// Longer names are cut
+	};
+
+	ResultWriter();
+	~ResultWriter();
+
+	// Start writing to "pszPath", NULL for stdout. "rDB" has to stay loaded while open.
+	BOOL Open(LPCSTR pszPath, eRESULTFORMAT eFormat, const CompiledDB &rDB);
+	void Write(const tRESULT &rResult);
+	// Write out what's buffered and close; FALSE if any write failed
+	BOOL Close();
+	BOOL IsOpen() const { return(m_fp != NULL); }
+
+	// Format by name, "text", "jsonl", "csv" or "bin"
+	static BOOL GetFormat(LPCSTR pszName, eRESULTFORMAT &reFormat);
+
+private:
+	FILE  *m_fp;
+	BOOL  m_bStdout;
+	BOOL  m_bError;
+	eRESULTFORMAT m_eFormat;
+	const CompiledDB *m_pDB;
+	LPSTR m_pBuffer;
+	UINT  m_uUsed;
+
+	// Binary format string IDs
+	PBYTE m_pbLabelSent;	// Bit per DB entry
+	LPSTR m_pszFile;		// Whole path, paths can be longer than MAX_PATH
+	UINT  m_uFileSize;		// m_pszFile's allocation
+	UINT  m_uFileID;		// Of m_pszFile, BADADDR before the first
+	char  m_aszSegment[MAX_SEGMENTS][SEGMENT_SIZE];
+	UINT  m_uSegmentCount;
+	UINT  m_uSegmentBase;	// ID of m_aszSegment[0]
+
+	void Free();
+	BOOL Flush();
+	void Reserve(UINT uSize);
+	void Append(LPCSTR pszString, UINT uLength);
+	void AppendFormat(LPCSTR pszFormat, ...);
+	void AppendJSON(LPCSTR pszString);
+	void AppendCSV(LPCSTR pszString);
+	void AppendString(UINT uTag, UINT uID, LPCSTR pszString);
+	UINT GetFileID(LPCSTR pszFile);
+	UINT GetSegmentID(LPCSTR pszSegment);
+
+	// No copies
+	ResultWriter(const ResultWriter &);
+	void operator=(const ResultWriter &);
+};
@@ -0,0 +1,304 @@
+
+// ****************************************************************************
+// File: ScanCache.cpp
+// Desc: On disk scan result cache keyed by range content
+//
+// ****************************************************************************
+#include "StdAfx.h"
+#include "ScanCache.h"
+
+#define CACHE_MAGIC   0x43534647 // "GFSC"
+#define CACHE_VERSION 1
+
+ScanCache::ScanCache() : m_uDBVersion(0), m_uDBCount(0), m_uMaxSize(DEFAULT_MAX_SIZE), m_uGeneration(0), m_pFile(NULL), m_ppTable(NULL), m_uMask(0), m_uCount(0), m_uLookups(0), m_uFound(0), m_uBytesFound(0)
+{
+	m_szPath[0] = 0;
+	InitializeCriticalSection(&m_Lock);
+}
+
+ScanCache::~ScanCache()
+{
+	Close();
+	DeleteCriticalSection(&m_Lock);
+}
+
+
+// Key of a range. A strided scan depends on where the bytes start relative to the stride.
+void ScanCache::GetKey(const BYTE *pData, UINT uSize, ea_t ea, UINT uStride, UINT uFlags, tKEY &rKey) const
+{
+	ULONGLONG auSettings[4] = { m_uDBVersion, uStride, uFlags, (ea % uStride) };
+	rKey.uHash = HashBytes64(pData, uSize);
+	rKey.uVersion = HashBytes64((const BYTE *) auSettings, sizeof(auSettings));
+	rKey.uSize = uSize;
+}
+
+
+// Load the cache in "pszDir"
+BOOL ScanCache::Open(LPCSTR pszDir, ULONGLONG uDBVersion, UINT uDBCount, UINT uMaxSize)
+{
+	Close();
+
+	#ifdef _WIN32
+	CreateDirectory(pszDir, NULL);
+	#else
+	mkdir(pszDir, 0777);
+	#endif
+	qsnprintf(m_szPath, sizeof(m_szPath), "%s/%s", pszDir, SCAN_CACHE_FILE);
+	m_uDBVersion = uDBVersion;
+	m_uDBCount = uDBCount;
+	m_uMaxSize = uMaxSize;
+	m_uLookups = m_uFound = 0;
+	m_uBytesFound = 0;
+	m_uGeneration = 1;
+
+	if(!Grow())
+	{
+		m_szPath[0] = 0;
+		return(FALSE);
+	}
+
+	// A missing or bad file is an empty cache
+	if(!Load())
+	{
+		if(m_pFile)
+		{
+			qfree(m_pFile);
+			m_pFile = NULL;
+		}
+		ZeroMemory(m_ppTable, (sizeof(tENTRY *) * (m_uMask + 1)));
+		m_uCount = 0;
+		m_uGeneration = 1;
+	}
+	return(TRUE);
+}
+
+// Read the cache file and index its entries
+BOOL ScanCache::Load()
+{
+	FILE *fp = qfopen(m_szPath, "rb");
+	if(!fp)
+		return(FALSE);
+	UINT uSize = qfsize(fp);
+	BOOL bRead = FALSE;
+	if((uSize >= sizeof(tHEADER)) && ((m_pFile = (PBYTE) qalloc(uSize)) != NULL))
+		bRead = ((UINT) qfread(fp, m_pFile, uSize) == uSize);
+	qfclose(fp);
+	if(!bRead)
+		return(FALSE);
+
+	const tHEADER *pHeader = (const tHEADER *) m_pFile;
+	if((pHeader->dwMagic != CACHE_MAGIC) || (pHeader->dwVersion != CACHE_VERSION))
+		return(FALSE);
+	m_uGeneration = (pHeader->uGeneration + 1);
+
+	UINT uOffset = sizeof(tHEADER);
+	for(UINT i = 0; i < pHeader->uCount; i++)
+	{
+		if((uSize - uOffset) < sizeof(tENTRY))
+			return(FALSE);
+		tENTRY *pEntry = (tENTRY *) (m_pFile + uOffset);
+		if(pEntry->uHitCount > ((uSize - uOffset - sizeof(tENTRY)) / sizeof(tSCANHIT)))
+			return(FALSE);
+		UINT uEntrySize = GetEntrySize(pEntry->uHitCount);
+		if(uEntrySize > (uSize - uOffset))
+			return(FALSE);
+
+		// Damaged, or not from this DB after all
+		const tSCANHIT *pHits = (const tSCANHIT *) (pEntry + 1);
+		for(UINT j = 0; j < pEntry->uHitCount; j++)
+		{
+			if((pHits[j].uKey >= m_uDBCount) || (pHits[j].uForm >= HIT_FORM_COUNT) || (pHits[j].ea >= pEntry->Key.uSize))
+				return(FALSE);
+		}
+		if(!Insert(pEntry))
+			return(FALSE);
+		uOffset += uEntrySize;
+	}
+	return(TRUE);
+}
+
+
+// Entry list order for writing, most recently used first
+int __cdecl ScanCache::CompareGeneration(const void *pA, const void *pB)
+{
+	UINT a = (*((const tENTRY *const *) pA))->uGeneration, b = (*((const tENTRY *const *) pB))->uGeneration;
+	return((a > b) ? -1 : (a < b));
+}
+
+// Write the cache back, the most recently used entries that fit in the cap
+BOOL ScanCache::Close()
+{
+	if(!IsOpen())
+		return(FALSE);
+
+	BOOL bResult = FALSE;
+	tENTRY **ppList = (tENTRY **) qalloc(sizeof(tENTRY *) * (m_uCount + 1));
+	if(ppList)
+	{
+		UINT uCount = 0;
+		for(UINT i = 0; i <= m_uMask; i++)
+		{
+			if(m_ppTable[i])
+				ppList[uCount++] = m_ppTable[i];
+		}
+		if(uCount)
+			qsort(ppList, uCount, sizeof(tENTRY *), CompareGeneration);
+
+		UINT uKeep = 0, uSize = sizeof(tHEADER);
+		while((uKeep < uCount) && (GetEntrySize(ppList[uKeep]->uHitCount) <= (m_uMaxSize - uSize)))
+			uSize += GetEntrySize(ppList[uKeep++]->uHitCount);
+
+		// Written aside then renamed over, a failed write leaves the old cache
+		char szTemp[MAX_PATH];
+		qsnprintf(szTemp, sizeof(szTemp), "%s.tmp", m_szPath);
+		if(FILE *fp = qfopen(szTemp, "wb"))
+		{
+			tHEADER tHeader;
+			tHeader.dwMagic = CACHE_MAGIC;
+			tHeader.dwVersion = CACHE_VERSION;
+			tHeader.uGeneration = m_uGeneration;
+			tHeader.uCount = uKeep;
+			bResult = (qfwrite(fp, &tHeader, sizeof(tHeader)) == sizeof(tHeader));
+			static const BYTE abPad[8] = { 0 };
+			for(UINT i = 0; (i < uKeep) && bResult; i++)
+			{
+				UINT uLength = (sizeof(tENTRY) + (ppList[i]->uHitCount * sizeof(tSCANHIT)));
+				UINT uPad = (GetEntrySize(ppList[i]->uHitCount) - uLength);
+				bResult = (((UINT) qfwrite(fp, ppList[i], uLength) == uLength) && ((UINT) qfwrite(fp, abPad, uPad) == uPad));
+			}
+			if(qfclose(fp) != 0)
+				bResult = FALSE;
+
+			#ifdef _WIN32
+			if(bResult)
+				bResult = MoveFileEx(szTemp, m_szPath, MOVEFILE_REPLACE_EXISTING);
+			#else
+			if(bResult)
+				bResult = (rename(szTemp, m_szPath) == 0);
+			#endif
+			if(!bResult)
+				DeleteFile(szTemp);
+		}
+		qfree(ppList);
+	}
+
+	if(m_ppTable)
+	{
+		qfree(m_ppTable);
+		m_ppTable = NULL;
+	}
+	if(m_pFile)
+	{
+		qfree(m_pFile);
+		m_pFile = NULL;
+	}
+	m_Arena.Reset();
+	m_uMask = m_uCount = 0;
+	m_szPath[0] = 0;
+	return(bResult);
+}
+
+
+// Double the table, or make the first one
+BOOL ScanCache::Grow()
+{
+	UINT uNewMask = (m_uMask ? ((m_uMask << 1) | 1) : 4095);
+	tENTRY **ppNewTable = (tENTRY **) qcalloc((uNewMask + 1), sizeof(tENTRY *));
+	if(!ppNewTable)
+		return(FALSE);
+
+	tENTRY **ppOldTable = m_ppTable;
+	UINT uOldMask = m_uMask;
+	m_ppTable = ppNewTable;
+	m_uMask = uNewMask;
+	if(ppOldTable)
+	{
+		for(UINT i = 0; i <= uOldMask; i++)
+		{
+			if(ppOldTable[i])
+				*Find(ppOldTable[i]->Key) = ppOldTable[i];
+		}
+		qfree(ppOldTable);
+	}
+	return(TRUE);
+}
+
+// Slot of a key, empty if it's not in the table
+ScanCache::tENTRY **ScanCache::Find(const tKEY &rKey)
+{
+	UINT i = ((UINT) (rKey.uHash ^ rKey.uVersion) & m_uMask);
+	while(tENTRY *pEntry = m_ppTable[i])
+	{
+		if((pEntry->Key.uHash == rKey.uHash) && (pEntry->Key.uVersion == rKey.uVersion) && (pEntry->Key.uSize == rKey.uSize))
+			break;
+		i = ((i + 1) & m_uMask);
+	};
+	return(&m_ppTable[i]);
+}
+
+// Add an entry if its key is new
+BOOL ScanCache::Insert(tENTRY *pEntry)
+{
+	// Keep the table at most half full
+	if((((m_uCount + 1) * 2) > m_uMask) && !Grow())
+		return(FALSE);
+
+	tENTRY **ppSlot = Find(pEntry->Key);
+	if(!*ppSlot)
+	{
+		*ppSlot = pEntry;
+		m_uCount++;
+	}
+	return(TRUE);
+}
+
+
+// Get a range's hits at "ea"
+BOOL ScanCache::Lookup(const tKEY &rKey, ea_t ea, tSCANHIT *&rpHits, UINT &ruHitCount)
+{
+	rpHits = NULL;
+	ruHitCount = 0;
+	EnterCriticalSection(&m_Lock);
+	m_uLookups++;
+	tENTRY *pEntry = *Find(rKey);
+	if(pEntry && pEntry->uHitCount && ((rpHits = (tSCANHIT *) qalloc(sizeof(tSCANHIT) * pEntry->uHitCount)) == NULL))
+		pEntry = NULL;
+	if(pEntry)
+	{
+		pEntry->uGeneration = m_uGeneration;
+		const tSCANHIT *pHits = (const tSCANHIT *) (pEntry + 1);
+		for(UINT i = 0; i < pEntry->uHitCount; i++)
+		{
+			rpHits[i] = pHits[i];
+			rpHits[i].ea += ea;
+		}
+		ruHitCount = pEntry->uHitCount;
+		m_uFound++;
+		m_uBytesFound += rKey.uSize;
+	}
+	LeaveCriticalSection(&m_Lock);
+	return(pEntry != NULL);
+}
+
+// Cache a range's hits
+void ScanCache::Store(const tKEY &rKey, ea_t ea, const tSCANHIT *pHits, UINT uHitCount)
+{
+	EnterCriticalSection(&m_Lock);
+	if(!*Find(rKey))
+	{
+		if(tENTRY *pEntry = (tENTRY *) m_Arena.Alloc(GetEntrySize(uHitCount), 8))
+		{
+			pEntry->Key = rKey;
+			pEntry->uGeneration = m_uGeneration;
+			pEntry->uHitCount = uHitCount;
+			tSCANHIT *pEntryHits = (tSCANHIT *) (pEntry + 1);
+			for(UINT i = 0; i < uHitCount; i++)
+			{
+				pEntryHits[i] = pHits[i];
+				pEntryHits[i].ea -= ea;
+			}
+			Insert(pEntry);
+		}
+	}
+	LeaveCriticalSection(&m_Lock);
+}
@@ -0,0 +1,109 @@
+
+// ****************************************************************************
+// File: ScanCache.h
+// Desc: On disk scan result cache keyed by range content
+//
+// ****************************************************************************
+#pragma once
+#include "ScanEngine.h"
+#include "Arena.h"
+
+#define SCAN_CACHE_FILE "GUIDScan.cache"
+
+// Persistent cache of the hits found in a scanned byte range, keyed by a
+// 64 bit hash of the bytes and what the scan depended on: the DB contents,
+// the index options, stride, flags and the range's address alignment.
+// The same system DLLs and runtimes turn up again and again in a corpus,
+// their sections become a lookup instead of a scan.
+// It's one file in a local directory, loaded whole on Open() and written
+// back on Close() with the least recently used entries (by run) dropped to
+// keep it under the size cap. Lookup() and Store() can be called from any
+// thread.
+class ScanCache
+{
+public:
+	enum
+	{
+		DEFAULT_MAX_SIZE = (256 * 1024 * 1024)
+	};
+
+	// Range key
+	struct tKEY
+	{
+		ULONGLONG uHash;	// Of the bytes
+		ULONGLONG uVersion; // Of the DB and scan settings
+		UINT uSize;
+	};
+
+	ScanCache();
+	~ScanCache();
+
+	// Load the cache in "pszDir", creating the directory if needed.
+	// "uDBVersion" is the engine's ScanEngine::GetVersion(), "uDBCount" the DB's
+	// entry count, "uMaxSize" is the file size cap.
+	BOOL Open(LPCSTR pszDir, ULONGLONG uDBVersion, UINT uDBCount, UINT uMaxSize = DEFAULT_MAX_SIZE);
+	// Write the cache back and free it; FALSE if it couldn't be written
+	BOOL Close();
+	BOOL IsOpen() const { return(m_szPath[0] != 0); }
+
+	// Key of "uSize" bytes at "pData", scanned from "ea" with "uStride" and "uFlags"
+	void GetKey(const BYTE *pData, UINT uSize, ea_t ea, UINT uStride, UINT uFlags, tKEY &rKey) const;
+
+	// Get a range's hits at "ea", in a qalloc()'d list the caller frees (NULL if none).
+	// FALSE if the range isn't cached.
+	BOOL Lookup(const tKEY &rKey, ea_t ea, tSCANHIT *&rpHits, UINT &ruHitCount);
+
+	// Cache a range's hits, "ea" being where the range starts
+	void Store(const tKEY &rKey, ea_t ea, const tSCANHIT *pHits, UINT uHitCount);
+
+	UINT GetLookupCount() const { return(m_uLookups); }
+	UINT GetFoundCount() const { return(m_uFound); }
+	ULONGLONG GetBytesFound() const { return(m_uBytesFound); }
+	UINT GetEntryCount() const { return(m_uCount); }
+
+private:
+	// Cache file header, the entries follow it
+	struct tHEADER
+	{
+		DWORD dwMagic;
+		DWORD dwVersion;
+		UINT  uGeneration; // Runs written
+		UINT  uCount;
+	};
+
+	// Entry, its hits follow it with addresses from the range start.
+	// Loaded ones are checked, a hit is in its range and names a DB entry and form.
+	struct tENTRY
+	{
+		tKEY Key;
+		UINT uGeneration;  // Run last used in
+		UINT uHitCount;
+	};
+
+	BOOL Load();
+	static int __cdecl CompareGeneration(const void *pA, const void *pB);
+	BOOL Insert(tENTRY *pEntry);
+	BOOL Grow();
+	tENTRY **Find(const tKEY &rKey);
+	// Entries are kept 8 byte aligned in the file
+	static UINT GetEntrySize(UINT uHitCount){ return((sizeof(tENTRY) + (uHitCount * sizeof(tSCANHIT)) + 7) & ~7); }
+
+	char  m_szPath[MAX_PATH];
+	ULONGLONG m_uDBVersion;
+	UINT  m_uDBCount;
+	UINT  m_uMaxSize;
+	UINT  m_uGeneration;	// This run's
+	PBYTE m_pFile;			// Loaded cache file, holds the entries from it
+	Arena m_Arena;			// Holds the entries added this run
+	tENTRY **m_ppTable;		// Open addressed on the key hash
+	UINT  m_uMask;
+	UINT  m_uCount;
+	CRITICAL_SECTION m_Lock;
+
+	UINT  m_uLookups, m_uFound;
+	ULONGLONG m_uBytesFound;
+
+	// No copies
+	ScanCache(const ScanCache &);
+	void operator=(const ScanCache &);
+};
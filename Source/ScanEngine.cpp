@@ -0,0 +1,281 @@
+
+// ****************************************************************************
+// File: ScanEngine.cpp
+// Desc: GUID scan engine, the scan phase outside of IDA
+//
+// ****************************************************************************
+#include "StdAfx.h"
+#include "ScanEngine.h"
+
+ScanEngine::ScanEngine() : m_pDB(NULL), m_uDBCount(0), m_bRFC4122(FALSE), m_uVersion(0), m_pHits(NULL), m_uHitCount(0), m_uHitMax(0), m_uDropped(0), m_bAborted(FALSE)
+{
+}
+
+ScanEngine::~ScanEngine()
+{
+	Stop();
+	Reset();
+	FreeIndex();
+}
+
+
+// Swap a GUID between Microsoft and RFC 4122 byte order
+static inline void SwapGUIDOrder(const GUID &rIn, GUID &rOut)
+{
+	rOut.Data1 = _byteswap_ulong(rIn.Data1);
+	rOut.Data2 = _byteswap_ushort(rIn.Data2);
+	rOut.Data3 = _byteswap_ushort(rIn.Data3);
+	memcpy(rOut.Data4, rIn.Data4, sizeof(rOut.Data4));
+}
+
+// Build the scanner index from the DB.
+// The DB keys are sorted, so the index uses the mapped keys in place and a
+// hit's key position is the DB entry.
+// With RFC 4122 order the index is over the DB keys followed by their byte
+// swapped forms, both orders are found in the one pass and a key position
+// past the DB count is the RFC 4122 form of entry (position - count).
+BOOL ScanEngine::BuildIndex(const CompiledDB &rDB, BOOL bRFC4122)
+{
+	// Still built from the last run?
+	bRFC4122 = (bRFC4122 != FALSE);
+	if(!m_Index.IsEmpty() && (m_pDB == &rDB) && (m_bRFC4122 == bRFC4122))
+		return(TRUE);
+
+	FreeIndex();
+	BOOL bResult = FALSE;
+	UINT uCount = rDB.GetCount();
+	if(!bRFC4122)
+		bResult = m_Index.Build(rDB.GetKeys(), uCount);
+	else
+	{
+		// The index keeps a sorted copy, the key array is only needed here
+		if(GUID *pKeys = (GUID *) qalloc(sizeof(GUID) * ((uCount * 2) + 1)))
+		{
+			const GUID *pDBKeys = rDB.GetKeys();
+			memcpy(pKeys, pDBKeys, (sizeof(GUID) * uCount));
+			for(UINT i = 0; i < uCount; i++)
+				SwapGUIDOrder(pDBKeys[i], pKeys[uCount + i]);
+			bResult = m_Index.Build(pKeys, (uCount * 2));
+			qfree(pKeys);
+		}
+	}
+
+	if(!bResult)
+	{
+		m_Index.Clear();
+		msg("\n*** Failed to build GUID index! ***\n");
+		return(FALSE);
+	}
+	m_pDB = &rDB;
+	m_uDBCount = uCount;
+	m_bRFC4122 = bRFC4122;
+	UINT auOptions[2] = { (UINT) m_bRFC4122, SCANNER_VERSION };
+	m_uVersion = HashBytes64((const BYTE *) auOptions, sizeof(auOptions), rDB.GetVersion());
+	return(TRUE);
+}
+
+void ScanEngine::FreeIndex()
+{
+	m_Index.Clear();
+	m_pDB = NULL;
+	m_uDBCount = 0;
+	m_bRFC4122 = FALSE;
+	m_uVersion = 0;
+}
+
+
+// Start "uThreads" scan threads (0 = one per CPU)
+BOOL ScanEngine::Start(UINT uThreads)
+{
+	return(m_ScanPool.Start(&m_Index, uThreads));
+}
+
+void ScanEngine::Stop()
+{
+	m_ScanPool.Stop();
+}
+
+
+// Drop the hits and the counts for the next run
+void ScanEngine::Reset()
+{
+	m_SegReader.ResetBytesRead();
+	m_bAborted = FALSE;
+
+	if(m_pHits)
+	{
+		qfree(m_pHits);
+		m_pHits = NULL;
+	}
+	m_uHitCount = m_uHitMax = m_uDropped = 0;
+}
+
+
+// Take a scanned job's hits into the hit list
+void ScanEngine::CollectHits(tCHUNKJOB *pJob)
+{
+	if(pJob->uDropped)
+	{
+		msg("  *** Failed to allocate chunk hit list, %u hits dropped! ***\n", pJob->uDropped);
+		m_uDropped += pJob->uDropped;
+	}
+	if(!pJob->uHitCount)
+		return;
+	if((m_uHitCount + pJob->uHitCount) > m_uHitMax)
+	{
+		UINT uMax = ((m_uHitMax * 2) > (m_uHitCount + pJob->uHitCount)) ? (m_uHitMax * 2) : (m_uHitCount + pJob->uHitCount);
+		tSCANHIT *pHits = (tSCANHIT *) qrealloc(m_pHits, (sizeof(tSCANHIT) * uMax));
+		if(!pHits)
+		{
+			msg("  *** Failed to allocate hit list, %u hits dropped! ***\n", pJob->uHitCount);
+			m_uDropped += pJob->uHitCount;
+			return;
+		}
+		m_pHits = pHits;
+		m_uHitMax = uMax;
+	}
+
+	if(!m_bRFC4122)
+	{
+		memcpy(&m_pHits[m_uHitCount], pJob->pHits, (sizeof(tSCANHIT) * pJob->uHitCount));
+		m_uHitCount += pJob->uHitCount;
+	}
+	else
+	{
+		// Map RFC 4122 order keys back to their DB entry
+		for(UINT i = 0; i < pJob->uHitCount; i++)
+		{
+			tSCANHIT tHit = pJob->pHits[i];
+			if(MapHit(tHit))
+				m_pHits[m_uHitCount++] = tHit;
+		}
+	}
+}
+
+// Hit order, by address then form then entry
+int __cdecl ScanEngine::CompareHit(const void *pA, const void *pB)
+{
+	const tSCANHIT *pHitA = (const tSCANHIT *) pA, *pHitB = (const tSCANHIT *) pB;
+	if(pHitA->ea != pHitB->ea)
+		return((pHitA->ea < pHitB->ea) ? -1 : 1);
+	if(pHitA->uForm != pHitB->uForm)
+		return((pHitA->uForm < pHitB->uForm) ? -1 : 1);
+	return((pHitA->uKey < pHitB->uKey) ? -1 : (pHitA->uKey > pHitB->uKey));
+}
+
+// Scan a segment range, chunks are read here and scanned by the worker
+// threads. Hits are only collected here, they're applied after the scan.
+// With a stride > 1 only addresses aligned to it are tested, text GUIDs
+// (SCAN_TEXT) are found at any address.
+// Returns hit count.
+UINT ScanEngine::ScanRange(ByteSource &rSource, ea_t startEA, ea_t endEA, UINT uStride, UINT uFlags, ULONGLONG *puFingerprint)
+{
+	UINT uInFlight = 0;
+	BOOL bMore = TRUE;
+	UINT uStartCount = m_uHitCount;
+
+	m_SegReader.Open(rSource, startEA, endEA, (puFingerprint != NULL));
+	while(bMore || uInFlight)
+	{
+		// Keep the workers fed
+		while(bMore && !m_bAborted)
+		{
+			tCHUNKJOB *pJob = m_ScanPool.GetFreeJob();
+			if(!pJob)
+				break;
+
+			BOOL bRunMore;
+			if(m_SegReader.Next(pJob->pBuffer, pJob->ea, pJob->uSize, pJob->uKeep, bRunMore))
+			{
+				pJob->uStride = uStride;
+				pJob->uFlags  = (bRunMore ? (uFlags | SCAN_MORE) : uFlags);
+				m_ScanPool.Submit(pJob);
+				uInFlight++;
+			}
+			else
+			{
+				m_ScanPool.Recycle(pJob);
+				bMore = FALSE;
+			}
+
+			// User abort?
+			if(rSource.CheckBreak())
+				m_bAborted = TRUE;
+		};
+		if(m_bAborted)
+			bMore = FALSE;
+
+		// Drain finished jobs
+		if(uInFlight)
+		{
+			if(tCHUNKJOB *pJob = m_ScanPool.GetDoneJob(100))
+			{
+				CollectHits(pJob);
+				m_ScanPool.Recycle(pJob);
+				uInFlight--;
+			}
+			else
+			if(rSource.CheckBreak())
+				m_bAborted = TRUE;
+		}
+	};
+
+	if(puFingerprint)
+		*puFingerprint = GetFingerprint(m_SegReader, startEA, endEA, uStride, uFlags);
+	return(m_uHitCount - uStartCount);
+}
+
+// Fingerprint a segment range without scanning it, see ScanRange().
+// Read with a reader of its own, so it's not counted in GetBytesRead().
+// Returns 0 on abort or if the chunk buffer can't be allocated.
+ULONGLONG ScanEngine::FingerprintRange(ByteSource &rSource, ea_t startEA, ea_t endEA, UINT uStride, UINT uFlags)
+{
+	PBYTE pBuffer = (PBYTE) qalloc(SegReader::CHUNK_SIZE);
+	if(!pBuffer)
+		return(0);
+
+	SegReader Reader;
+	Reader.Open(rSource, startEA, endEA, TRUE);
+	ea_t ea;
+	UINT uSize, uKeep;
+	BOOL bRunMore;
+	while(Reader.Next(pBuffer, ea, uSize, uKeep, bRunMore))
+	{
+		// User abort?
+		if(rSource.CheckBreak())
+		{
+			m_bAborted = TRUE;
+			break;
+		}
+	};
+	qfree(pBuffer);
+	return(m_bAborted ? 0 : GetFingerprint(Reader, startEA, endEA, uStride, uFlags));
+}
+
+// A range's fingerprint, its bytes as read with the scan settings
+ULONGLONG ScanEngine::GetFingerprint(const SegReader &rReader, ea_t startEA, ea_t endEA, UINT uStride, UINT uFlags)
+{
+	UINT auSettings[4] = { (UINT) startEA, (UINT) endEA, uStride, uFlags };
+	return(HashBytes64((const BYTE *) auSettings, sizeof(auSettings), rReader.GetFingerprint()));
+}
+
+
+// Hand all the scan hits to the sink in address order.
+// Returns count handed out.
+UINT ScanEngine::ApplyHits(HitSink &rSink)
+{
+	if(m_uHitCount)
+		qsort(m_pHits, m_uHitCount, sizeof(tSCANHIT), CompareHit);
+
+	UINT i = 0;
+	while(i < m_uHitCount)
+	{
+		rSink.OnHit(m_pHits[i].ea, m_pHits[i].uKey, m_pHits[i].uForm);
+
+		// User abort?
+		if(!(++i & 1023) && rSink.CheckBreak())
+			break;
+	};
+
+	return(i);
+}
@@ -0,0 +1,105 @@
+
+// ****************************************************************************
+// File: ScanEngine.h
+// Desc: GUID scan engine, the scan phase outside of IDA
+//
+// ****************************************************************************
+#pragma once
+#include "Scanner.h"
+#include "SegReader.h"
+#include "ScanPool.h"
+#include "ByteSource.h"
+#include "CompiledDB.h"
+
+// Scans byte source ranges for the GUIDs of a compiled DB.
+// Ranges are read in chunks on the calling thread and scanned by the pool's
+// worker threads against the index over the DB keys. Hits are only collected
+// while scanning, then handed to a sink all at once in address order.
+// Nothing here touches IDA, the plug-in and the tools drive the same engine
+// through their own byte source and hit sink.
+class ScanEngine
+{
+public:
+	ScanEngine();
+	~ScanEngine();
+
+	// Build the index over a DB's keys, with their RFC 4122 byte order forms
+	// too if "bRFC4122". The DB has to stay open while the index is used.
+	// Kept as is if it was built from the same DB and order last time, so
+	// FreeIndex() has to be called when the DB is reloaded.
+	BOOL BuildIndex(const CompiledDB &rDB, BOOL bRFC4122);
+	void FreeIndex();
+	const GUIDIndex &GetIndex() const { return(m_Index); }
+
+	// Version of the DB contents, index options and scanner the hits depend on,
+	// for hits kept between runs. Set by BuildIndex().
+	ULONGLONG GetVersion() const { return(m_uVersion); }
+
+	// Start "uThreads" scan threads (0 = one per CPU); the index must be built
+	BOOL Start(UINT uThreads = 0);
+	void Stop();
+	UINT GetThreadCount() const { return(m_ScanPool.GetThreadCount()); }
+
+	// Scan a range of a byte source, see ScanBuffer() for "uStride" and "uFlags".
+	// "puFingerprint", if given, gets a hash of the range's bytes and the scan
+	// settings, made as the chunks are read. The same fingerprint and GetVersion()
+	// mean the same hits. Returns the range's hit count.
+	UINT ScanRange(ByteSource &rSource, ea_t startEA, ea_t endEA, UINT uStride, UINT uFlags, ULONGLONG *puFingerprint = NULL);
+	// Just the fingerprint ScanRange() would give, the bytes are hashed but not
+	// scanned. For checking a range is unchanged before scanning it.
+	ULONGLONG FingerprintRange(ByteSource &rSource, ea_t startEA, ea_t endEA, UINT uStride, UINT uFlags);
+	BOOL IsAborted() const { return(m_bAborted); }
+
+	// Hand the collected hits to a sink in address order; returns the count handed out
+	UINT ApplyHits(HitSink &rSink);
+
+	// Collected hits, in address order after ApplyHits()
+	const tSCANHIT *GetHits() const { return(m_pHits); }
+	UINT GetHitCount() const { return(m_uHitCount); }
+	// Hits found but lost to a failed allocation, the hits are incomplete if any
+	UINT GetDroppedCount() const { return(m_uDropped); }
+	ULONGLONG GetBytesRead() const { return(m_SegReader.GetBytesRead()); }
+
+	// Drop the hits and the counts for the next run
+	void Reset();
+
+	// qsort() order of hits: by address, then form, then entry, so hits
+	// sharing an address always come in the same order
+	static int __cdecl CompareHit(const void *pA, const void *pB);
+
+	// Map a scanner hit's index key to its DB entry and form, for pools
+	// scanning against this index; FALSE if it's not a DB GUID
+	BOOL MapHit(tSCANHIT &rHit) const
+	{
+		// An RFC 4122 order key is the entry (key - count).
+		// Text is parsed to Microsoft order, so a text hit on one isn't a DB GUID.
+		if(rHit.uKey >= m_uDBCount)
+		{
+			if(rHit.uForm != HIT_BINARY)
+				return(FALSE);
+			rHit.uKey -= m_uDBCount;
+			rHit.uForm = HIT_RFC4122;
+		}
+		return(TRUE);
+	}
+
+private:
+	GUIDIndex  m_Index;
+	const CompiledDB *m_pDB; // DB the index is over
+	UINT       m_uDBCount;
+	BOOL       m_bRFC4122;	 // Index has the RFC 4122 order keys too
+	ULONGLONG  m_uVersion;
+	SegReader  m_SegReader;
+	ScanPool   m_ScanPool;
+	tSCANHIT  *m_pHits;
+	UINT       m_uHitCount, m_uHitMax;
+	UINT       m_uDropped;
+	BOOL       m_bAborted;
+
+	void CollectHits(tCHUNKJOB *pJob);
+	static ULONGLONG GetFingerprint(const SegReader &rReader, ea_t startEA, ea_t endEA, UINT uStride, UINT uFlags);
+
+	// No copies
+	ScanEngine(const ScanEngine &);
+	void operator=(const ScanEngine &);
+};
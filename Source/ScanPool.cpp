@@ -0,0 +1,223 @@
+
+// ****************************************************************************
+// File: ScanPool.cpp
+// Desc: Worker thread pool for scanning segment chunks
+//
+// ****************************************************************************
+#include "StdAfx.h"
+#ifdef _WIN32
+#include <process.h>
+#endif
+#include "ScanPool.h"
+#include "SegReader.h"
+
+// Jobs per worker, so the main thread can fill one while the other is scanned
+#define JOBS_PER_THREAD 2
+
+
+ScanPool::ScanPool() : m_pIndex(NULL), m_uThreadCount(0), m_hPending(NULL), m_hDone(NULL), m_bQuit(FALSE)
+{
+	InitializeCriticalSection(&m_Lock);
+}
+
+ScanPool::~ScanPool()
+{
+	Stop();
+	DeleteCriticalSection(&m_Lock);
+}
+
+
+// Start "uThreads" workers (0 = one per CPU) scanning against "pIndex"
+BOOL ScanPool::Start(const GUIDIndex *pIndex, UINT uThreads)
+{
+	Stop();
+
+	if(uThreads == 0)
+	{
+		SYSTEM_INFO tInfo;
+		GetSystemInfo(&tInfo);
+		uThreads = tInfo.dwNumberOfProcessors;
+	}
+	if(uThreads < 1) uThreads = 1;
+	if(uThreads > MAX_THREADS) uThreads = MAX_THREADS;
+
+	m_pIndex = pIndex;
+	m_bQuit  = FALSE;
+	UINT uJobs = (uThreads * JOBS_PER_THREAD);
+	m_hPending = CreateSemaphore(NULL, 0, uJobs + MAX_THREADS, NULL);
+	m_hDone    = CreateSemaphore(NULL, 0, uJobs, NULL);
+	if(!m_hPending || !m_hDone)
+	{
+		Stop();
+		return(FALSE);
+	}
+
+	// Job buffers
+	for(UINT i = 0; i < uJobs; i++)
+	{
+		tCHUNKJOB *pJob = new tCHUNKJOB();
+		if(!pJob)
+			break;
+		ZeroMemory(pJob, sizeof(tCHUNKJOB));
+		if(!(pJob->pBuffer = (PBYTE) qalloc(SegReader::CHUNK_SIZE)))
+		{
+			delete pJob;
+			break;
+		}
+		m_FreeJobs.InsertTail(*pJob);
+	}
+	if(m_FreeJobs.IsEmpty())
+	{
+		Stop();
+		return(FALSE);
+	}
+
+	for(UINT i = 0; i < uThreads; i++)
+	{
+		if(HANDLE hThread = (HANDLE) _beginthreadex(NULL, 0, WorkerThread, this, 0, NULL))
+			m_ahThreads[m_uThreadCount++] = hThread;
+		else
+			break;
+	}
+	if(!m_uThreadCount)
+	{
+		Stop();
+		return(FALSE);
+	}
+
+	return(TRUE);
+}
+
+
+// Stop the workers and free the jobs. Jobs still queued are dropped.
+void ScanPool::Stop()
+{
+	if(m_uThreadCount)
+	{
+		m_bQuit = TRUE;
+		ReleaseSemaphore(m_hPending, m_uThreadCount, NULL);
+		WaitForMultipleObjects(m_uThreadCount, m_ahThreads, TRUE, INFINITE);
+		for(UINT i = 0; i < m_uThreadCount; i++)
+			CloseHandle(m_ahThreads[i]);
+		m_uThreadCount = 0;
+	}
+
+	FreeJobs();
+	if(m_hPending) { CloseHandle(m_hPending); m_hPending = NULL; }
+	if(m_hDone)    { CloseHandle(m_hDone);    m_hDone = NULL; }
+	m_pIndex = NULL;
+}
+
+void ScanPool::FreeJobs()
+{
+	JOBQUEUE *apQueue[] = { &m_FreeJobs, &m_PendingJobs, &m_DoneJobs };
+	for(UINT i = 0; i < (sizeof(apQueue) / sizeof(apQueue[0])); i++)
+	{
+		while(tCHUNKJOB *pJob = apQueue[i]->GetHead())
+		{
+			apQueue[i]->RemoveHead();
+			if(pJob->pBuffer) qfree(pJob->pBuffer);
+			if(pJob->pHits)   qfree(pJob->pHits);
+			delete pJob;
+		};
+	}
+}
+
+
+// Get an idle job to fill, or NULL if they're all in use
+tCHUNKJOB *ScanPool::GetFreeJob()
+{
+	EnterCriticalSection(&m_Lock);
+	tCHUNKJOB *pJob = m_FreeJobs.GetHead();
+	if(pJob)
+		m_FreeJobs.RemoveHead();
+	LeaveCriticalSection(&m_Lock);
+	return(pJob);
+}
+
+// Queue a filled job for scanning
+void ScanPool::Submit(tCHUNKJOB *pJob)
+{
+	pJob->uHitCount = pJob->uDropped = 0;
+	EnterCriticalSection(&m_Lock);
+	m_PendingJobs.InsertTail(*pJob);
+	LeaveCriticalSection(&m_Lock);
+	ReleaseSemaphore(m_hPending, 1, NULL);
+}
+
+// Get a scanned job, waiting up to "dwWait" milliseconds; NULL on time out
+tCHUNKJOB *ScanPool::GetDoneJob(DWORD dwWait)
+{
+	tCHUNKJOB *pJob = NULL;
+	if(WaitForSingleObject(m_hDone, dwWait) == WAIT_OBJECT_0)
+	{
+		EnterCriticalSection(&m_Lock);
+		if((pJob = m_DoneJobs.GetHead()) != NULL)
+			m_DoneJobs.RemoveHead();
+		LeaveCriticalSection(&m_Lock);
+	}
+	return(pJob);
+}
+
+// Return a job to the idle list once its hits are taken
+void ScanPool::Recycle(tCHUNKJOB *pJob)
+{
+	EnterCriticalSection(&m_Lock);
+	m_FreeJobs.InsertTail(*pJob);
+	LeaveCriticalSection(&m_Lock);
+}
+
+
+// Worker hit handler, collects hits in the job
+void ScanPool::JobHit(UINT uOffset, UINT uKey, UINT uForm, PVOID pContext)
+{
+	tCHUNKJOB *pJob = (tCHUNKJOB *) pContext;
+	if(pJob->uHitCount >= pJob->uHitMax)
+	{
+		UINT uMax = (pJob->uHitMax ? (pJob->uHitMax * 2) : 64);
+		tSCANHIT *pHits = (tSCANHIT *) qrealloc(pJob->pHits, (sizeof(tSCANHIT) * uMax));
+		if(!pHits)
+		{
+			pJob->uDropped++;
+			return;
+		}
+		pJob->pHits = pHits;
+		pJob->uHitMax = uMax;
+	}
+
+	pJob->pHits[pJob->uHitCount].ea = (pJob->ea + uOffset);
+	pJob->pHits[pJob->uHitCount].uKey = uKey;
+	pJob->pHits[pJob->uHitCount].uForm = uForm;
+	pJob->uHitCount++;
+}
+
+// Scan thread
+unsigned __stdcall ScanPool::WorkerThread(PVOID pParam)
+{
+	ScanPool *pPool = (ScanPool *) pParam;
+	for(;;)
+	{
+		WaitForSingleObject(pPool->m_hPending, INFINITE);
+		if(pPool->m_bQuit)
+			break;
+
+		EnterCriticalSection(&pPool->m_Lock);
+		tCHUNKJOB *pJob = pPool->m_PendingJobs.GetHead();
+		if(pJob)
+			pPool->m_PendingJobs.RemoveHead();
+		LeaveCriticalSection(&pPool->m_Lock);
+
+		if(pJob)
+		{
+			UINT uFirst = ((pJob->uStride - (pJob->ea % pJob->uStride)) % pJob->uStride);
+			ScanBuffer(*pPool->m_pIndex, pJob->pBuffer, pJob->uSize, uFirst, pJob->uStride, pJob->uFlags, pJob->uKeep, JobHit, pJob);
+
+			EnterCriticalSection(&pPool->m_Lock);
+			pPool->m_DoneJobs.InsertTail(*pJob);
+			LeaveCriticalSection(&pPool->m_Lock);
+			ReleaseSemaphore(pPool->m_hDone, 1, NULL);
+		}
+	};
+
+	return(0);
+}
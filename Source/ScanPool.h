@@ -0,0 +1,114 @@
+
+// ****************************************************************************
+// File: ScanPool.h
+// Desc: Worker thread pool for scanning segment chunks
+//
+// ****************************************************************************
+#pragma once
+#include "Scanner.h"
+
+// A scan hit
+struct tSCANHIT
+{
+	ea_t ea;
+	UINT uKey;  // Index key position, the DB entry
+	UINT uForm; // eHITFORM
+};
+
+// Chunk scan job.
+// The main thread fills the buffer and submits it, a worker scans it and
+// collects the hits, then the main thread takes the hits and recycles it.
+struct tCHUNKJOB
+{
+	tCHUNKJOB *pNext; // Queue link
+	PBYTE pBuffer;	// Chunk bytes, SegReader::CHUNK_SIZE
+	ea_t  ea;		// Address of the first byte
+	UINT  uSize;	// Bytes in the buffer
+	UINT  uKeep;	// Leading bytes carried over from the last chunk
+	UINT  uStride;	// Scan stride
+	UINT  uFlags;	// Scan flags
+
+	tSCANHIT *pHits;
+	UINT  uHitCount;
+	UINT  uHitMax;
+	UINT  uDropped;	// Hits the list couldn't take
+
+	// Use IDA allocs
+	static PVOID operator new(size_t size){	return(qalloc(size)); };
+	static void operator delete(PVOID _Ptr){ return(qfree(_Ptr)); }
+};
+
+// Pool of scan threads sharing one read only GUID index.
+// Only the main thread touches the IDB; workers only see chunk buffers.
+class ScanPool
+{
+public:
+	enum { MAX_THREADS = 64 };
+
+	ScanPool();
+	~ScanPool();
+
+	// Start "uThreads" workers (0 = one per CPU) scanning against "pIndex"
+	BOOL Start(const GUIDIndex *pIndex, UINT uThreads = 0);
+	void Stop();
+
+	UINT GetThreadCount() const { return(m_uThreadCount); }
+
+	// Get an idle job to fill, or NULL if they're all in use
+	tCHUNKJOB *GetFreeJob();
+
+	// Queue a filled job for scanning
+	void Submit(tCHUNKJOB *pJob);
+
+	// Get a scanned job, waiting up to "dwWait" milliseconds; NULL on time out
+	tCHUNKJOB *GetDoneJob(DWORD dwWait);
+
+	// Return a job to the idle list once its hits are taken
+	void Recycle(tCHUNKJOB *pJob);
+
+private:
+	// Job FIFO, linked through the jobs. Not the Container queue, so the pool
+	// builds with compilers other than MSVC too.
+	struct JOBQUEUE
+	{
+		tCHUNKJOB *m_pHead, *m_pTail;
+
+		JOBQUEUE() : m_pHead(NULL), m_pTail(NULL) {}
+		BOOL IsEmpty() const { return(m_pHead == NULL); }
+		tCHUNKJOB *GetHead() const { return(m_pHead); }
+		void InsertTail(tCHUNKJOB &rJob)
+		{
+			rJob.pNext = NULL;
+			if(m_pTail)
+				m_pTail->pNext = &rJob;
+			else
+				m_pHead = &rJob;
+			m_pTail = &rJob;
+		}
+		void RemoveHead()
+		{
+			if((m_pHead = m_pHead->pNext) == NULL)
+				m_pTail = NULL;
+		}
+	};
+
+	static unsigned __stdcall WorkerThread(PVOID pParam);
+	static void JobHit(UINT uOffset, UINT uKey, UINT uForm, PVOID pContext);
+	void FreeJobs();
+
+	const GUIDIndex *m_pIndex;
+	HANDLE m_ahThreads[MAX_THREADS];
+	UINT   m_uThreadCount;
+
+	CRITICAL_SECTION m_Lock; // Guards the queues
+	JOBQUEUE m_FreeJobs;
+	JOBQUEUE m_PendingJobs;
+	JOBQUEUE m_DoneJobs;
+	HANDLE m_hPending;		 // Semaphore, count of pending jobs
+	HANDLE m_hDone;			 // Semaphore, count of done jobs
+	volatile BOOL m_bQuit;
+
+	// No copies
+	ScanPool(const ScanPool &);
+	void operator=(const ScanPool &);
+};
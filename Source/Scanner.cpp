@@ -0,0 +1,611 @@
+
+// ****************************************************************************
+// File: Scanner.cpp
+// Desc: GUID index and single pass byte scanner
+//
+// ****************************************************************************
+#include "StdAfx.h"
+#include "Scanner.h"
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#include <emmintrin.h>
+
+// AVX2 intrinsics need VS2012 or better, GCC builds just the AVX2 kernels for it
+#if (_MSC_VER >= 1700)
+#include <immintrin.h>
+#define SCAN_HAS_AVX2
+#define AVX2_FUNC
+#elif defined(__GNUC__)
+#include <immintrin.h>
+#define SCAN_HAS_AVX2
+#define AVX2_FUNC __attribute__((target("avx2")))
+#endif
+
+// Prefilter bitmap size range, in bits (as a power of 2)
+#define FILTER_MIN_BITS 16
+#define FILTER_MAX_BITS 24
+
+// Buffer slice size, small enough that the text scan reads it from the L1 cache behind the binary one
+#define SLICE_SIZE (16 * 1024)
+
+static eSCANKERNEL s_eKernel = SCAN_SCALAR;
+static BOOL s_bKernelSet = FALSE;
+
+// Key + position pair for sorting
+struct tSORTPAIR
+{
+	GUID Key;
+	UINT uPosition;
+};
+
+// By key, then by position so of equal keys the first given is found
+static int __cdecl ComparePair(const void *pA, const void *pB)
+{
+	const tSORTPAIR *pPairA = (const tSORTPAIR *) pA;
+	const tSORTPAIR *pPairB = (const tSORTPAIR *) pB;
+	int iResult = memcmp(&pPairA->Key, &pPairB->Key, sizeof(GUID));
+	if(!iResult)
+		iResult = ((pPairA->uPosition < pPairB->uPosition) ? -1 : (pPairA->uPosition > pPairB->uPosition));
+	return(iResult);
+}
+
+
+GUIDIndex::GUIDIndex() : m_pKeys(NULL), m_pSorted(NULL), m_puOrder(NULL), m_puDir(NULL), m_uCount(0), m_puFilter(NULL), m_uFilterShift(32 - FILTER_MIN_BITS)
+{
+}
+
+GUIDIndex::~GUIDIndex()
+{
+	Clear();
+}
+
+void GUIDIndex::Clear()
+{
+	if(m_pSorted) { qfree(m_pSorted); m_pSorted = NULL; }
+	if(m_puOrder) { qfree(m_puOrder); m_puOrder = NULL; }
+	if(m_puDir)   { qfree(m_puDir);   m_puDir   = NULL; }
+	if(m_puFilter) { qfree(m_puFilter); m_puFilter = NULL; }
+	m_pKeys  = NULL;
+	m_uCount = 0;
+}
+
+
+// Build index over a key array
+BOOL GUIDIndex::Build(const GUID *pKeys, UINT uCount)
+{
+	Clear();
+
+	if(!(m_puDir = (UINT *) qalloc(sizeof(UINT) * DIR_SIZE)))
+		return(FALSE);
+
+	// Use the keys in place if they're already sorted
+	UINT uSorted = 1;
+	while((uSorted < uCount) && (memcmp(&pKeys[uSorted - 1], &pKeys[uSorted], sizeof(GUID)) <= 0))
+		uSorted++;
+	if(uSorted >= uCount)
+		m_pKeys = pKeys;
+	else
+	{
+		// Sorted copy, keeping each key's position
+		tSORTPAIR *pPairs = (tSORTPAIR *) qalloc(sizeof(tSORTPAIR) * uCount);
+		m_pSorted = (GUID *) qalloc(sizeof(GUID) * uCount);
+		m_puOrder = (UINT *) qalloc(sizeof(UINT) * uCount);
+		if(!pPairs || !m_pSorted || !m_puOrder)
+		{
+			if(pPairs) qfree(pPairs);
+			Clear();
+			return(FALSE);
+		}
+
+		for(UINT i = 0; i < uCount; i++)
+		{
+			pPairs[i].Key = pKeys[i];
+			pPairs[i].uPosition = i;
+		}
+		qsort(pPairs, uCount, sizeof(tSORTPAIR), ComparePair);
+
+		for(UINT i = 0; i < uCount; i++)
+		{
+			m_pSorted[i] = pPairs[i].Key;
+			m_puOrder[i] = pPairs[i].uPosition;
+		}
+		qfree(pPairs);
+		m_pKeys = m_pSorted;
+	}
+	m_uCount = uCount;
+
+	// Directory on the first two key bytes, in memory order.
+	// Since keys are sorted bytewise, each prefix is one contiguous range.
+	UINT uKey = 0;
+	for(UINT uPrefix = 0; uPrefix < (DIR_SIZE - 1); uPrefix++)
+	{
+		m_puDir[uPrefix] = uKey;
+		while(uKey < uCount)
+		{
+			const BYTE *pKey = (const BYTE *) &m_pKeys[uKey];
+			if(((UINT) ((pKey[0] << 8) | pKey[1])) != uPrefix)
+				break;
+			uKey++;
+		}
+	}
+	m_puDir[DIR_SIZE - 1] = uCount;
+
+	// Prefilter bitmap, sized for about 1/16 bit density
+	UINT uBits = FILTER_MIN_BITS;
+	while((uBits < FILTER_MAX_BITS) && ((1U << uBits) < (uCount * 16)))
+		uBits++;
+	m_uFilterShift = (32 - uBits);
+	if(!(m_puFilter = (UINT *) qcalloc(((1U << uBits) / 32), sizeof(UINT))))
+	{
+		Clear();
+		return(FALSE);
+	}
+	for(UINT i = 0; i < uCount; i++)
+	{
+		UINT uHash = FilterHash((const BYTE *) &m_pKeys[i]);
+		m_puFilter[uHash >> 5] |= (1U << (uHash & 31));
+	}
+
+	return(TRUE);
+}
+
+
+// ----------------------------------------------------------------------------
+// Scan kernels
+// Each kernel tests a run of offsets against the prefilter, producing a bit
+// mask of candidate offsets. Only candidates get the full key look up, so
+// every kernel gives the exact same hits as the plain scalar loop.
+// The SIMD kernels return the first offset they did not process, the rest is
+// left to the scalar loop.
+
+// Scan state shared by the kernels
+struct tSCANJOB
+{
+	const GUIDIndex *pIndex;
+	const BYTE *pData;
+	UINT  uSize;
+	UINT  uStride;
+	UINT  uFlags;
+	UINT  uKeep;
+	SCANHITPROC pfnHit;
+	PVOID pContext;
+	UINT  uHits;
+};
+
+// Full look up of a candidate offset
+static __forceinline void ScanOffset(tSCANJOB &rJob, UINT uOffset)
+{
+	UINT uKey = rJob.pIndex->Find(rJob.pData + uOffset);
+	if(uKey != GUIDIndex::NOT_FOUND)
+	{
+		rJob.pfnHit(uOffset, uKey, HIT_BINARY, rJob.pContext);
+		rJob.uHits++;
+	}
+}
+
+// Full look up of the candidates in a block mask, bit n is offset (uOffset + (n * uStride))
+static __forceinline void ScanMask(tSCANJOB &rJob, UINT uOffset, UINT uMask)
+{
+	while(uMask)
+	{
+		ULONG uBit;
+		_BitScanForward(&uBit, uMask);
+		uMask &= (uMask - 1);
+		ScanOffset(rJob, (uOffset + (uBit * rJob.uStride)));
+	}
+}
+
+// Scalar: test offsets [uOffset, uEnd) one stride at a time
+static void ScanScalar(tSCANJOB &rJob, UINT uOffset, UINT uEnd)
+{
+	const GUIDIndex &rIndex = *rJob.pIndex;
+	for(; uOffset < uEnd; uOffset += rJob.uStride)
+	{
+		if(rIndex.IsCandidate(rJob.pData + uOffset))
+			ScanOffset(rJob, uOffset);
+	}
+}
+
+// SSE2 has no 32bit multiply low, emulate it
+static __forceinline __m128i MulLo32(__m128i a, __m128i b)
+{
+	__m128i t0 = _mm_mul_epu32(a, b);
+	__m128i t1 = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+	return(_mm_unpacklo_epi32(_mm_shuffle_epi32(t0, _MM_SHUFFLE(0,0,2,0)), _mm_shuffle_epi32(t1, _MM_SHUFFLE(0,0,2,0))));
+}
+
+// Test 4 hashes against the bitmap, bit n of the result is lane n
+static __forceinline UINT TestFilter4(const UINT *puFilter, __m128i H)
+{
+	ALIGN(16) UINT auHash[4];
+	_mm_store_si128((__m128i *) auHash, H);
+	return(((puFilter[auHash[0] >> 5] >> (auHash[0] & 31)) & 1) |
+		   (((puFilter[auHash[1] >> 5] >> (auHash[1] & 31)) & 1) << 1) |
+		   (((puFilter[auHash[2] >> 5] >> (auHash[2] & 31)) & 1) << 2) |
+		   (((puFilter[auHash[3] >> 5] >> (auHash[3] & 31)) & 1) << 3));
+}
+
+// SSE2, every offset: hash 16 offsets per step, bitmap tests are scalar.
+static UINT ScanSSE2(tSCANJOB &rJob, UINT uOffset, UINT uEnd)
+{
+	const UINT *puFilter = rJob.pIndex->GetFilter();
+	const __m128i K1 = _mm_set1_epi32(PREFILTER_K1);
+	const __m128i K2 = _mm_set1_epi32(PREFILTER_K2);
+	const __m128i Shift = _mm_cvtsi32_si128(rJob.pIndex->GetFilterShift());
+
+	// Reads up to 23 bytes past the block start
+	for(; (uOffset + 16) <= uEnd; uOffset += 16)
+	{
+		const BYTE *p = (rJob.pData + uOffset);
+		UINT uMask = 0;
+		for(UINT k = 0; k < 4; k++)
+		{
+			// Lanes are offsets k, k+4, k+8, k+12
+			__m128i D1 = _mm_loadu_si128((const __m128i *) (p + k));
+			__m128i D2 = _mm_loadu_si128((const __m128i *) (p + k + 4));
+			__m128i H  = _mm_srl_epi32(_mm_xor_si128(MulLo32(D1, K1), MulLo32(D2, K2)), Shift);
+			UINT uLanes = TestFilter4(puFilter, H);
+			uMask |= ((((uLanes & 1) | ((uLanes & 2) << 3) | ((uLanes & 4) << 6) | ((uLanes & 8) << 9))) << k);
+		}
+
+		if(uMask)
+			ScanMask(rJob, uOffset, uMask);
+	}
+
+	return(uOffset);
+}
+
+// SSE2, 4 or 8 byte stride: 4 offsets per step.
+static UINT ScanSSE2Stride(tSCANJOB &rJob, UINT uOffset, UINT uEnd)
+{
+	const UINT *puFilter = rJob.pIndex->GetFilter();
+	const __m128i K1 = _mm_set1_epi32(PREFILTER_K1);
+	const __m128i K2 = _mm_set1_epi32(PREFILTER_K2);
+	const __m128i Shift = _mm_cvtsi32_si128(rJob.pIndex->GetFilterShift());
+	UINT uStep = (rJob.uStride * 4);
+
+	// Reads up to 32 bytes past the block start, last lane needs its full 16 bytes
+	for(; ((uOffset + uStep + 16) <= rJob.uSize) && ((uOffset + uStep) <= uEnd); uOffset += uStep)
+	{
+		const BYTE *p = (rJob.pData + uOffset);
+		__m128i D1, D2;
+		if(rJob.uStride == 4)
+		{
+			// Lanes are offsets 0, 4, 8, 12
+			D1 = _mm_loadu_si128((const __m128i *) p);
+			D2 = _mm_loadu_si128((const __m128i *) (p + 4));
+		}
+		else
+		{
+			// Lanes are offsets 0, 8, 16, 24; pick even and odd dwords
+			__m128 A = _mm_castsi128_ps(_mm_loadu_si128((const __m128i *) p));
+			__m128 B = _mm_castsi128_ps(_mm_loadu_si128((const __m128i *) (p + 16)));
+			D1 = _mm_castps_si128(_mm_shuffle_ps(A, B, _MM_SHUFFLE(2,0,2,0)));
+			D2 = _mm_castps_si128(_mm_shuffle_ps(A, B, _MM_SHUFFLE(3,1,3,1)));
+		}
+
+		__m128i H = _mm_srl_epi32(_mm_xor_si128(MulLo32(D1, K1), MulLo32(D2, K2)), Shift);
+		if(UINT uMask = TestFilter4(puFilter, H))
+			ScanMask(rJob, uOffset, uMask);
+	}
+
+	return(uOffset);
+}
+
+#ifdef SCAN_HAS_AVX2
+// Test 8 hashes against the bitmap with a gather, bit n of the result is lane n
+static __forceinline AVX2_FUNC UINT TestFilter8(const int *piFilter, __m256i H)
+{
+	// Move each hash's bitmap bit up to the sign bit
+	const __m256i Low5 = _mm256_set1_epi32(31);
+	__m256i W = _mm256_i32gather_epi32(piFilter, _mm256_srli_epi32(H, 5), 4);
+	W = _mm256_sllv_epi32(W, _mm256_sub_epi32(Low5, _mm256_and_si256(H, Low5)));
+	return((UINT) _mm256_movemask_ps(_mm256_castsi256_ps(W)));
+}
+
+// AVX2, every offset: hash 8 offsets per step and test them with a bitmap gather.
+static AVX2_FUNC UINT ScanAVX2(tSCANJOB &rJob, UINT uOffset, UINT uEnd)
+{
+	const int *piFilter = (const int *) rJob.pIndex->GetFilter();
+	const __m256i K1 = _mm256_set1_epi32(PREFILTER_K1);
+	const __m256i K2 = _mm256_set1_epi32(PREFILTER_K2);
+	const __m128i Shift = _mm_cvtsi32_si128(rJob.pIndex->GetFilterShift());
+	// Spread 11 bytes into the dwords at offsets 0..3 (low lane) and 4..7 (high lane)
+	const __m256i Spread = _mm256_setr_epi8(0,1,2,3, 1,2,3,4, 2,3,4,5, 3,4,5,6,  4,5,6,7, 5,6,7,8, 6,7,8,9, 7,8,9,10);
+
+	// Reads up to 20 bytes past the block start
+	for(; (uOffset + 16) <= uEnd; uOffset += 8)
+	{
+		const BYTE *p = (rJob.pData + uOffset);
+		__m256i D1 = _mm256_shuffle_epi8(_mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *) p)), Spread);
+		__m256i D2 = _mm256_shuffle_epi8(_mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *) (p + 4))), Spread);
+		__m256i H  = _mm256_srl_epi32(_mm256_xor_si256(_mm256_mullo_epi32(D1, K1), _mm256_mullo_epi32(D2, K2)), Shift);
+		if(UINT uMask = TestFilter8(piFilter, H))
+			ScanMask(rJob, uOffset, uMask);
+	}
+
+	return(uOffset);
+}
+
+// AVX2, 4 byte stride: 8 offsets per step.
+static AVX2_FUNC UINT ScanAVX2Stride4(tSCANJOB &rJob, UINT uOffset, UINT uEnd)
+{
+	const int *piFilter = (const int *) rJob.pIndex->GetFilter();
+	const __m256i K1 = _mm256_set1_epi32(PREFILTER_K1);
+	const __m256i K2 = _mm256_set1_epi32(PREFILTER_K2);
+	const __m128i Shift = _mm_cvtsi32_si128(rJob.pIndex->GetFilterShift());
+
+	// Reads up to 36 bytes past the block start, last lane needs its full 16 bytes
+	for(; ((uOffset + 32 + 16) <= rJob.uSize) && ((uOffset + 32) <= uEnd); uOffset += 32)
+	{
+		const BYTE *p = (rJob.pData + uOffset);
+		__m256i D1 = _mm256_loadu_si256((const __m256i *) p);
+		__m256i D2 = _mm256_loadu_si256((const __m256i *) (p + 4));
+		__m256i H  = _mm256_srl_epi32(_mm256_xor_si256(_mm256_mullo_epi32(D1, K1), _mm256_mullo_epi32(D2, K2)), Shift);
+		if(UINT uMask = TestFilter8(piFilter, H))
+			ScanMask(rJob, uOffset, uMask);
+	}
+
+	return(uOffset);
+}
+#endif
+
+
+// ----------------------------------------------------------------------------
+// Text GUIDs
+// Registry form text has its dashes at fixed char positions 8, 13, 18 and 23.
+// The SIMD kernel finds the offsets with all 4 dashes in place, for ASCII and
+// UTF-16LE at once, from dash and zero byte bitmaps over a 64 byte window.
+// Only those few offsets get the full hex parse and index look up.
+
+// Byte position in the GUID of each registry form digit pair, Data1-3 are little endian
+static const BYTE s_abTextOrder[16] = { 3,2,1,0, 5,4, 7,6, 8,9, 10,11,12,13,14,15 };
+
+// Hex digit value, or > 15 if it's not one
+static __forceinline UINT HexValue(BYTE c)
+{
+	UINT uValue = (UINT) (c - '0');
+	if(uValue > 9)
+	{
+		uValue = (UINT) ((c | 0x20) - 'a');
+		uValue = ((uValue <= 5) ? (uValue + 10) : 16);
+	}
+	return(uValue);
+}
+
+// Char at "p" a hex digit or dash, "uStep" is the char size
+static __forceinline BOOL IsTextGUIDChar(const BYTE *p, UINT uStep)
+{
+	return(((uStep == 1) || !p[1]) && ((p[0] == '-') || (HexValue(p[0]) <= 15)));
+}
+
+// Parse and look up the text GUID at "uOffset", "uStep" is the char size
+static void ScanTextAt(tSCANJOB &rJob, UINT uOffset, UINT uStep)
+{
+	UINT uLength = (TEXT_GUID_LENGTH * uStep);
+	if((uOffset + uLength) > rJob.uSize)
+		return;
+
+	// The previous buffer saw it and the char after it, it's that buffer's.
+	// One without the char after it leaves it to the next, unless the run ends here.
+	// The overlap holds a char either side, so the char before is always seen.
+	if((uOffset + uLength + uStep) <= rJob.uKeep)
+		return;
+	BOOL bAfter = ((uOffset + uLength + uStep) <= rJob.uSize);
+	if(!bAfter && (rJob.uFlags & SCAN_MORE))
+		return;
+
+	// Not part of a longer run of digits and dashes
+	const BYTE *p = (rJob.pData + uOffset);
+	if((uOffset >= uStep) && IsTextGUIDChar((p - uStep), uStep))
+		return;
+	if(bAfter && IsTextGUIDChar((p + uLength), uStep))
+		return;
+
+	BYTE abGUID[16];
+	UINT uDigits = 0;
+	for(UINT i = 0; i < TEXT_GUID_LENGTH; i++, p += uStep)
+	{
+		if((uStep == 2) && p[1])
+			return;
+		if((i == 8) || (i == 13) || (i == 18) || (i == 23))
+		{
+			if(*p != '-')
+				return;
+		}
+		else
+		{
+			UINT uValue = HexValue(*p);
+			if(uValue > 15)
+				return;
+			if(uDigits & 1)
+				abGUID[s_abTextOrder[uDigits >> 1]] |= (BYTE) uValue;
+			else
+				abGUID[s_abTextOrder[uDigits >> 1]] = (BYTE) (uValue << 4);
+			uDigits++;
+		}
+	}
+
+	UINT uKey = rJob.pIndex->Find(abGUID);
+	if(uKey != GUIDIndex::NOT_FOUND)
+	{
+		rJob.pfnHit(uOffset, uKey, ((uStep == 2) ? HIT_UTF16 : HIT_ASCII), rJob.pContext);
+		rJob.uHits++;
+	}
+}
+
+// Scalar: test text offsets [uOffset, uEnd)
+static void ScanTextScalar(tSCANJOB &rJob, UINT uOffset, UINT uEnd)
+{
+	for(; uOffset < uEnd; uOffset++)
+	{
+		const BYTE *p = (rJob.pData + uOffset);
+		UINT uLeft = (rJob.uSize - uOffset);
+		if((uLeft >= TEXT_GUID_LENGTH) && (p[8] == '-') && (p[13] == '-') && (p[18] == '-') && (p[23] == '-'))
+			ScanTextAt(rJob, uOffset, 1);
+		if((uLeft >= (TEXT_GUID_LENGTH * 2)) && (p[16] == '-') && (p[26] == '-') && (p[36] == '-') && (p[46] == '-'))
+			ScanTextAt(rJob, uOffset, 2);
+	}
+}
+
+// Full look up of the text candidates in a block mask, bit n is offset (uOffset + n)
+static __forceinline void ScanTextMask(tSCANJOB &rJob, UINT uOffset, UINT uMask, UINT uStep)
+{
+	while(uMask)
+	{
+		ULONG uBit;
+		_BitScanForward(&uBit, uMask);
+		uMask &= (uMask - 1);
+		ScanTextAt(rJob, (uOffset + uBit), uStep);
+	}
+}
+
+// SSE2: 16 text offsets per step. One load per step, the window slides over it.
+static UINT ScanTextSSE2(tSCANJOB &rJob, UINT uOffset, UINT uEnd)
+{
+	const __m128i Dash = _mm_set1_epi8('-');
+	const __m128i Zero = _mm_setzero_si128();
+	if((uOffset + 64) > rJob.uSize)
+		return(uOffset);
+
+	// Dash and zero byte bitmaps, bit n is byte (uOffset + n)
+	ULONGLONG uDash = 0, uZero = 0;
+	for(UINT k = 0; k < 64; k += 16)
+	{
+		__m128i D = _mm_loadu_si128((const __m128i *) (rJob.pData + uOffset + k));
+		uDash |= ((ULONGLONG) (UINT) _mm_movemask_epi8(_mm_cmpeq_epi8(D, Dash)) << k);
+		uZero |= ((ULONGLONG) (UINT) _mm_movemask_epi8(_mm_cmpeq_epi8(D, Zero)) << k);
+	}
+
+	for(; ((uOffset + 16) <= uEnd) && ((uOffset + 64) <= rJob.uSize); uOffset += 16)
+	{
+		// ASCII dashes 5 apart after the first 8 chars, UTF-16 ones 10 apart with a zero high byte
+		ULONGLONG uDash16 = (uDash & (uZero >> 1));
+		if(UINT uMask = ((UINT) ((uDash >> 8) & (uDash >> 13) & (uDash >> 18) & (uDash >> 23)) & 0xFFFF))
+			ScanTextMask(rJob, uOffset, uMask, 1);
+		if(UINT uMask = ((UINT) ((uDash16 >> 16) & (uDash16 >> 26) & (uDash16 >> 36) & (uDash16 >> 46)) & 0xFFFF))
+			ScanTextMask(rJob, uOffset, uMask, 2);
+
+		// Slide the window
+		uDash >>= 16;
+		uZero >>= 16;
+		if((uOffset + 80) <= rJob.uSize)
+		{
+			__m128i D = _mm_loadu_si128((const __m128i *) (rJob.pData + uOffset + 64));
+			uDash |= ((ULONGLONG) (UINT) _mm_movemask_epi8(_mm_cmpeq_epi8(D, Dash)) << 48);
+			uZero |= ((ULONGLONG) (UINT) _mm_movemask_epi8(_mm_cmpeq_epi8(D, Zero)) << 48);
+		}
+	}
+
+	return(uOffset);
+}
+
+
+// Select scan kernel, clamped to what the CPU supports; returns the one in use.
+eSCANKERNEL SetScanKernel(eSCANKERNEL eWanted)
+{
+	int aiInfo[4];
+	__cpuid(aiInfo, 0);
+	int iMaxLeaf = aiInfo[0];
+
+	__cpuid(aiInfo, 1);
+	BOOL bSSE2 = ((aiInfo[3] & (1 << 26)) != 0);
+	BOOL bAVX2 = FALSE;
+	#ifdef SCAN_HAS_AVX2
+	// OS must save the YMM state too
+	if((aiInfo[2] & (1 << 27)) && (aiInfo[2] & (1 << 28)) && ((_xgetbv(0) & 6) == 6) && (iMaxLeaf >= 7))
+	{
+		__cpuidex(aiInfo, 7, 0);
+		bAVX2 = ((aiInfo[1] & (1 << 5)) != 0);
+	}
+	#endif
+
+	if((eWanted == SCAN_AVX2) && !bAVX2)
+		eWanted = SCAN_SSE2;
+	if((eWanted == SCAN_SSE2) && !bSSE2)
+		eWanted = SCAN_SCALAR;
+
+	s_eKernel = eWanted;
+	s_bKernelSet = TRUE;
+	return(s_eKernel);
+}
+
+LPCSTR GetScanKernelName(eSCANKERNEL eKernel)
+{
+	switch(eKernel)
+	{
+		case SCAN_SSE2: return("SSE2");
+		case SCAN_AVX2: return("AVX2");
+		default: return("Scalar");
+	};
+}
+
+
+// Binary kernel for the scan, returns the first offset not processed
+static UINT ScanBinary(tSCANJOB &rJob, UINT uOffset, UINT uEnd)
+{
+	if(rJob.uStride == 1)
+	{
+		switch(s_eKernel)
+		{
+			#ifdef SCAN_HAS_AVX2
+			case SCAN_AVX2: uOffset = ScanAVX2(rJob, uOffset, uEnd); break;
+			#endif
+			case SCAN_SSE2: uOffset = ScanSSE2(rJob, uOffset, uEnd); break;
+			default: break;
+		};
+	}
+	else
+	if((rJob.uStride == 4) || (rJob.uStride == 8))
+	{
+		// No AVX2 kernel for 8, the SSE2 one does it
+		#ifdef SCAN_HAS_AVX2
+		if((s_eKernel == SCAN_AVX2) && (rJob.uStride == 4))
+			uOffset = ScanAVX2Stride4(rJob, uOffset, uEnd);
+		else
+		#endif
+		if(s_eKernel >= SCAN_SSE2)
+			uOffset = ScanSSE2Stride(rJob, uOffset, uEnd);
+	}
+
+	return(uOffset);
+}
+
+// Test 16 byte windows of a buffer against the index; returns hit count.
+// Only offsets (uFirst + (n * uStride)) are tested, a stride of 1 tests every offset.
+// With SCAN_TEXT registry form text GUIDs are found in the same pass.
+UINT ScanBuffer(const GUIDIndex &rIndex, const BYTE *pData, UINT uSize, UINT uFirst, UINT uStride, UINT uFlags, UINT uKeep, SCANHITPROC pfnHit, PVOID pContext)
+{
+	if(!s_bKernelSet)
+		SetScanKernel(SCAN_AVX2);
+
+	tSCANJOB Job = { &rIndex, pData, uSize, uStride, uFlags, uKeep, pfnHit, pContext, 0 };
+	if((uSize >= sizeof(GUID)) && !rIndex.IsEmpty())
+	{
+		// Offsets [0, uEnd) have a full 16 bytes.
+		// The ones wholly in the kept bytes were scanned with the last buffer.
+		UINT uEnd = ((uSize - sizeof(GUID)) + 1);
+		UINT uOffset = uFirst;
+		if((uKeep >= sizeof(GUID)) && (uOffset < (uKeep - (sizeof(GUID) - 1))))
+			uOffset += (((((uKeep - (sizeof(GUID) - 1)) - uOffset) + (uStride - 1)) / uStride) * uStride);
+		BOOL bText = ((uFlags & SCAN_TEXT) && (s_eKernel != SCAN_SCALAR));
+		UINT uText = 0;
+
+		// A slice at a time, so the text kernel reads it from the cache
+		for(UINT uSlice = 0; uSlice < uSize; uSlice += SLICE_SIZE)
+		{
+			UINT uSliceEnd = (((uSize - uSlice) > SLICE_SIZE) ? (uSlice + SLICE_SIZE) : uSize);
+			uOffset = ScanBinary(Job, uOffset, ((uSliceEnd < uEnd) ? uSliceEnd : uEnd));
+			if(bText)
+				uText = ScanTextSSE2(Job, uText, uSliceEnd);
+		}
+
+		// Remainder
+		ScanScalar(Job, uOffset, uEnd);
+		if(uFlags & SCAN_TEXT)
+			ScanTextScalar(Job, uText, uSize);
+	}
+
+	return(Job.uHits);
+}
@@ -0,0 +1,129 @@
+
+// ****************************************************************************
+// File: Scanner.h
+// Desc: GUID index and single pass byte scanner
+//
+// ****************************************************************************
+#pragma once
+
+// Candidate prefilter hash constants
+#define PREFILTER_K1 0x9E3779B1
+#define PREFILTER_K2 0x85EBCA77
+
+// Sorted GUID key index.
+// The index is just the flat array of 16 byte keys, a radix directory on the
+// first two key bytes that narrows each look up to a handful of keys, and a
+// bitmap over a hash of the first 8 key bytes (Data1, Data2 and Data3) that
+// lets the scanner reject most offsets before touching the keys.
+// A look up gives the key's position in the caller's key array, so per key
+// data (labels, types, etc.) stays in the caller's parallel arrays and off
+// the hot path. Already sorted keys are used in place, not copied.
+class GUIDIndex
+{
+public:
+	enum { NOT_FOUND = ((UINT) -1) };
+
+	GUIDIndex();
+	~GUIDIndex();
+
+	// Build index over a key array. If the keys are sorted bytewise they must
+	// stay valid while the index is used, otherwise a sorted copy is made.
+	// Of equal keys, the one first in the array is the one found.
+	BOOL Build(const GUID *pKeys, UINT uCount);
+	void Clear();
+
+	UINT GetCount() const { return(m_uCount); }
+	BOOL IsEmpty() const { return(m_uCount == 0); }
+
+	// Returns the key array position of the 16 bytes at "pData", or NOT_FOUND
+	__forceinline UINT Find(const BYTE *pData) const
+	{
+		UINT uPrefix = ((pData[0] << 8) | pData[1]);
+		for(UINT i = m_puDir[uPrefix], uEnd = m_puDir[uPrefix + 1]; i < uEnd; i++)
+		{
+			const UINT *puKey  = (const UINT *) &m_pKeys[i];
+			const UINT *puData = (const UINT *) pData;
+			if((puKey[0] == puData[0]) && (puKey[1] == puData[1]) && (puKey[2] == puData[2]) && (puKey[3] == puData[3]))
+				return(m_puOrder ? m_puOrder[i] : i);
+		}
+		return(NOT_FOUND);
+	}
+
+	// Prefilter hash of the first 8 bytes at "pData"
+	__forceinline UINT FilterHash(const BYTE *pData) const
+	{
+		const UINT *puData = (const UINT *) pData;
+		return(((puData[0] * PREFILTER_K1) ^ (puData[1] * PREFILTER_K2)) >> m_uFilterShift);
+	}
+
+	// Returns TRUE if the 16 bytes at "pData" might be in the index
+	__forceinline BOOL IsCandidate(const BYTE *pData) const
+	{
+		UINT uHash = FilterHash(pData);
+		return((m_puFilter[uHash >> 5] >> (uHash & 31)) & 1);
+	}
+
+	const UINT *GetFilter() const { return(m_puFilter); }
+	UINT GetFilterShift() const { return(m_uFilterShift); }
+
+private:
+	enum { DIR_SIZE = (0x10000 + 1) };
+
+	const GUID *m_pKeys; // Sorted keys
+	GUID  *m_pSorted;	 // Sorted copy, when the keys given weren't
+	UINT  *m_puOrder;	 // Given key position of each sorted copy key
+	UINT  *m_puDir;		 // Key ranges by the first two key bytes
+	UINT   m_uCount;
+
+	UINT  *m_puFilter;	   // Prefilter bitmap
+	UINT   m_uFilterShift; // Hash to bitmap index shift
+
+	// No copies
+	GUIDIndex(const GUIDIndex &);
+	void operator=(const GUIDIndex &);
+};
+
+// Form a GUID was found in
+enum eHITFORM
+{
+	HIT_BINARY,	// 16 byte Microsoft layout
+	HIT_ASCII,	// Registry form text, "01234567-89AB-CDEF-0123-456789ABCDEF"
+	HIT_UTF16,	// Registry form text, UTF-16LE
+	HIT_RFC4122,// 16 byte RFC 4122 (network byte order) layout
+
+	HIT_FORM_COUNT
+};
+
+#define TEXT_GUID_LENGTH   36 // Registry form text chars
+#define MAX_GUID_FORM_SIZE (TEXT_GUID_LENGTH * 2) // Longest form in bytes
+
+// Scan flags
+#define SCAN_TEXT 1 // Find registry form text GUIDs too, at every offset
+#define SCAN_MORE 2 // The buffer's run goes on in the next buffer; set by the readers, not callers
+
+// Bumped when the same bytes can give different hits, for saved results
+#define SCANNER_VERSION 2
+
+// Scanner hit callback, "uOffset" is relative to the start of the buffer
+typedef void (*SCANHITPROC)(UINT uOffset, UINT uKey, UINT uForm, PVOID pContext);
+
+// Scan kernels
+enum eSCANKERNEL
+{
+	SCAN_SCALAR,
+	SCAN_SSE2,
+	SCAN_AVX2,
+};
+
+// Select scan kernel, clamped to what the CPU supports; returns the one in use.
+eSCANKERNEL SetScanKernel(eSCANKERNEL eWanted);
+LPCSTR GetScanKernelName(eSCANKERNEL eKernel);
+
+// Test 16 byte windows of a buffer against the index; returns hit count.
+// Only offsets (uFirst + (n * uStride)) are tested, a stride of 1 tests every offset.
+// With SCAN_TEXT registry form text GUIDs are found in the same pass, at any offset.
+// The first "uKeep" bytes are the end of the previous buffer of the same run,
+// GUIDs that lie wholly in them were reported with it and are skipped.
+// A text GUID is only reported by the buffer that holds the chars either side
+// of it too, or where the run ends; with SCAN_MORE the buffer end isn't one.
+UINT ScanBuffer(const GUIDIndex &rIndex, const BYTE *pData, UINT uSize, UINT uFirst, UINT uStride, UINT uFlags, UINT uKeep, SCANHITPROC pfnHit, PVOID pContext);
@@ -0,0 +1,96 @@
+
+// ****************************************************************************
+// File: SegReader.cpp
+// Desc: Chunked segment byte reader
+//
+// ****************************************************************************
+#include "StdAfx.h"
+#include "SegReader.h"
+
+
+SegReader::SegReader() : m_pSource(NULL), m_ea(BADADDR), m_endEA(BADADDR), m_lastEndEA(BADADDR), m_uLastSize(0), m_bFingerprint(FALSE), m_uFingerprint(0), m_uBytesRead(0)
+{
+}
+
+SegReader::~SegReader()
+{
+}
+
+
+// Start reading a new range
+void SegReader::Open(ByteSource &rSource, ea_t startEA, ea_t endEA, BOOL bFingerprint)
+{
+	m_pSource = &rSource;
+	m_ea = startEA;
+	m_endEA = endEA;
+	m_lastEndEA = BADADDR;
+	m_uLastSize = 0;
+	m_bFingerprint = bFingerprint;
+	m_uFingerprint = 0;
+}
+
+
+// Read the next chunk into "pBuffer" (CHUNK_SIZE bytes); returns FALSE at the end of the range.
+BOOL SegReader::Next(PBYTE pBuffer, ea_t &rEA, UINT &ruSize, UINT &ruKeep, BOOL &rbMore)
+{
+	while(m_ea < m_endEA)
+	{
+		// Skip bytes without values
+		if((m_ea = m_pSource->NextLoaded(m_ea, m_endEA)) == BADADDR)
+			break;
+
+		// Continuing the same run, carry the tail of the last chunk over
+		UINT uKeep = 0;
+		if((m_ea == m_lastEndEA) && (m_uLastSize >= OVERLAP))
+		{
+			memcpy(pBuffer, m_abTail, OVERLAP);
+			uKeep = OVERLAP;
+		}
+
+		// End of this chunk is the end of the run, limited to what the buffer holds
+		ea_t limitEA = m_endEA;
+		if((limitEA - m_ea) > (CHUNK_SIZE - uKeep))
+			limitEA = (m_ea + (CHUNK_SIZE - uKeep));
+		ea_t runEndEA = m_pSource->RunEnd(m_ea, limitEA);
+
+		// Where a run starts, or a byte without a value, counts too
+		if(m_bFingerprint && !uKeep)
+			m_uFingerprint = HashBytes64((const BYTE *) &m_ea, sizeof(m_ea), m_uFingerprint);
+
+		UINT uRead = (UINT) (runEndEA - m_ea);
+		if((uKeep + uRead) < sizeof(GUID))
+		{
+			// Too small to hold a GUID
+			m_ea = runEndEA;
+			m_uLastSize = 0;
+			continue;
+		}
+
+		if(!m_pSource->Read(m_ea, (pBuffer + uKeep), uRead))
+		{
+			msg("  %08X *** Failed to read %u bytes! ***\n", m_ea, uRead);
+			if(m_bFingerprint)
+				m_uFingerprint = ~HashBytes64((const BYTE *) &runEndEA, sizeof(runEndEA), m_uFingerprint);
+			m_ea = runEndEA;
+			m_uLastSize = 0;
+			continue;
+		}
+		m_uBytesRead += uRead;
+		if(m_bFingerprint)
+			m_uFingerprint = HashBytes64((pBuffer + uKeep), uRead, m_uFingerprint);
+
+		rEA    = (m_ea - uKeep);
+		ruSize = (uKeep + uRead);
+		ruKeep = uKeep;
+		rbMore = ((runEndEA == limitEA) && (runEndEA < m_endEA) && (m_pSource->NextLoaded(runEndEA, m_endEA) == runEndEA));
+		if(ruSize >= OVERLAP)
+			memcpy(m_abTail, (pBuffer + (ruSize - OVERLAP)), OVERLAP);
+
+		m_ea = m_lastEndEA = runEndEA;
+		m_uLastSize = ruSize;
+		return(TRUE);
+	};
+
+	m_ea = m_endEA;
+	return(FALSE);
+}
@@ -0,0 +1,61 @@
+
+// ****************************************************************************
+// File: SegReader.h
+// Desc: Chunked segment byte reader
+//
+// ****************************************************************************
+#pragma once
+#include "Scanner.h"
+#include "ByteSource.h"
+
+// Reads a segment range of a byte source in large chunks into caller supplied buffers.
+// Ranges without values (uninitialized/unloaded) are skipped without being
+// copied. Consecutive chunks of the same initialized run overlap by the
+// longest GUID form (UTF-16 text) and a UTF-16 char either side, so a GUID
+// straddling a chunk boundary is seen whole in the next chunk, along with the
+// chars the text forms are checked against. The overlap is carried over from the previous
+// chunk rather than read again, so buffers can be handed off and reused in
+// any order.
+class SegReader
+{
+public:
+	enum
+	{
+		CHUNK_SIZE = (1024 * 1024),
+		OVERLAP    = (MAX_GUID_FORM_SIZE + (2 * 2))
+	};
+
+	SegReader();
+	~SegReader();
+
+	// Start reading a new range, with "bFingerprint" hashing its bytes as they're read
+	void Open(ByteSource &rSource, ea_t startEA, ea_t endEA, BOOL bFingerprint = FALSE);
+
+	// Read the next chunk into "pBuffer" (CHUNK_SIZE bytes); returns FALSE at the end of the range.
+	// "ruKeep" gets the count of leading bytes carried over from the last chunk,
+	// "rbMore" is TRUE if the run goes on in the next chunk (see SCAN_MORE).
+	BOOL Next(PBYTE pBuffer, ea_t &rEA, UINT &ruSize, UINT &ruKeep, BOOL &rbMore);
+
+	// Hash of the bytes read from the range so far and where their runs start,
+	// see Open(). Chunks are read in address order, so it only depends on the bytes.
+	ULONGLONG GetFingerprint() const { return(m_uFingerprint); }
+
+	// Total bytes read from the sources
+	ULONGLONG GetBytesRead() const { return(m_uBytesRead); }
+	void ResetBytesRead(){ m_uBytesRead = 0; }
+
+private:
+	ByteSource *m_pSource;
+	BYTE  m_abTail[OVERLAP]; // End of the previous chunk
+	ea_t  m_ea;          // Next address to read
+	ea_t  m_endEA;       // Range end
+	ea_t  m_lastEndEA;   // End of the previous chunk
+	UINT  m_uLastSize;   // Size of the previous chunk
+	BOOL  m_bFingerprint;
+	ULONGLONG m_uFingerprint;
+	ULONGLONG m_uBytesRead;
+
+	// No copies
+	SegReader(const SegReader &);
+	void operator=(const SegReader &);
+};
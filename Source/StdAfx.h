@@ -1,5 +1,11 @@
 
 #pragma once
+
+// Stand alone tools (MakeStockDB, the Linux build) build the engine modules without IDA
+#ifdef GUIDFINDER_TOOL
+#include "ToolStdAfx.h"
+#else
+
 #define WIN32_LEAN_AND_MEAN
 #define WINVER       0x0502 // WinXP++    
 #define _WIN32_WINNT 0x0502
@@ -33,3 +39,5 @@
 #include "Utility.h"
 
 #define MY_VERSION "1.0B"
+
+#endif // GUIDFINDER_TOOL
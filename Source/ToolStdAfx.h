@@ -0,0 +1,292 @@
+
+// ****************************************************************************
+// File: ToolStdAfx.h
+// Desc: Stand in for the IDA SDK, for building the engine modules into tools
+//
+// ****************************************************************************
+#pragma once
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define WINVER       0x0502 // WinXP++
+#define _WIN32_WINNT 0x0502
+
+#include <windows.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <io.h>
+
+#define ALIGN(_x_) __declspec(align(_x_))
+
+inline UINT qfsize(FILE *fp){ return((UINT) _filelength(_fileno(fp))); }
+
+#else // POSIX
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <sys/stat.h>
+#include <cpuid.h>
+#include <immintrin.h>
+
+// The Win32 types, calls and compiler intrinsics the engine modules use
+typedef int BOOL;
+typedef unsigned char BYTE;
+typedef unsigned short WORD;
+typedef uint32_t DWORD;
+typedef uint32_t ULONG;
+typedef int32_t LONG;
+typedef unsigned int UINT;
+typedef long long LONGLONG;
+typedef unsigned long long ULONGLONG;
+typedef uintptr_t UINT_PTR;
+typedef void *PVOID;
+typedef void *HANDLE;
+typedef BYTE *PBYTE;
+typedef char *LPSTR;
+typedef const char *LPCSTR;
+
+#define TRUE  1
+#define FALSE 0
+#define MAX_PATH 1024
+
+struct GUID
+{
+	DWORD Data1;
+	WORD  Data2;
+	WORD  Data3;
+	BYTE  Data4[8];
+};
+
+#define __forceinline inline __attribute__((always_inline))
+#define __cdecl
+#define __stdcall
+#define ALIGN(_x_) __attribute__((aligned(_x_)))
+#define ZeroMemory(_p_, _size_) memset((_p_), 0, (_size_))
+
+#define _vsnprintf vsnprintf
+#define _byteswap_ulong  __builtin_bswap32
+#define _byteswap_ushort __builtin_bswap16
+
+inline int _snscanf(const char *pszBuffer, size_t uSize, const char *pszFormat, ...)
+{
+	va_list vl;
+	va_start(vl, pszFormat);
+	int iResult = vsscanf(pszBuffer, pszFormat, vl);
+	va_end(vl);
+	return(iResult);
+}
+
+inline BOOL DeleteFile(LPCSTR pszPath){ return(remove(pszPath) == 0); }
+
+inline unsigned char _BitScanForward(ULONG *puIndex, UINT uMask)
+{
+	if(!uMask)
+		return(0);
+	*puIndex = __builtin_ctz(uMask);
+	return(1);
+}
+
+// Newer cpuid.h and immintrin.h have their own __cpuidex() and _xgetbv(), these take over either way
+inline void POSIXCpuIdEx(int aiInfo[4], int iLeaf, int iSubLeaf){ __cpuid_count(iLeaf, iSubLeaf, aiInfo[0], aiInfo[1], aiInfo[2], aiInfo[3]); }
+inline void POSIXCpuId(int aiInfo[4], int iLeaf){ POSIXCpuIdEx(aiInfo, iLeaf, 0); }
+#undef __cpuid
+#define __cpuidex POSIXCpuIdEx
+#define __cpuid   POSIXCpuId
+
+inline ULONGLONG POSIXXGetBV(UINT uIndex)
+{
+	UINT uLow, uHigh;
+	__asm__ __volatile__("xgetbv" : "=a" (uLow), "=d" (uHigh) : "c" (uIndex));
+	return(((ULONGLONG) uHigh << 32) | uLow);
+}
+#define _xgetbv POSIXXGetBV
+
+// Critical sections are mutexes
+typedef pthread_mutex_t CRITICAL_SECTION;
+inline void InitializeCriticalSection(CRITICAL_SECTION *pLock){ pthread_mutex_init(pLock, NULL); }
+inline void DeleteCriticalSection(CRITICAL_SECTION *pLock){ pthread_mutex_destroy(pLock); }
+inline void EnterCriticalSection(CRITICAL_SECTION *pLock){ pthread_mutex_lock(pLock); }
+inline void LeaveCriticalSection(CRITICAL_SECTION *pLock){ pthread_mutex_unlock(pLock); }
+
+// A HANDLE is a semaphore or a thread
+struct tPOSIXHANDLE
+{
+	BOOL bThread;
+	sem_t Semaphore;
+	pthread_t Thread;
+	unsigned (*pfnStart)(PVOID);
+	PVOID pParam;
+};
+
+#define INFINITE      0xFFFFFFFF
+#define WAIT_OBJECT_0 0
+#define WAIT_TIMEOUT  258
+
+inline HANDLE CreateSemaphore(PVOID pAttributes, LONG lInitial, LONG lMax, LPCSTR pszName)
+{
+	tPOSIXHANDLE *pHandle = new tPOSIXHANDLE();
+	pHandle->bThread = FALSE;
+	if(sem_init(&pHandle->Semaphore, 0, lInitial) != 0)
+	{
+		delete pHandle;
+		return(NULL);
+	}
+	return(pHandle);
+}
+
+inline BOOL ReleaseSemaphore(HANDLE hSemaphore, LONG lCount, LONG *plPrevious)
+{
+	while(lCount-- > 0)
+		sem_post(&((tPOSIXHANDLE *) hSemaphore)->Semaphore);
+	return(TRUE);
+}
+
+// Semaphores can be waited on with a time out, threads only until they exit
+inline DWORD WaitForSingleObject(HANDLE hObject, DWORD dwWait)
+{
+	tPOSIXHANDLE *pHandle = (tPOSIXHANDLE *) hObject;
+	if(pHandle->bThread)
+	{
+		pthread_join(pHandle->Thread, NULL);
+		return(WAIT_OBJECT_0);
+	}
+
+	int iResult;
+	if(dwWait == INFINITE)
+	{
+		while(((iResult = sem_wait(&pHandle->Semaphore)) != 0) && (errno == EINTR)){};
+	}
+	else
+	{
+		timespec tTime;
+		clock_gettime(CLOCK_REALTIME, &tTime);
+		tTime.tv_sec  += (dwWait / 1000);
+		tTime.tv_nsec += ((long) (dwWait % 1000) * 1000000);
+		if(tTime.tv_nsec >= 1000000000)
+		{
+			tTime.tv_sec++;
+			tTime.tv_nsec -= 1000000000;
+		}
+		while(((iResult = sem_timedwait(&pHandle->Semaphore, &tTime)) != 0) && (errno == EINTR)){};
+	}
+	return((iResult == 0) ? WAIT_OBJECT_0 : WAIT_TIMEOUT);
+}
+
+inline DWORD WaitForMultipleObjects(DWORD dwCount, const HANDLE *phObjects, BOOL bWaitAll, DWORD dwWait)
+{
+	for(DWORD i = 0; i < dwCount; i++)
+		WaitForSingleObject(phObjects[i], dwWait);
+	return(WAIT_OBJECT_0);
+}
+
+inline BOOL CloseHandle(HANDLE hObject)
+{
+	tPOSIXHANDLE *pHandle = (tPOSIXHANDLE *) hObject;
+	if(!pHandle->bThread)
+		sem_destroy(&pHandle->Semaphore);
+	delete pHandle;
+	return(TRUE);
+}
+
+inline void *POSIXThreadStart(void *pParam)
+{
+	tPOSIXHANDLE *pHandle = (tPOSIXHANDLE *) pParam;
+	pHandle->pfnStart(pHandle->pParam);
+	return(NULL);
+}
+
+inline uintptr_t _beginthreadex(PVOID pSecurity, unsigned uStackSize, unsigned (*pfnStart)(PVOID), PVOID pParam, unsigned uFlags, unsigned *puThreadID)
+{
+	tPOSIXHANDLE *pHandle = new tPOSIXHANDLE();
+	pHandle->bThread  = TRUE;
+	pHandle->pfnStart = pfnStart;
+	pHandle->pParam   = pParam;
+	if(pthread_create(&pHandle->Thread, NULL, POSIXThreadStart, pHandle) != 0)
+	{
+		delete pHandle;
+		return(0);
+	}
+	return((uintptr_t) pHandle);
+}
+
+struct SYSTEM_INFO
+{
+	DWORD dwNumberOfProcessors;
+};
+inline void GetSystemInfo(SYSTEM_INFO *pInfo){ pInfo->dwNumberOfProcessors = (DWORD) sysconf(_SC_NPROCESSORS_ONLN); }
+
+inline UINT qfsize(FILE *fp)
+{
+	struct stat tStat;
+	return((fstat(fileno(fp), &tStat) == 0) ? (UINT) tStat.st_size : 0);
+}
+
+#endif // _WIN32
+
+#define MAXNAMELEN 512
+
+// IDA 5.x addresses
+typedef UINT ea_t;
+#define BADADDR ((ea_t) -1)
+
+// The few IDA SDK calls the engine modules use, on the CRT
+inline void *qalloc(size_t uSize){ return(malloc(uSize)); }
+inline void *qcalloc(size_t uCount, size_t uSize){ return(calloc(uCount, uSize)); }
+inline void *qrealloc(void *pMem, size_t uSize){ return(realloc(pMem, uSize)); }
+inline void qfree(void *pMem){ free(pMem); }
+
+inline char *qstrncpy(char *pszDst, const char *pszSrc, size_t uSize)
+{
+	if(uSize)
+	{
+		strncpy(pszDst, pszSrc, (uSize - 1));
+		pszDst[uSize - 1] = 0;
+	}
+	return(pszDst);
+}
+
+inline int qsnprintf(char *pszBuffer, size_t uSize, const char *pszFormat, ...)
+{
+	va_list vl;
+	va_start(vl, pszFormat);
+	int iResult = _vsnprintf(pszBuffer, uSize, pszFormat, vl);
+	va_end(vl);
+	if(uSize && ((iResult < 0) || ((size_t) iResult >= uSize)))
+	{
+		pszBuffer[uSize - 1] = 0;
+		iResult = (int) (uSize - 1);
+	}
+	return(iResult);
+}
+
+inline FILE *qfopen(const char *pszFile, const char *pszMode){ return(fopen(pszFile, pszMode)); }
+inline int qfclose(FILE *fp){ return(fclose(fp)); }
+inline int qfread(FILE *fp, void *pBuffer, size_t uSize){ return((int) fread(pBuffer, 1, uSize, fp)); }
+inline int qfwrite(FILE *fp, const void *pBuffer, size_t uSize){ return((int) fwrite(pBuffer, 1, uSize, fp)); }
+inline char *qfgets(char *pszBuffer, size_t uSize, FILE *fp){ return(fgets(pszBuffer, (int) uSize, fp)); }
+inline int qfputs(const char *pszString, FILE *fp){ return(fputs(pszString, fp)); }
+inline int qflush(FILE *fp){ return(fflush(fp)); }
+#define qfprintf fprintf
+
+// Log output, stdout unless a tool sends it elsewhere to keep stdout for its results
+inline FILE *&ToolLog(){ static FILE *fp = NULL; return(fp); }
+inline int msg(const char *pszFormat, ...)
+{
+	va_list vl;
+	va_start(vl, pszFormat);
+	int iResult = vfprintf((ToolLog() ? ToolLog() : stdout), pszFormat, vl);
+	va_end(vl);
+	return(iResult);
+}
+
+#include "Utility.h"
@@ -4,7 +4,7 @@
 // Desc: Utility functions
 //
 // ****************************************************************************
-#include "stdafx.h"
+#include "StdAfx.h"
 
 
 // ****************************************************************************
@@ -12,6 +12,7 @@
 // Desc: Get elapsed factional seconds
 //
 // ****************************************************************************
+#ifdef _WIN32
 ALIGN(32) TIMESTAMP GetTimeStamp() 
 {
 	LARGE_INTEGER tLarge;
@@ -27,6 +28,14 @@ ALIGN(32) TIMESTAMP GetTimeStamp()
 	
 	return((TIMESTAMP) tLarge.QuadPart / s_ClockFreq);
 }
+#else
+ALIGN(32) TIMESTAMP GetTimeStamp()
+{
+	timespec tTime;
+	clock_gettime(CLOCK_MONOTONIC, &tTime);
+	return((TIMESTAMP) tTime.tv_sec + ((TIMESTAMP) tTime.tv_nsec / 1000000000.0));
+}
+#endif
 
 
 // ****************************************************************************
@@ -64,4 +73,81 @@ ALIGN(32) UINT DJBHash(const BYTE *pData, int iSize)
 	}
 
 	return(uHash);
-}
\ No newline at end of file
+}
+
+// XXH64 primes
+#define PRIME64_1 0x9E3779B185EBCA87ULL
+#define PRIME64_2 0xC2B2AE3D27D4EB4FULL
+#define PRIME64_3 0x165667B19E3779F9ULL
+#define PRIME64_4 0x85EBCA77C2B2AE63ULL
+#define PRIME64_5 0x27D4EB2F165667C5ULL
+
+static inline ULONGLONG Rotate64(ULONGLONG u, UINT uBits){ return((u << uBits) | (u >> (64 - uBits))); }
+static inline ULONGLONG Read64(const BYTE *p){ ULONGLONG u; memcpy(&u, p, sizeof(u)); return(u); }
+static inline UINT Read32(const BYTE *p){ UINT u; memcpy(&u, p, sizeof(u)); return(u); }
+
+static inline ULONGLONG HashRound(ULONGLONG uAcc, ULONGLONG uInput)
+{
+	uAcc += (uInput * PRIME64_2);
+	return(Rotate64(uAcc, 31) * PRIME64_1);
+}
+
+static inline ULONGLONG HashMerge(ULONGLONG uAcc, ULONGLONG uValue)
+{
+	uAcc ^= HashRound(0, uValue);
+	return((uAcc * PRIME64_1) + PRIME64_4);
+}
+
+// XXH64, for content fingerprints
+ULONGLONG HashBytes64(const BYTE *pData, UINT uSize, ULONGLONG uSeed)
+{
+	const BYTE *p = pData, *pEnd = (pData + uSize);
+	ULONGLONG uHash;
+	if(uSize >= 32)
+	{
+		ULONGLONG v1 = (uSeed + PRIME64_1 + PRIME64_2), v2 = (uSeed + PRIME64_2), v3 = uSeed, v4 = (uSeed - PRIME64_1);
+		const BYTE *pLimit = (pEnd - 32);
+		do
+		{
+			v1 = HashRound(v1, Read64(p));
+			v2 = HashRound(v2, Read64(p + 8));
+			v3 = HashRound(v3, Read64(p + 16));
+			v4 = HashRound(v4, Read64(p + 24));
+			p += 32;
+		}
+		while(p <= pLimit);
+
+		uHash = (Rotate64(v1, 1) + Rotate64(v2, 7) + Rotate64(v3, 12) + Rotate64(v4, 18));
+		uHash = HashMerge(uHash, v1);
+		uHash = HashMerge(uHash, v2);
+		uHash = HashMerge(uHash, v3);
+		uHash = HashMerge(uHash, v4);
+	}
+	else
+		uHash = (uSeed + PRIME64_5);
+	uHash += uSize;
+
+	for(; (p + 8) <= pEnd; p += 8)
+	{
+		uHash ^= HashRound(0, Read64(p));
+		uHash = ((Rotate64(uHash, 27) * PRIME64_1) + PRIME64_4);
+	}
+	if((p + 4) <= pEnd)
+	{
+		uHash ^= ((ULONGLONG) Read32(p) * PRIME64_1);
+		uHash = ((Rotate64(uHash, 23) * PRIME64_2) + PRIME64_3);
+		p += 4;
+	}
+	for(; p < pEnd; p++)
+	{
+		uHash ^= (*p * PRIME64_5);
+		uHash = (Rotate64(uHash, 11) * PRIME64_1);
+	}
+
+	uHash ^= (uHash >> 33);
+	uHash *= PRIME64_2;
+	uHash ^= (uHash >> 29);
+	uHash *= PRIME64_3;
+	uHash ^= (uHash >> 32);
+	return(uHash);
+}
@@ -10,7 +10,9 @@
 #define SIZESTR(x) (sizeof(x) - 1)
 
 // Data and function alignment
+#ifndef ALIGN
 #define ALIGN(_x_) __declspec(align(_x_))
+#endif
 
 // Time 
 typedef double TIMESTAMP;  // Time in floating seconds
@@ -22,3 +24,4 @@ typedef double TIMESTAMP;  // Time in floating seconds
 TIMESTAMP GetTimeStamp();
 void Log(FILE *pLogFile, const char *format, ...);
 UINT DJBHash(const BYTE *pData, int iSize);
+ULONGLONG HashBytes64(const BYTE *pData, UINT uSize, ULONGLONG uSeed = 0);